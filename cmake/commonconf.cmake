@@ -63,17 +63,35 @@ ENDIF()
 
 IF(STREAM_SURFACE_GENERATOR)
 
+    # The interactive viewer; the core library and the batch tools need no display
+    OPTION(STREAM_SURFACE_GENERATOR_GUI "Build the OpenGL viewer (GLFW, GLEW, AntTweakBar)" ON)
+
+    # Scoped-zone profiling of the hot paths, dumped as Chrome traces; compiled out by default
+    OPTION(STREAM_SURFACE_GENERATOR_PROFILER "Record profiler zones (Chrome trace export)" OFF)
+    IF(STREAM_SURFACE_GENERATOR_PROFILER)
+        LIST(APPEND StreamSurfaceGeneratorGlobalDefinitions "-DSTREAM_SURFACE_PROFILER")
+    ENDIF(STREAM_SURFACE_GENERATOR_PROFILER)
+
+    # Count every heap allocation through a replaced global operator new; off by default
+    OPTION(STREAM_SURFACE_GENERATOR_MEMORY_TRACKING "Track heap bytes and their peak per phase" OFF)
+    IF(STREAM_SURFACE_GENERATOR_MEMORY_TRACKING)
+        LIST(APPEND StreamSurfaceGeneratorGlobalDefinitions "-DSTREAM_SURFACE_MEMORY_TRACKING")
+    ENDIF(STREAM_SURFACE_GENERATOR_MEMORY_TRACKING)
+
     # OPENGL 
-    FIND_PACKAGE(AntTweakBar REQUIRED)
-    FIND_PACKAGE(OpenGL REQUIRED)
-    FIND_PACKAGE(GLFW3 REQUIRED)
-    FIND_PACKAGE(GLEW REQUIRED)
-    FIND_PACKAGE(GLM REQUIRED)
+    IF(STREAM_SURFACE_GENERATOR_GUI)
+        FIND_PACKAGE(AntTweakBar REQUIRED)
+        FIND_PACKAGE(OpenGL REQUIRED)
+        FIND_PACKAGE(GLFW3 REQUIRED)
+        FIND_PACKAGE(GLEW REQUIRED)
+
+        INCLUDE_DIRECTORIES(${ANT_TWEAK_BAR_INCLUDE_PATH})	
+        INCLUDE_DIRECTORIES(${OPENGL_INCLUDE_DIRS})
+        INCLUDE_DIRECTORIES(${GLFW3_INCLUDE_DIR})
+        INCLUDE_DIRECTORIES(${GLEW_INCLUDE_DIRS})
+    ENDIF(STREAM_SURFACE_GENERATOR_GUI)
 
-    INCLUDE_DIRECTORIES(${ANT_TWEAK_BAR_INCLUDE_PATH})	
-    INCLUDE_DIRECTORIES(${OPENGL_INCLUDE_DIRS})
-    INCLUDE_DIRECTORIES(${GLFW3_INCLUDE_DIR})
-    INCLUDE_DIRECTORIES(${GLEW_INCLUDE_DIRS})
+    FIND_PACKAGE(GLM REQUIRED)
     INCLUDE_DIRECTORIES(${GLM_INCLUDE_DIR})
     
     # VTK
@@ -84,6 +102,16 @@ IF(STREAM_SURFACE_GENERATOR)
     FIND_PACKAGE(Boost REQUIRED COMPONENTS filesystem system)
     INCLUDE_DIRECTORIES(${Boost_INCLUDE_DIRS})
 
+    # Threads (surface worker)
+    FIND_PACKAGE(Threads REQUIRED)
+
+    # OpenMP (batch surface generation)
+    FIND_PACKAGE(OpenMP)
+    IF(OPENMP_FOUND)
+        SET(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${OpenMP_C_FLAGS}")
+        SET(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${OpenMP_CXX_FLAGS}")
+    ENDIF(OPENMP_FOUND)
+
 ENDIF(STREAM_SURFACE_GENERATOR)
 
 SET(CMAKE_MODULE_PATH ${CMAKE_MODULE_PATH} "${StreamSurfaceGeneratorHome}/cmake")
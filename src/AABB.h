@@ -35,6 +35,9 @@ public:
 	/// Check if the box contains a 3D point.
 	AABB_INLINE bool contains( const float point[3] ) const;
 
+	/// Check if the box overlaps another box (touching counts).
+	AABB_INLINE bool intersects( const AABB &aabb ) const;
+
 	/// Extend the box with a 3D point.
 	AABB_INLINE void extend( const float x, const float y, const float z );
 
@@ -84,6 +87,13 @@ AABB_INLINE bool AABB::contains( const float point[3] ) const
 		   && point[2] >= min[2] && point[2] <= max[2];
 }
 
+AABB_INLINE bool AABB::intersects( const AABB &aabb ) const
+{
+	return    min[0] <= aabb.max[0] && max[0] >= aabb.min[0]
+		   && min[1] <= aabb.max[1] && max[1] >= aabb.min[1]
+		   && min[2] <= aabb.max[2] && max[2] >= aabb.min[2];
+}
+
 AABB_INLINE void AABB::extend( const float x, const float y, const float z )
 {
 	min[0] = std::min(min[0], x);
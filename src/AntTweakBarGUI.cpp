@@ -22,6 +22,22 @@ void AntTweakBarGUI::init(const unsigned int& width, const unsigned int& height)
     general_streamlines = false;
     TwAddVarRW(generalBar, "Streamlines", TW_TYPE_BOOL8, &general_streamlines, "");
 
+    general_preview = true;
+    TwAddVarRW(generalBar, "Preview", TW_TYPE_BOOL8, &general_preview, "");
+
+    general_lod_error = 1.0f;
+    TwAddVarRW(generalBar, "LOD error (px)", TW_TYPE_FLOAT, &general_lod_error, "min=0 max=50 step=0.25");
+
+    // Bounds the levels when they are built, in surface coordinates; 0 leaves them unbounded
+    general_lod_max_error = 0.0f;
+    TwAddVarRW(generalBar, "LOD max error", TW_TYPE_FLOAT, &general_lod_max_error, "min=0 step=0.001");
+
+    export_format = EXPORT_PLY;
+    export_requested = false;
+    TwType exportFormatType = TwDefineEnumFromString("ExportFormat", "PLY,VTU,OBJ");
+    TwAddVarRW(generalBar, "Export format", exportFormatType, &export_format, "");
+    TwAddButton(generalBar, "Export surface", ExportCB, this, "");
+
     general_light_dir[0] = 1.0f;    general_light_dir[1] = 1.0f;    general_light_dir[2] = 1.0f;
     TwAddVarRW(generalBar, "Light Direction", TW_TYPE_DIR3F, general_light_dir, "");
 
@@ -57,10 +73,58 @@ void AntTweakBarGUI::init(const unsigned int& width, const unsigned int& height)
     seedingline_dir[1] = 1.0f;
     seedingline_dir[2] = 0.0f;
 
+    seedingline_curve = SEED_LINE;
+    seedingline_extent = 0.4f;
+    seedingline_adaptive = false;
+    // Polyline and spline curves need control points, which only parameter files provide
+    TwType seedCurveType = TwDefineEnumFromString("SeedCurve", "Line,Circle");
+    TwAddVarRW(seedinglineBar, "Curve", seedCurveType, &seedingline_curve, "");
+    TwAddVarRW(seedinglineBar, "Length/Radius", TW_TYPE_FLOAT, &seedingline_extent, "min=0 step=0.01");
+    TwAddVarRW(seedinglineBar, "Adaptive", TW_TYPE_BOOL8, &seedingline_adaptive, "");
+
     tracing_addition = false; tracing_remove = false; tracing_ripping = false;
     TwAddVarRW(seedinglineBar, "Addition", TW_TYPE_BOOL8, &tracing_addition, "");
     TwAddVarRW(seedinglineBar, "Removal", TW_TYPE_BOOL8, &tracing_remove, "");
     TwAddVarRW(seedinglineBar, "Ripping", TW_TYPE_BOOL8, &tracing_ripping, "");
+
+    // Tracer counters of the surface in progress, refreshed by updateStats()
+    TwBar* statsBar = TwNewBar("Stats");
+    TwDefine("Stats position= '600 320' refresh=0.5 valueswidth=90");
+
+    static const char* counterLabels[TracerStats::COUNTER_COUNT] = {
+        "Field lookups", "Lookups outside", "Ribbon calls", "Zero-velocity exits",
+        "Additions", "Rips", "Vertices", "Triangles"
+    };
+    static const char* maximumLabels[TracerStats::MAXIMUM_COUNT] = { "Max candidates", "Max depth", "Max front" };
+    static const char* meanLabels[TracerStats::HISTOGRAM_COUNT]  = { "Mean candidates", "Mean depth", "Mean front" };
+
+    TwAddSeparator(statsBar, "Counters", "");
+    for (int c = 0; c < TracerStats::COUNTER_COUNT; c++){
+        stats_counters[c] = 0.0;
+        TwAddVarRO(statsBar, counterLabels[c], TW_TYPE_DOUBLE, &stats_counters[c], "precision=0");
+    }
+    TwAddSeparator(statsBar, "Extremes", "");
+    for (int m = 0; m < TracerStats::MAXIMUM_COUNT; m++){
+        stats_maxima[m] = 0.0;
+        TwAddVarRO(statsBar, maximumLabels[m], TW_TYPE_DOUBLE, &stats_maxima[m], "precision=0");
+    }
+    for (int h = 0; h < TracerStats::HISTOGRAM_COUNT; h++){
+        stats_means[h] = 0.0;
+        TwAddVarRO(statsBar, meanLabels[h], TW_TYPE_DOUBLE, &stats_means[h], "precision=2");
+    }
+}
+
+void AntTweakBarGUI::updateStats(const TracerStats::Snapshot& snapshot) {
+    for (int c = 0; c < TracerStats::COUNTER_COUNT; c++)
+        stats_counters[c] = (double)snapshot.counters[c];
+    for (int m = 0; m < TracerStats::MAXIMUM_COUNT; m++)
+        stats_maxima[m] = (double)snapshot.maxima[m];
+    for (int h = 0; h < TracerStats::HISTOGRAM_COUNT; h++)
+        stats_means[h] = snapshot.mean((TracerStats::Histogram)h);
+}
+
+void TW_CALL AntTweakBarGUI::ExportCB(void* clientData) {
+    ((AntTweakBarGUI*)clientData)->export_requested = true;
 }
 
 void AntTweakBarGUI::draw() {
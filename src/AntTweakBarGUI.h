@@ -4,12 +4,15 @@
 #include <AntTweakBar.h>
 #include <GLFW/glfw3.h>
 
+#include "TracerStats.h"
+
 class AntTweakBarGUI {
 public:
     AntTweakBarGUI();
 
     void init(const unsigned int& width, const unsigned int& height);
     void draw();
+    void updateStats(const TracerStats::Snapshot& snapshot);
     void shutdown();
 
     ~AntTweakBarGUI();
@@ -20,6 +23,8 @@ public:
     static void TwEventKeyGLFW3(int key, int scancode, int action, int mods);
     static void TwEventCharGLFW3(int codepoint);
 
+    static void TW_CALL ExportCB(void* clientData);
+
     // Callback function called by GLFW when window size changes
     static void WindowSizeCB(int width, int height);
 
@@ -29,6 +34,14 @@ public:
 
     bool  general_wireframe;
     bool  general_streamlines;
+    bool  general_preview;
+    float general_lod_error;
+    float general_lod_max_error;
+
+    // Export
+    enum ExportFormat { EXPORT_PLY, EXPORT_VTU, EXPORT_OBJ };
+    ExportFormat    export_format;
+    bool            export_requested;
     float general_light_dir[3];
 
     //TraceDirection  traceDirection;
@@ -40,9 +53,20 @@ public:
     float           seedingline_center[3];
     float           seedingline_dir[3];
 
+    // Seed curve
+    enum SeedCurve { SEED_LINE, SEED_CIRCLE };
+    SeedCurve       seedingline_curve;
+    float           seedingline_extent;
+    bool            seedingline_adaptive;
+
     bool            tracing_addition;
     bool            tracing_remove; 
     bool            tracing_ripping;
+
+    // Stats (read only)
+    double          stats_counters[TracerStats::COUNTER_COUNT];
+    double          stats_maxima[TracerStats::MAXIMUM_COUNT];
+    double          stats_means[TracerStats::HISTOGRAM_COUNT];
 };
 
 #endif
\ No newline at end of file
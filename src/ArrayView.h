@@ -0,0 +1,68 @@
+
+/**
+ *
+ * Read-only array view
+ *
+ * This class refers to a contiguous range of elements owned by someone else
+ * (usually a std::vector inside the tracer), so results can be read without
+ * being copied. A view is invalidated by anything that reallocates its owner.
+ *
+ */
+
+#ifndef __ARRAY_VIEW__
+#define __ARRAY_VIEW__
+
+// STD
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+template<typename T>
+class ArrayView
+{
+public:
+
+    typedef const T* const_iterator;
+
+    ArrayView() : m_data(NULL), m_size(0) {}
+    ArrayView(const T* data, size_t size) : m_data(data), m_size(size) {}
+    ArrayView(const std::vector<T>& values) : m_data(values.empty() ? NULL : &values[0]), m_size(values.size()) {}
+
+    const T* data() const   { return m_data; }
+    size_t   size() const   { return m_size; }
+    bool     empty() const  { return m_size == 0; }
+
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const   { return m_data + m_size; }
+
+    const T& operator[](size_t i) const { assert(i < m_size); return m_data[i]; }
+
+    /// The elements [first, first + count).
+    ArrayView sub(size_t first, size_t count) const
+    {
+        assert(first + count <= m_size);
+        return ArrayView(m_data + first, count);
+    }
+
+    /// The elements from first to the end.
+    ArrayView sub(size_t first) const
+    {
+        assert(first <= m_size);
+        return ArrayView(m_data + first, m_size - first);
+    }
+
+    /// Write the elements into caller-provided memory, e.g. a mapped GPU buffer.
+    void copyTo(T* destination) const
+    {
+        std::copy(begin(), end(), destination);
+    }
+
+    std::vector<T> toVector() const { return std::vector<T>(begin(), end()); }
+
+private:
+    const T* m_data;
+    size_t   m_size;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#include "BinaryIO.h"
+
+// STD
+#include <cstdlib>
+#include <string>
+
+bool BinaryIO::readCount(std::istream& in, size_t& count)
+{
+    std::string line;
+    if (!std::getline(in, line))
+        return false;
+
+    count = (size_t)std::strtoull(line.c_str(), NULL, 10);
+    return true;
+}
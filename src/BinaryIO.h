@@ -0,0 +1,33 @@
+
+/**
+ *
+ * Binary file headers
+ *
+ * The binary caches of the tracer (the mesh cache, the velocities of a time
+ * step, the bricks) start with their element counts as text, one per line, and
+ * continue with the raw elements:
+ *
+ *   out << cells.size() << std::endl;
+ *   out.write((const char*)&cells[0], sizeof(AABB) * cells.size());
+ *
+ * Reading a count with in >> count >> std::ws would also skip the data bytes
+ * that follow it if they look like whitespace, so counts are read by line.
+ *
+ */
+
+#ifndef __BINARY_IO__
+#define __BINARY_IO__
+
+// STD
+#include <cstddef>
+#include <istream>
+
+class BinaryIO
+{
+public:
+
+    /// Read the count on the next line. Returns false at the end of the stream.
+    static bool readCount(std::istream& in, size_t& count);
+};
+
+#endif
@@ -0,0 +1,552 @@
+#include "BrickedField.h"
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+// Stream Tracer
+#include "BinaryIO.h"
+#include "Profiler.h"
+#include "ThreadLocal.h"
+
+namespace
+{
+    // Enlarge brick grids to avoid primitives on boundaries, like the grid of the whole mesh
+    const float EPSILON = 0.0001f;
+
+    // Brick grids are built whenever a brick is read: a few cells per grid cell keep that cheap,
+    // and lookups test the cells of their grid cell anyway
+    const size_t CELLS_PER_GRID_CELL = 4;
+
+    // Ids of opened files, unique across fields
+    std::atomic<unsigned long long> g_next_id(1);
+
+    /// Cells of a regular grid over a box with about the given number of cells in total,
+    /// as close to cubes as the box allows.
+    void gridDimensions(const AABB& box, size_t cells, size_t dims[3])
+    {
+        float extent[3];
+        float longest = 0.0f;
+        for (int a = 0; a < 3; a++){
+            extent[a] = box.max[a] - box.min[a];
+            longest = std::max(longest, extent[a]);
+        }
+
+        // Flat boxes still get one layer of cells
+        double volume = 1.0;
+        for (int a = 0; a < 3; a++){
+            extent[a] = std::max(extent[a], 1e-6f * longest);
+            volume *= extent[a];
+        }
+
+        double side = std::cbrt(volume / (double)std::max<size_t>(cells, 1));
+        for (int a = 0; a < 3; a++)
+            dims[a] = side > 0.0 ? std::max<size_t>(1, (size_t)std::ceil(extent[a] / side)) : 1;
+    }
+
+    /// The grid cell of a point, clamped to the grid.
+    size_t locate(const float point[3], const AABB& box, const size_t dims[3])
+    {
+        size_t index[3];
+        for (int a = 0; a < 3; a++){
+            float extent = box.max[a] - box.min[a];
+            float t = extent > 0.0f ? (point[a] - box.min[a]) / extent : 0.0f;
+            index[a] = t <= 0.0f ? 0 : std::min(dims[a] - 1, (size_t)(t * (float)dims[a]));
+        }
+        return index[0] + dims[0] * (index[1] + dims[1] * index[2]);
+    }
+}
+
+BrickedField::BrickedField(size_t maxResidentBytes)
+    : m_cache(maxResidentBytes, 1)     // the brick just read
+{
+    m_dims[0] = m_dims[1] = m_dims[2] = 0;
+    m_cellCount = 0;
+    m_id = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cache.reset(lock, std::bind(&BrickedField::read, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+std::string BrickedField::bricksPath(const std::string& dataset)
+{
+    return dataset + ".bricks";
+}
+
+bool BrickedField::build(const std::string& binaryPath, const std::string& bricksPath, size_t cellsPerBrick, size_t bufferBytes)
+{
+    PROFILE_ZONE("BrickedField::build");
+
+    std::ifstream boxesIn(binaryPath.c_str(), std::ios_base::binary);
+    std::ifstream vectorsIn(binaryPath.c_str(), std::ios_base::binary);
+    if (!boxesIn || !vectorsIn)
+        return false;
+
+    size_t cellBoxesNumber, cellPointsNumber, cellVectorsNumber;
+    if (!BinaryIO::readCount(boxesIn, cellBoxesNumber) || !BinaryIO::readCount(boxesIn, cellPointsNumber) || !BinaryIO::readCount(boxesIn, cellVectorsNumber))
+        return false;
+
+    if (cellBoxesNumber == 0 || cellBoxesNumber != cellVectorsNumber){
+        std::cout << "BrickedField: " << binaryPath << " has " << cellBoxesNumber << " cells and "
+                  << cellVectorsNumber << " vectors" << std::endl;
+        return false;
+    }
+
+    std::cout << "BrickedField: splitting " << binaryPath << " into bricks" << std::endl;
+
+    const std::streamoff boxesStart   = boxesIn.tellg();
+    const std::streamoff vectorsStart = boxesStart + (std::streamoff)(sizeof(AABB) * cellBoxesNumber + sizeof(glm::vec3) * cellPointsNumber);
+    const size_t chunk = std::max<size_t>(1, bufferBytes / sizeof(AABB));
+
+    std::vector<AABB> boxes;
+    std::vector<glm::vec3> vectors;
+
+    // Pass 1: the domain
+    AABB sceneBox;
+    for (size_t first = 0; first < cellBoxesNumber && boxesIn; first += chunk){
+        boxes.resize(std::min(chunk, cellBoxesNumber - first));
+        boxesIn.read((char*)&boxes[0], sizeof(AABB) * boxes.size());
+        for (size_t c = 0; c < boxes.size(); c++)
+            sceneBox.extend(boxes[c]);
+    }
+    if (!boxesIn)
+        return false;
+
+    size_t dims[3];
+    gridDimensions(sceneBox, (cellBoxesNumber + cellsPerBrick - 1) / std::max<size_t>(cellsPerBrick, 1), dims);
+    const size_t brickCount = dims[0] * dims[1] * dims[2];
+
+    // Pass 2: the cells and bounds of every brick. A cell goes to the brick of its center.
+    std::vector<BrickRecord> index(brickCount);
+    for (size_t b = 0; b < brickCount; b++)
+        index[b].cellCount = 0;
+
+    boxesIn.seekg(boxesStart);
+    for (size_t first = 0; first < cellBoxesNumber && boxesIn; first += chunk){
+        boxes.resize(std::min(chunk, cellBoxesNumber - first));
+        boxesIn.read((char*)&boxes[0], sizeof(AABB) * boxes.size());
+        for (size_t c = 0; c < boxes.size(); c++){
+            float center[3] = { 0.5f * (boxes[c].min[0] + boxes[c].max[0]), 0.5f * (boxes[c].min[1] + boxes[c].max[1]), 0.5f * (boxes[c].min[2] + boxes[c].max[2]) };
+            BrickRecord& record = index[locate(center, sceneBox, dims)];
+            record.bounds.extend(boxes[c]);
+            record.cellCount++;
+        }
+    }
+    if (!boxesIn)
+        return false;
+
+    // Written next to the target and renamed once complete, so a failed split leaves no bricks behind
+    std::string partialPath = bricksPath + ".partial";
+    std::ofstream out(partialPath.c_str(), std::ios_base::binary);
+    if (!out)
+        return false;
+
+    out << cellBoxesNumber << std::endl;
+    out << brickCount << std::endl;
+    out << dims[0] << " " << dims[1] << " " << dims[2] << std::endl;
+
+    unsigned long long offset = (unsigned long long)out.tellp() + sizeof(AABB) + sizeof(BrickRecord) * brickCount;
+    for (size_t b = 0; b < brickCount; b++){
+        BrickRecord& record = index[b];
+        record.offset = offset;
+        if (record.cellCount > 0){
+            size_t gridDims[3];
+            gridDimensions(record.bounds, (record.cellCount + CELLS_PER_GRID_CELL - 1) / CELLS_PER_GRID_CELL, gridDims);
+            for (int a = 0; a < 3; a++)
+                record.gridDims[a] = (unsigned int)gridDims[a];
+        }
+        else {
+            record.gridDims[0] = record.gridDims[1] = record.gridDims[2] = 0;
+        }
+        offset += (sizeof(AABB) + sizeof(glm::vec3)) * (unsigned long long)record.cellCount;
+    }
+
+    out.write((const char*)&sceneBox, sizeof(AABB));
+    out.write((const char*)&index[0], sizeof(BrickRecord) * brickCount);
+
+    // Pass 3: the cells, gathered per brick until the buffers are full
+    std::vector< std::vector<AABB> >      pendingBoxes(brickCount);
+    std::vector< std::vector<glm::vec3> > pendingVectors(brickCount);
+    std::vector<size_t> written(brickCount, 0);
+    size_t pendingBytes = 0;
+
+    auto flush = [&](){
+        for (size_t b = 0; b < brickCount; b++){
+            if (pendingBoxes[b].empty())
+                continue;
+
+            const BrickRecord& record = index[b];
+            out.seekp((std::streamoff)(record.offset + sizeof(AABB) * written[b]));
+            out.write((const char*)&pendingBoxes[b][0], sizeof(AABB) * pendingBoxes[b].size());
+            out.seekp((std::streamoff)(record.offset + sizeof(AABB) * record.cellCount + sizeof(glm::vec3) * written[b]));
+            out.write((const char*)&pendingVectors[b][0], sizeof(glm::vec3) * pendingVectors[b].size());
+
+            written[b] += pendingBoxes[b].size();
+            std::vector<AABB>().swap(pendingBoxes[b]);
+            std::vector<glm::vec3>().swap(pendingVectors[b]);
+        }
+        pendingBytes = 0;
+    };
+
+    boxesIn.seekg(boxesStart);
+    vectorsIn.seekg(vectorsStart);
+    for (size_t first = 0; first < cellBoxesNumber && boxesIn && vectorsIn && out; first += chunk){
+        size_t count = std::min(chunk, cellBoxesNumber - first);
+        boxes.resize(count);
+        vectors.resize(count);
+        boxesIn.read((char*)&boxes[0], sizeof(AABB) * count);
+        vectorsIn.read((char*)&vectors[0], sizeof(glm::vec3) * count);
+
+        for (size_t c = 0; c < count; c++){
+            float center[3] = { 0.5f * (boxes[c].min[0] + boxes[c].max[0]), 0.5f * (boxes[c].min[1] + boxes[c].max[1]), 0.5f * (boxes[c].min[2] + boxes[c].max[2]) };
+            size_t b = locate(center, sceneBox, dims);
+            pendingBoxes[b].push_back(boxes[c]);
+            pendingVectors[b].push_back(vectors[c]);
+        }
+
+        pendingBytes += (sizeof(AABB) + sizeof(glm::vec3)) * count;
+        if (pendingBytes >= bufferBytes)
+            flush();
+    }
+    flush();
+
+    bool complete = boxesIn && vectorsIn && out;
+    out.close();
+    if (!complete || !out){
+        std::remove(partialPath.c_str());
+        return false;
+    }
+
+    std::remove(bricksPath.c_str());
+    if (std::rename(partialPath.c_str(), bricksPath.c_str()) != 0)
+        return false;
+
+    std::cout << "BrickedField: " << cellBoxesNumber << " cells in " << brickCount << " bricks ("
+              << dims[0] << " x " << dims[1] << " x " << dims[2] << ")" << std::endl;
+    return true;
+}
+
+bool BrickedField::open(const std::string& path)
+{
+    close();
+
+    std::ifstream in(path.c_str(), std::ios_base::binary);
+    if (!in)
+        return false;
+
+    size_t cellCount, brickCount;
+    std::string dimsLine;
+    if (!BinaryIO::readCount(in, cellCount) || !BinaryIO::readCount(in, brickCount) || !std::getline(in, dimsLine))
+        return false;
+
+    size_t dims[3] = { 0, 0, 0 };
+    std::istringstream(dimsLine) >> dims[0] >> dims[1] >> dims[2];
+    if (brickCount == 0 || dims[0] * dims[1] * dims[2] != brickCount)
+        return false;
+
+    AABB sceneBox;
+    std::vector<BrickRecord> index(brickCount);
+    in.read((char*)&sceneBox, sizeof(AABB));
+    in.read((char*)&index[0], sizeof(BrickRecord) * brickCount);
+    if (!in)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_index.swap(index);
+    m_sceneBox  = sceneBox;
+    m_cellCount = cellCount;
+    for (int a = 0; a < 3; a++)
+        m_dims[a] = dims[a];
+    m_path = path;
+    m_id   = g_next_id++;
+
+    std::cout << "BrickedField: " << cellCount << " cells in " << brickCount << " bricks from " << path << std::endl;
+    return true;
+}
+
+void BrickedField::close()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Reads in flight still use the index
+    m_cache.clear(lock);
+
+    std::vector<BrickRecord>().swap(m_index);
+    m_sceneBox  = AABB();
+    m_cellCount = 0;
+    m_dims[0] = m_dims[1] = m_dims[2] = 0;
+    m_path.clear();
+
+    // The bricks other threads kept go with their next lookup
+    ThreadBrick& last = threadBrick();
+    if (last.field == m_id)
+        last = ThreadBrick();
+    m_id = 0;
+}
+
+bool BrickedField::readRegion(const AABB& region, std::vector<AABB>& cellBoxes, std::vector<glm::vec3>& cellVectors) const
+{
+    PROFILE_ZONE("BrickedField::readRegion");
+
+    cellBoxes.clear();
+    cellVectors.clear();
+
+    std::ifstream in(m_path.c_str(), std::ios_base::binary);
+    if (!isOpen() || !in)
+        return false;
+
+    // Bricks in index order, so the file is read front to back
+    std::vector<AABB> boxes;
+    std::vector<glm::vec3> vectors;
+    size_t bricksRead = 0;
+    for (size_t b = 0; b < m_index.size() && in; b++){
+        const BrickRecord& record = m_index[b];
+        if (record.cellCount == 0 || !record.bounds.intersects(region))
+            continue;
+
+        boxes.resize(record.cellCount);
+        vectors.resize(record.cellCount);
+        in.seekg((std::streamoff)record.offset);
+        in.read((char*)&boxes[0], sizeof(AABB) * record.cellCount);
+        in.read((char*)&vectors[0], sizeof(glm::vec3) * record.cellCount);
+
+        for (size_t c = 0; c < boxes.size(); c++){
+            if (boxes[c].intersects(region)){
+                cellBoxes.push_back(boxes[c]);
+                cellVectors.push_back(vectors[c]);
+            }
+        }
+        bricksRead++;
+    }
+
+    std::cout << "BrickedField: " << cellBoxes.size() << " of " << m_cellCount << " cells in the region, from "
+              << bricksRead << " of " << m_index.size() << " bricks" << std::endl;
+    return !!in;
+}
+
+bool BrickedField::sample(const glm::vec3& point, glm::vec3& velocity) const
+{
+    if (!isOpen() || !m_sceneBox.contains((const float*)&point))
+        return false;
+
+    size_t brick = locateBrick(point);
+    if (m_index[brick].cellCount > 0 && m_index[brick].bounds.contains((const float*)&point)){
+        // Consecutive lookups of a thread mostly stay in one brick: only a change of brick takes the lock
+        ThreadBrick& last = threadBrick();
+        if (last.field != m_id || last.brick != brick || !last.cells){
+            last.field = m_id;
+            last.brick = brick;
+            last.cells = find(brick);
+        }
+
+        if (last.cells && lookup(*last.cells, point, velocity))
+            return true;
+    }
+
+    return sampleNeighbours(point, brick, velocity);
+}
+
+void BrickedField::sample(const std::vector<glm::vec3>& points, std::vector<glm::vec3>& velocities, std::vector<char>* inside) const
+{
+    PROFILE_ZONE("BrickedField::sample");
+
+    const int n = (int)points.size();
+    const size_t outside = m_index.size();
+
+    velocities.assign(n, glm::vec3(0.0f, 0.0f, 0.0f));
+    std::vector<char> found(n, 0);
+
+    // The brick of every point, and the points sorted by brick
+    std::vector<size_t> bricks(n);
+    #pragma omp parallel for schedule(static)
+    for (int p = 0; p < n; p++)
+        bricks[p] = isOpen() && m_sceneBox.contains((const float*)&points[p]) ? locateBrick(points[p]) : outside;
+
+    std::vector<size_t> first(outside + 2, 0);
+    for (int p = 0; p < n; p++)
+        first[bricks[p] + 1]++;
+    for (size_t b = 1; b < first.size(); b++)
+        first[b] += first[b - 1];
+
+    std::vector<int> order(n);
+    std::vector<size_t> next(first.begin(), first.end() - 1);
+    for (int p = 0; p < n; p++)
+        order[next[bricks[p]]++] = p;
+
+    std::vector<size_t> visited;
+    for (size_t b = 0; b < outside; b++){
+        if (first[b + 1] > first[b] && m_index[b].cellCount > 0)
+            visited.push_back(b);
+    }
+
+    // Every brick is looked up once for all of its points; different bricks are read concurrently
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int v = 0; v < (int)visited.size(); v++){
+        size_t b = visited[v];
+        BrickPtr cells = find(b);
+        if (!cells)
+            continue;
+
+        for (size_t o = first[b]; o < first[b + 1]; o++){
+            int p = order[o];
+            found[p] = lookup(*cells, points[p], velocities[p]) ? 1 : 0;
+        }
+    }
+
+    // Points near brick boundaries, in cells of the neighbours
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int p = 0; p < n; p++){
+        if (!found[p] && bricks[p] != outside)
+            found[p] = sampleNeighbours(points[p], bricks[p], velocities[p]) ? 1 : 0;
+    }
+
+    if (inside)
+        inside->swap(found);
+}
+
+void BrickedField::setMaxResidentBytes(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cache.setMaxResidentBytes(bytes);
+}
+
+size_t BrickedField::getResidentBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cache.getResidentBytes();
+}
+
+size_t BrickedField::getResidentBricks() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cache.getResidentCount();
+}
+
+unsigned long long BrickedField::getLoads() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cache.getLoads();
+}
+
+unsigned long long BrickedField::getEvictions() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cache.getEvictions();
+}
+
+size_t BrickedField::locateBrick(const glm::vec3& point) const
+{
+    return locate((const float*)&point, m_sceneBox, m_dims);
+}
+
+bool BrickedField::sampleNeighbours(const glm::vec3& point, size_t brick, glm::vec3& velocity) const
+{
+    // Cells are assumed to be smaller than bricks, so they reach at most into the next brick
+    const long long i = (long long)(brick % m_dims[0]);
+    const long long j = (long long)((brick / m_dims[0]) % m_dims[1]);
+    const long long k = (long long)(brick / (m_dims[0] * m_dims[1]));
+
+    for (long long dk = -1; dk <= 1; dk++){
+        for (long long dj = -1; dj <= 1; dj++){
+            for (long long di = -1; di <= 1; di++){
+                long long ni = i + di, nj = j + dj, nk = k + dk;
+                if ((di == 0 && dj == 0 && dk == 0) || ni < 0 || nj < 0 || nk < 0 ||
+                    ni >= (long long)m_dims[0] || nj >= (long long)m_dims[1] || nk >= (long long)m_dims[2])
+                    continue;
+
+                size_t neighbour = (size_t)(ni + (long long)m_dims[0] * (nj + (long long)m_dims[1] * nk));
+                const BrickRecord& record = m_index[neighbour];
+                if (record.cellCount == 0 || !record.bounds.contains((const float*)&point))
+                    continue;
+
+                BrickPtr cells = find(neighbour);
+                if (cells && lookup(*cells, point, velocity))
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool BrickedField::lookup(const Brick& brick, const glm::vec3& point, glm::vec3& velocity)
+{
+    const float* p = (const float*)&point;
+    if (!brick.bounds.contains(p))
+        return false;
+
+    size_t i, j, k;
+    brick.accel.locateCell(i, j, k, p);
+    if (brick.accel.emptyCell(i, j, k))
+        return false;
+
+    // Brick grids are coarse, so the candidates are tested; the first one stands in,
+    // like in the grid of the whole mesh, if none contains the point
+    const std::vector<Grid::PrimitiveIndex>& primitives = brick.accel.getPrimitives(i, j, k);
+    Grid::PrimitiveIndex cell = primitives[0];
+    for (size_t c = 0; c < primitives.size(); c++){
+        if (brick.cellBoxes[primitives[c]].contains(p)){
+            cell = primitives[c];
+            break;
+        }
+    }
+
+    velocity = brick.cellVectors[cell];
+    return true;
+}
+
+BrickedField::ThreadBrick& BrickedField::threadBrick()
+{
+    // Allocated on first use and kept for the life of the thread, like the tracer statistics
+    static THREAD_LOCAL ThreadBrick* t_brick = NULL;
+    if (!t_brick)
+        t_brick = new ThreadBrick();
+    return *t_brick;
+}
+
+BrickedField::BrickPtr BrickedField::find(size_t brick) const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    BrickPtr cells = m_cache.find(brick, lock);
+    if (!cells)
+        std::cout << "BrickedField: cannot read brick " << brick << " of " << m_path << std::endl;
+    return cells;
+}
+
+bool BrickedField::read(size_t brick, Brick& result, size_t& bytes) const
+{
+    PROFILE_ZONE("BrickedField::read");
+
+    const BrickRecord& record = m_index[brick];
+
+    std::ifstream in(m_path.c_str(), std::ios_base::binary);
+    if (!in)
+        return false;
+
+    result.cellBoxes.resize(record.cellCount);
+    result.cellVectors.resize(record.cellCount);
+
+    in.seekg((std::streamoff)record.offset);
+    in.read((char*)&result.cellBoxes[0], sizeof(AABB) * record.cellCount);
+    in.read((char*)&result.cellVectors[0], sizeof(glm::vec3) * record.cellCount);
+    if (!in)
+        return false;
+
+    result.bounds = record.bounds;
+
+    AABB accelBox = record.bounds;
+    accelBox.enlarge(EPSILON);
+    result.accel.reset(accelBox, record.gridDims[0], record.gridDims[1], record.gridDims[2]);
+    result.accel.insertPrimitiveList(result.cellBoxes);
+
+    bytes = result.cellBoxes.capacity() * sizeof(AABB) + result.cellVectors.capacity() * sizeof(glm::vec3)
+          + result.accel.getMemoryBytes();
+    return true;
+}
@@ -0,0 +1,157 @@
+
+/**
+ *
+ * Out-of-core bricked velocity field
+ *
+ * This class traces datasets that do not fit into memory. The binary cache is
+ * split once into spatial bricks (<dataset>.bricks): the domain is cut into a
+ * regular grid of bricks, every cell goes to the brick that holds the center
+ * of its bounds, and a brick stores the bounds and velocities of its cells.
+ * The file starts with an index of all bricks: their bounds (the union of their
+ * cell bounds), where they are stored and the dimensions of their grids. Only
+ * the index stays in memory.
+ *
+ * Bricks are read when a lookup first enters them and kept in a memory-bounded
+ * LRU; every brick builds its own acceleration grid when it is read. A point is
+ * looked up in the brick whose region contains it and, near a brick boundary,
+ * in the neighbours whose cells reach over. Bricks in use stay alive when they
+ * are evicted, so the budget can be exceeded by the lookups in flight.
+ *
+ * Every thread keeps the brick of its last single lookup, so the steps of a
+ * ribbon take the cache lock only when they move on to another brick; that
+ * brick stays alive with the thread until then, even when it is evicted.
+ * Batched lookups sort their points by brick and visit every brick once, which
+ * is the way to integrate many particles at a time without reading a brick
+ * again for every one of them.
+ *
+ * The index also serves loads of a region of interest: readRegion() reads only
+ * the bricks whose bounds meet the region and keeps the cells that do.
+ *
+ *   BrickedField::build("case.foam.bin", BrickedField::bricksPath("case.foam"));
+ *   BrickedField field(512 * 1024 * 1024);
+ *   field.open(BrickedField::bricksPath("case.foam"));
+ *
+ */
+
+#ifndef __BRICKED_FIELD__
+#define __BRICKED_FIELD__
+
+// STD
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "AABB.h"
+#include "Grid.h"
+#include "LoadingCache.h"
+
+class BrickedField
+{
+public:
+
+    /// Entry of the brick index, stored as is in the file.
+    struct BrickRecord
+    {
+        AABB               bounds;      // of the cells of the brick; invalid for an empty brick
+        unsigned long long offset;      // of the cell bounds, followed by the velocities
+        unsigned int       cellCount;
+        unsigned int       gridDims[3]; // of the grid built over the cells when the brick is read
+    };
+
+    BrickedField(size_t maxResidentBytes = 1024 * 1024 * 1024);
+
+    /// File next to a dataset: the bricks split from its binary cache.
+    static std::string bricksPath(const std::string& dataset);
+
+    /// Split a binary cache (see StreamTracer) into bricks of about cellsPerBrick cells. The cache
+    /// is read in passes of bufferBytes and the bricks are written from buffers of the same size,
+    /// so datasets larger than memory can be split.
+    static bool build(const std::string& binaryPath, const std::string& bricksPath,
+                      size_t cellsPerBrick = 65536, size_t bufferBytes = 64 * 1024 * 1024);
+
+    /// Read the index of a bricks file. The bricks themselves are read on demand.
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return !m_path.empty(); }
+
+    /// The cells that intersect a region, read past the cache from the bricks that intersect it.
+    bool readRegion(const AABB& region, std::vector<AABB>& cellBoxes, std::vector<glm::vec3>& cellVectors) const;
+
+    /// The velocity of the cell at a point. Returns false outside of the domain. Thread-safe.
+    bool sample(const glm::vec3& point, glm::vec3& velocity) const;
+
+    /// Sample many points brick by brick, in parallel. inside[i] (if given) is set to 1 for points
+    /// inside the domain; the velocities of the others are zero.
+    void sample(const std::vector<glm::vec3>& points, std::vector<glm::vec3>& velocities, std::vector<char>* inside = NULL) const;
+
+    const AABB& getSceneBox() const { return m_sceneBox; }
+    size_t getCellCount() const { return m_cellCount; }
+    const std::vector<BrickRecord>& getIndex() const { return m_index; }
+
+    void setMaxResidentBytes(size_t bytes);
+    size_t getResidentBytes() const;
+    size_t getResidentBricks() const;
+    unsigned long long getIndexBytes() const { return (unsigned long long)m_index.capacity() * sizeof(BrickRecord); }
+
+    /// Bricks read and dropped from the cache since the file was opened.
+    unsigned long long getLoads() const;
+    unsigned long long getEvictions() const;
+
+private:
+    BrickedField(const BrickedField&);
+    BrickedField& operator=(const BrickedField&);
+
+    struct Brick
+    {
+        AABB                   bounds;
+        std::vector<AABB>      cellBoxes;
+        std::vector<glm::vec3> cellVectors;
+        Grid                   accel;
+    };
+
+    typedef LoadingCache<Brick>::Ptr BrickPtr;
+
+    /// The brick a thread looked up last, by the file it was opened as.
+    struct ThreadBrick
+    {
+        ThreadBrick() : field(0), brick(0) {}
+
+        unsigned long long field;
+        size_t             brick;
+        BrickPtr           cells;
+    };
+
+    static ThreadBrick& threadBrick();
+
+    /// The brick whose region contains a point (the point must be inside the scene box).
+    size_t locateBrick(const glm::vec3& point) const;
+
+    /// Look a point up in the neighbours of its brick, after it was not found in the brick itself.
+    bool sampleNeighbours(const glm::vec3& point, size_t brick, glm::vec3& velocity) const;
+
+    static bool lookup(const Brick& brick, const glm::vec3& point, glm::vec3& velocity);
+
+    /// The brick from the cache, or read without holding the lock.
+    BrickPtr find(size_t brick) const;
+    bool read(size_t brick, Brick& result, size_t& bytes) const;
+
+    std::string              m_path;
+    std::vector<BrickRecord> m_index;
+    AABB                     m_sceneBox;
+    size_t                   m_dims[3];
+    size_t                   m_cellCount;
+
+    // Tells the opened files apart for the bricks kept per thread; 0 while closed
+    unsigned long long       m_id;
+
+    // The cache is filled by const lookups and guarded by the mutex; different bricks are read concurrently
+    mutable std::mutex          m_mutex;
+    mutable LoadingCache<Brick> m_cache;
+};
+
+#endif
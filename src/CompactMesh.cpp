@@ -0,0 +1,169 @@
+#include "CompactMesh.h"
+
+// STD
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    glm::uint16 quantizeUnorm16(float value)
+    {
+        return (glm::uint16)std::floor(glm::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+
+    glm::int16 quantizeSnorm16(float value)
+    {
+        return (glm::int16)std::floor(glm::clamp(value, -1.0f, 1.0f) * 32767.0f + 0.5f);
+    }
+
+    glm::uint8 quantizeUnorm8(float value)
+    {
+        return (glm::uint8)std::floor(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    float signNotZero(float value)
+    {
+        return value >= 0.0f ? 1.0f : -1.0f;
+    }
+}
+
+CompactMesh::CompactMesh()
+{
+    clear();
+}
+
+void CompactMesh::clear()
+{
+    boundsMin    = glm::vec3(0.0f, 0.0f, 0.0f);
+    boundsExtent = glm::vec3(0.0f, 0.0f, 0.0f);
+
+    vertices.clear();
+    indices.clear();
+    chunks.clear();
+}
+
+void CompactMesh::build(ArrayView<glm::vec3> positions, ArrayView<glm::vec3> derivatives, ArrayView<glm::vec3> normals,
+                        ArrayView<unsigned int> faces, size_t maxChunkVertices)
+{
+    clear();
+    if (positions.empty() || faces.size() < 3)
+        return;
+
+    // Bounds of the whole surface, so all chunks share one decode transform
+    glm::vec3 boundsMax = positions[0];
+    boundsMin = positions[0];
+    for (size_t v = 1; v < positions.size(); v++){
+        boundsMin = glm::min(boundsMin, positions[v]);
+        boundsMax = glm::max(boundsMax, positions[v]);
+    }
+    boundsExtent = boundsMax - boundsMin;
+
+    // Split the triangles in order into chunks. A stamp per source vertex tells whether it
+    // is already part of the current chunk, so nothing has to be cleared between chunks.
+    std::vector<unsigned int> stamp(positions.size(), 0);
+    std::vector<unsigned int> local(positions.size(), 0);
+    std::vector<unsigned int> source;       // source vertex of every output vertex
+
+    source.reserve(positions.size() + positions.size() / 8);
+    indices.reserve(faces.size());
+
+    Chunk chunk = { 0, 0, 0, 0 };
+    unsigned int chunkStamp = 1;
+
+    for (size_t f = 0; f + 2 < faces.size(); f += 3){
+        size_t missing = 0;
+        for (int c = 0; c < 3; c++)
+            missing += (stamp[faces[f + c]] != chunkStamp) ? 1 : 0;
+
+        if (chunk.vertexCount + missing > maxChunkVertices){
+            chunks.push_back(chunk);
+
+            chunk.firstVertex = source.size();  chunk.vertexCount = 0;
+            chunk.firstIndex  = indices.size(); chunk.indexCount  = 0;
+            chunkStamp++;
+        }
+
+        for (int c = 0; c < 3; c++){
+            unsigned int v = faces[f + c];
+            if (stamp[v] != chunkStamp){
+                stamp[v] = chunkStamp;
+                local[v] = (unsigned int)chunk.vertexCount++;
+                source.push_back(v);
+            }
+            indices.push_back((glm::uint16)local[v]);
+        }
+        chunk.indexCount += 3;
+    }
+    chunks.push_back(chunk);
+
+    // Encode the vertices independently of each other
+    glm::vec3 inverseExtent(boundsExtent.x > 0.0f ? 1.0f / boundsExtent.x : 0.0f,
+                            boundsExtent.y > 0.0f ? 1.0f / boundsExtent.y : 0.0f,
+                            boundsExtent.z > 0.0f ? 1.0f / boundsExtent.z : 0.0f);
+
+    vertices.resize(source.size());
+
+    #pragma omp parallel for schedule(static)
+    for (long long o = 0; o < (long long)source.size(); o++){
+        unsigned int v = source[o];
+        CompactVertex& vertex = vertices[o];
+
+        glm::vec3 position = (positions[v] - boundsMin) * inverseExtent;
+        vertex.position[0] = quantizeUnorm16(position.x);
+        vertex.position[1] = quantizeUnorm16(position.y);
+        vertex.position[2] = quantizeUnorm16(position.z);
+        vertex.position[3] = 0;
+
+        encodeNormal(v < normals.size() ? normals[v] : glm::vec3(0.0f, 0.0f, 0.0f), vertex.normal);
+
+        // Same mapping as the float path: the flow direction as a color
+        glm::vec3 color(0.5f, 0.5f, 0.5f);
+        if (v < derivatives.size() && glm::length(derivatives[v]) > 0.0f)
+            color = glm::normalize(derivatives[v]) * 0.5f + glm::vec3(0.5f, 0.5f, 0.5f);
+        vertex.color[0] = quantizeUnorm8(color.x);
+        vertex.color[1] = quantizeUnorm8(color.y);
+        vertex.color[2] = quantizeUnorm8(color.z);
+        vertex.color[3] = 255;
+    }
+}
+
+glm::vec3 CompactMesh::decodePosition(const CompactVertex& vertex) const
+{
+    glm::vec3 position(vertex.position[0], vertex.position[1], vertex.position[2]);
+    return boundsMin + position / 65535.0f * boundsExtent;
+}
+
+void CompactMesh::encodeNormal(const glm::vec3& normal, glm::int16 encoded[2])
+{
+    float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (l1 == 0.0f){
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+
+    // Project onto the octahedron, then fold the lower half over the diagonals
+    glm::vec2 p(normal.x / l1, normal.y / l1);
+    if (normal.z < 0.0f)
+        p = glm::vec2((1.0f - std::abs(p.y)) * signNotZero(p.x), (1.0f - std::abs(p.x)) * signNotZero(p.y));
+
+    encoded[0] = quantizeSnorm16(p.x);
+    encoded[1] = quantizeSnorm16(p.y);
+}
+
+glm::vec3 CompactMesh::decodeNormal(const glm::int16 encoded[2])
+{
+    glm::vec2 p(std::max(encoded[0] / 32767.0f, -1.0f), std::max(encoded[1] / 32767.0f, -1.0f));
+
+    glm::vec3 normal(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+    if (normal.z < 0.0f){
+        normal.x = (1.0f - std::abs(p.y)) * signNotZero(p.x);
+        normal.y = (1.0f - std::abs(p.x)) * signNotZero(p.y);
+    }
+
+    return glm::normalize(normal);
+}
+
+size_t CompactMesh::bytes() const
+{
+    return sizeof(CompactVertex) * vertices.size() + sizeof(glm::uint16) * indices.size();
+}
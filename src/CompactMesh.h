@@ -0,0 +1,69 @@
+
+/**
+ *
+ * Compact surface mesh
+ *
+ * This class packs a generated surface into one interleaved vertex stream of
+ * 16 bytes per vertex: positions quantized to 16 bit relative to the surface
+ * bounding box, octahedral-encoded normals and 8 bit colors from the velocity.
+ * The triangles are split into chunks of at most 65535 vertices, so every chunk
+ * can be drawn with 16 bit indices and a base vertex.
+ *
+ */
+
+#ifndef __COMPACT_MESH__
+#define __COMPACT_MESH__
+
+// STD
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "ArrayView.h"
+
+/// Bound as 3 x GL_UNSIGNED_SHORT, 2 x GL_SHORT and 3 x GL_UNSIGNED_BYTE, all normalized.
+/// The fourth position and color components only pad the vertex to 16 bytes.
+struct CompactVertex
+{
+    glm::uint16 position[4];    // xyz in [0, 65535] over the bounds, w unused
+    glm::int16  normal[2];      // octahedral
+    glm::uint8  color[4];       // rgb, a unused
+};
+
+class CompactMesh
+{
+public:
+
+    /// Triangles of a chunk index the vertices [firstVertex, firstVertex + vertexCount).
+    struct Chunk
+    {
+        size_t firstVertex, vertexCount;
+        size_t firstIndex,  indexCount;
+    };
+
+    CompactMesh();
+
+    /// Encode a surface. Vertices shared by two chunks are duplicated.
+    void build(ArrayView<glm::vec3> positions, ArrayView<glm::vec3> derivatives, ArrayView<glm::vec3> normals,
+               ArrayView<unsigned int> faces, size_t maxChunkVertices = 65535);
+
+    void clear();
+
+    glm::vec3 decodePosition(const CompactVertex& vertex) const;
+
+    static void encodeNormal(const glm::vec3& normal, glm::int16 encoded[2]);
+    static glm::vec3 decodeNormal(const glm::int16 encoded[2]);
+
+    size_t bytes() const;
+
+    /// Position = boundsMin + quantized / 65535 * boundsExtent
+    glm::vec3 boundsMin, boundsExtent;
+
+    std::vector< CompactVertex >    vertices;
+    std::vector< glm::uint16 >      indices;
+    std::vector< Chunk >            chunks;
+};
+
+#endif
@@ -0,0 +1,330 @@
+#include "FieldTimeSeries.h"
+
+// STD
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Stream Tracer
+#include "BinaryIO.h"
+
+FieldTimeSeries::Interval::Interval()
+{
+    begin = end = 0.0;
+    t0 = t1 = 0.0;
+}
+
+float FieldTimeSeries::Interval::weight(double time) const
+{
+    if (t1 <= t0)
+        return 0.0f;
+
+    double w = (time - t0) / (t1 - t0);
+    return (float)std::min(1.0, std::max(0.0, w));
+}
+
+FieldTimeSeries::FieldTimeSeries(size_t maxResidentBytes, size_t prefetchSteps)
+    : m_cache(maxResidentBytes, 2)     // the interval being looked up
+{
+
+    m_prefetch_hint = false;
+    m_prefetch_step = 0;
+    m_prefetch_direction = 0;
+    m_prefetch_steps = prefetchSteps;
+    m_prefetch_stop = false;
+
+    m_loads = m_prefetches = m_stalls = 0;
+    m_stall_milliseconds = 0.0;
+}
+
+FieldTimeSeries::~FieldTimeSeries()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_prefetch_stop = true;
+    }
+    m_prefetch_wake.notify_all();
+
+    if (m_prefetch_thread.joinable())
+        m_prefetch_thread.join();
+}
+
+void FieldTimeSeries::reset(const std::vector<double>& times, const Loader& loader)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_cache.reset(lock, std::bind(&FieldTimeSeries::load, this, loader, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    m_times  = times;
+    m_prefetch_hint = false;
+
+    m_loads = m_prefetches = m_stalls = 0;
+    m_stall_milliseconds = 0.0;
+}
+
+void FieldTimeSeries::clear()
+{
+    reset(std::vector<double>(), Loader());
+}
+
+FieldTimeSeries::VelocitiesPtr FieldTimeSeries::velocities(size_t step) const
+{
+    if (step >= m_times.size())
+        return VelocitiesPtr();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return find(step, lock, false);
+}
+
+bool FieldTimeSeries::interval(double time, Interval& interval, int direction) const
+{
+    if (m_times.empty())
+        return false;
+
+    // The last step at or before the time, so that [step, step + 1] contains it
+    size_t count = m_times.size();
+    size_t step = std::upper_bound(m_times.begin(), m_times.end(), time) - m_times.begin();
+    step = step > 0 ? step - 1 : 0;
+    if (count > 1)
+        step = std::min(step, count - 2);
+    size_t next = std::min(step + 1, count - 1);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Point the prefetcher beyond this interval before waiting for it
+    if (direction != 0 && m_prefetch_steps > 0){
+        m_prefetch_hint = true;
+        m_prefetch_step = direction > 0 ? next : step;
+        m_prefetch_direction = direction > 0 ? 1 : -1;
+
+        if (!m_prefetch_thread.joinable())
+            m_prefetch_thread = std::thread(&FieldTimeSeries::prefetchLoop, this);
+        m_prefetch_wake.notify_one();
+    }
+
+    bool stalled = !resident(step) || !resident(next);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    interval.v0 = find(step, lock, false);
+    interval.v1 = find(next, lock, false);
+
+    if (stalled){
+        m_stalls++;
+        m_stall_milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (!interval.v0 || !interval.v1){
+        interval = Interval();
+        return false;
+    }
+
+    interval.t0 = m_times[step];
+    interval.t1 = m_times[next];
+    interval.begin = step == 0 ? -DBL_MAX : interval.t0;
+    interval.end   = next + 1 >= count ? DBL_MAX : interval.t1;
+    return true;
+}
+
+void FieldTimeSeries::setMaxResidentBytes(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cache.setMaxResidentBytes(bytes);
+}
+
+size_t FieldTimeSeries::getResidentBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cache.getResidentBytes();
+}
+
+size_t FieldTimeSeries::getResidentSteps() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cache.getResidentCount();
+}
+
+void FieldTimeSeries::setPrefetchSteps(size_t steps)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_prefetch_steps = steps;
+    m_prefetch_wake.notify_one();
+}
+
+unsigned long long FieldTimeSeries::getLoads() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_loads;
+}
+
+unsigned long long FieldTimeSeries::getPrefetches() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_prefetches;
+}
+
+unsigned long long FieldTimeSeries::getStalls() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stalls;
+}
+
+double FieldTimeSeries::getStallMilliseconds() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stall_milliseconds;
+}
+
+FieldTimeSeries::VelocitiesPtr FieldTimeSeries::find(size_t step, std::unique_lock<std::mutex>& lock, bool prefetch) const
+{
+    bool loaded;
+    VelocitiesPtr velocities = m_cache.find(step, lock, &loaded);
+
+    if (!velocities){
+        std::cout << "FieldTimeSeries: cannot load time step " << step << " (time " << m_times[step] << ")" << std::endl;
+        return VelocitiesPtr();
+    }
+
+    if (loaded && prefetch)
+        m_prefetches++;
+    else if (loaded)
+        m_loads++;
+
+    return velocities;
+}
+
+bool FieldTimeSeries::load(const Loader& loader, size_t step, Velocities& velocities, size_t& bytes) const
+{
+    std::lock_guard<std::mutex> reading(m_load_mutex);
+    if (!loader || !loader(step, velocities))
+        return false;
+
+    bytes = velocities.capacity() * sizeof(glm::vec3);
+    return true;
+}
+
+void FieldTimeSeries::prefetchLoop() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_prefetch_stop){
+        size_t step;
+        if (!nextPrefetch(step)){
+            m_prefetch_wake.wait(lock);
+            continue;
+        }
+
+        // A step that cannot be read is left to the tracer, which reports it
+        if (!find(step, lock, true))
+            m_prefetch_hint = false;
+    }
+}
+
+bool FieldTimeSeries::nextPrefetch(size_t& step) const
+{
+    if (!m_prefetch_hint || m_prefetch_steps == 0)
+        return false;
+
+    // As far ahead as the budget holds next to the interval in use
+    size_t depth = m_prefetch_steps;
+    size_t residentSteps = m_cache.getResidentCount();
+    if (residentSteps > 0){
+        size_t stepBytes = std::max<size_t>(m_cache.getResidentBytes() / residentSteps, 1);
+        size_t steps = m_cache.getMaxResidentBytes() / stepBytes;
+        depth = std::min(depth, steps > 2 ? steps - 2 : 0);
+    }
+
+    for (size_t d = 1; d <= depth; d++){
+        if (m_prefetch_direction < 0 && d > m_prefetch_step)
+            break;
+
+        size_t candidate = m_prefetch_step + m_prefetch_direction * (long long)d;
+        if (candidate >= m_times.size())
+            break;
+
+        if (!resident(candidate) && !m_cache.loading(candidate)){
+            step = candidate;
+            return true;
+        }
+    }
+
+    // The window is read: wait for the tracer to move on
+    return false;
+}
+
+std::string FieldTimeSeries::timesPath(const std::string& dataset)
+{
+    return dataset + ".times";
+}
+
+std::string FieldTimeSeries::stepPath(const std::string& dataset, size_t step)
+{
+    std::ostringstream path;
+    path << dataset << ".U" << std::setw(4) << std::setfill('0') << step << ".bin";
+    return path.str();
+}
+
+bool FieldTimeSeries::loadTimes(const std::string& path, std::vector<double>& times)
+{
+    std::ifstream in(path.c_str());
+    if (!in)
+        return false;
+
+    size_t count = 0;
+    in >> count;
+    times.resize(count);
+    for (size_t i = 0; i < count; i++)
+        in >> times[i];
+
+    if (!in || count == 0)
+        return false;
+
+    for (size_t i = 1; i < count; i++){
+        if (times[i] <= times[i - 1]){
+            std::cout << "FieldTimeSeries: the times in " << path << " are not ascending" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FieldTimeSeries::saveTimes(const std::string& path, const std::vector<double>& times)
+{
+    std::ofstream out(path.c_str());
+    if (!out)
+        return false;
+
+    out << times.size() << std::endl << std::setprecision(17);
+    for (size_t i = 0; i < times.size(); i++)
+        out << times[i] << std::endl;
+    return !!out;
+}
+
+bool FieldTimeSeries::loadVelocities(const std::string& path, Velocities& velocities)
+{
+    std::ifstream in(path.c_str(), std::ios_base::binary);
+    if (!in)
+        return false;
+
+    size_t count;
+    if (!BinaryIO::readCount(in, count) || count == 0)
+        return false;
+
+    velocities.resize(count);
+    in.read((char*)&velocities[0], sizeof(glm::vec3) * count);
+    return !!in;
+}
+
+bool FieldTimeSeries::saveVelocities(const std::string& path, const Velocities& velocities)
+{
+    std::ofstream out(path.c_str(), std::ios_base::binary);
+    if (!out)
+        return false;
+
+    out << velocities.size() << std::endl;
+    if (!velocities.empty())
+        out.write((const char*)&velocities[0], sizeof(glm::vec3) * velocities.size());
+    return !!out;
+}
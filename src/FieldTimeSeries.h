@@ -0,0 +1,147 @@
+
+/**
+ *
+ * Time series of a velocity field
+ *
+ * This class holds the time steps of an unsteady dataset. The mesh, its cell
+ * bounds and the acceleration grid are shared by all steps and stay with the
+ * StreamTracer; a step only consists of one velocity per cell. Steps are loaded
+ * lazily by a loader function and kept in a memory-bounded LRU.
+ *
+ * Lookups go through an Interval: the two resident steps around a time, which
+ * a tracer keeps while its particles stay between them, so that the velocity
+ * lookups themselves take no lock. Arrays in use stay alive when they are
+ * evicted, so the budget can be exceeded by the intervals being traced.
+ *
+ * An interval requested with a direction of integration also tells a background
+ * thread which steps come next; it reads up to the prefetch depth of them ahead,
+ * one at a time, so that the tracer finds them resident when it gets there. The
+ * thread stays within the depth and within what the memory budget holds next to
+ * the interval in use, and waits for the tracer to move on once they are read.
+ * Loads never hold the lock that resident lookups take, and the loader is called
+ * by one thread at a time, so it need not be thread-safe.
+ *
+ * Times outside the series are clamped to its first or last step.
+ *
+ */
+
+#ifndef __FIELD_TIME_SERIES__
+#define __FIELD_TIME_SERIES__
+
+// STD
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "LoadingCache.h"
+
+class FieldTimeSeries
+{
+public:
+
+    typedef std::vector<glm::vec3>          Velocities;
+    typedef std::shared_ptr<const Velocities> VelocitiesPtr;
+
+    /// Fill the velocities of a step; false if it cannot be loaded.
+    typedef std::function<bool(size_t step, Velocities& velocities)> Loader;
+
+    struct Interval
+    {
+        Interval();
+
+        /// Whether the interval serves this time (it extends to infinity at the ends of the series).
+        bool contains(double time) const { return v0 && time >= begin && time <= end; }
+
+        /// Weight of v1 at this time, between 0 and 1.
+        float weight(double time) const;
+
+        double        begin, end;   // times this interval serves
+        double        t0, t1;       // times of the two steps
+        VelocitiesPtr v0, v1;
+    };
+
+    FieldTimeSeries(size_t maxResidentBytes = 1024 * 1024 * 1024, size_t prefetchSteps = 2);
+    ~FieldTimeSeries();
+
+    /// Replace the series: ascending step times and the loader of their velocities.
+    void reset(const std::vector<double>& times, const Loader& loader);
+    void clear();
+
+    size_t getStepCount() const { return m_times.size(); }
+    const std::vector<double>& getTimes() const { return m_times; }
+
+    /// The velocities of a step, loaded on a miss. NULL if the step cannot be loaded.
+    VelocitiesPtr velocities(size_t step) const;
+
+    /// The steps around a time. Returns false if the series is empty or a step cannot be loaded.
+    /// A direction (1 forward in time, -1 backward) has the steps beyond the interval prefetched.
+    bool interval(double time, Interval& interval, int direction = 0) const;
+
+    void setMaxResidentBytes(size_t bytes);
+    size_t getResidentBytes() const;
+    size_t getResidentSteps() const;
+
+    /// Steps read ahead of the tracer (0 disables prefetching).
+    void setPrefetchSteps(size_t steps);
+
+    /// Steps read on demand and by the prefetcher, and the intervals that had to wait for a read.
+    unsigned long long getLoads() const;
+    unsigned long long getPrefetches() const;
+    unsigned long long getStalls() const;
+    double getStallMilliseconds() const;
+
+    /// Files next to a dataset: the step times (text) and the velocities of one step (binary).
+    static std::string timesPath(const std::string& dataset);
+    static std::string stepPath(const std::string& dataset, size_t step);
+
+    static bool loadTimes(const std::string& path, std::vector<double>& times);
+    static bool saveTimes(const std::string& path, const std::vector<double>& times);
+
+    /// Count, then the raw vectors, like the cell vectors in the binary cache.
+    static bool loadVelocities(const std::string& path, Velocities& velocities);
+    static bool saveVelocities(const std::string& path, const Velocities& velocities);
+
+private:
+    FieldTimeSeries(const FieldTimeSeries&);
+    FieldTimeSeries& operator=(const FieldTimeSeries&);
+
+    /// The step from the cache, or read with the lock released. Called and returns with the lock held.
+    VelocitiesPtr find(size_t step, std::unique_lock<std::mutex>& lock, bool prefetch) const;
+    bool resident(size_t step) const { return m_cache.contains(step); }
+
+    /// Read a step with the loader of the series, one read at a time.
+    bool load(const Loader& loader, size_t step, Velocities& velocities, size_t& bytes) const;
+
+    void prefetchLoop() const;
+    bool nextPrefetch(size_t& step) const;
+
+    std::vector<double> m_times;
+
+    // The cache is filled by const lookups; it and the prefetch state are guarded by the mutex.
+    // Steps are read one at a time, under the load mutex.
+    mutable std::mutex                      m_mutex;
+    mutable LoadingCache<Velocities>        m_cache;
+    mutable std::mutex                      m_load_mutex;
+
+    // Prefetching: the last step of the latest interval and the direction beyond it
+    mutable std::thread                 m_prefetch_thread;
+    mutable std::condition_variable     m_prefetch_wake;
+    mutable bool                        m_prefetch_hint;
+    mutable size_t                      m_prefetch_step;
+    mutable int                         m_prefetch_direction;
+    size_t                              m_prefetch_steps;
+    bool                                m_prefetch_stop;
+
+    mutable unsigned long long m_loads, m_prefetches, m_stalls;
+    mutable double             m_stall_milliseconds;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "GenerationArena.h"
+
+// STD
+#include <algorithm>
+
+GenerationArena::GenerationArena(size_t initialBytes)
+{
+    m_chunk = 0;
+    m_offset = 0;
+    m_used = 0;
+    m_high_water = 0;
+    m_initial_bytes = initialBytes;
+}
+
+GenerationArena::~GenerationArena()
+{
+    for (size_t c = 0; c < m_chunks.size(); c++)
+        delete[] m_chunks[c].data;
+}
+
+void* GenerationArena::allocate(size_t bytes, size_t alignment)
+{
+    if (bytes == 0)
+        bytes = 1;
+
+    while (true){
+        if (m_chunk < m_chunks.size()){
+            Chunk& chunk = m_chunks[m_chunk];
+
+            size_t address = (size_t)(chunk.data + m_offset);
+            size_t padding = (alignment - address % alignment) % alignment;
+
+            if (m_offset + padding + bytes <= chunk.size){
+                void* memory = chunk.data + m_offset + padding;
+                m_offset += padding + bytes;
+                m_used += padding + bytes;
+                m_high_water = std::max(m_high_water, m_used);
+                return memory;
+            }
+
+            // Chunks past the current one are reused before new ones are added
+            if (m_chunk + 1 < m_chunks.size() && m_chunks[m_chunk + 1].size >= bytes + alignment){
+                m_chunk++;
+                m_offset = 0;
+                continue;
+            }
+        }
+
+        addChunk(bytes + alignment);
+    }
+}
+
+void GenerationArena::reset()
+{
+    // Fold a fragmented generation into one chunk of the high-water size
+    if (m_chunks.size() > 1){
+        for (size_t c = 0; c < m_chunks.size(); c++)
+            delete[] m_chunks[c].data;
+        m_chunks.clear();
+
+        Chunk chunk;
+        chunk.size = std::max(m_high_water + m_high_water / 4, m_initial_bytes);
+        chunk.data = new char[chunk.size];
+        m_chunks.push_back(chunk);
+    }
+
+    m_chunk = 0;
+    m_offset = 0;
+    m_used = 0;
+}
+
+size_t GenerationArena::getCapacityBytes() const
+{
+    size_t capacity = 0;
+    for (size_t c = 0; c < m_chunks.size(); c++)
+        capacity += m_chunks[c].size;
+    return capacity;
+}
+
+void GenerationArena::addChunk(size_t minBytes)
+{
+    size_t size = m_initial_bytes;
+    if (!m_chunks.empty())
+        size = m_chunks.back().size * 2;
+    size = std::max(size, minBytes);
+
+    Chunk chunk;
+    chunk.size = size;
+    chunk.data = new char[size];
+
+    // Insert after the current chunk, so the bump pointer moves on to it
+    size_t position = m_chunks.empty() ? 0 : m_chunk + 1;
+    m_chunks.insert(m_chunks.begin() + position, chunk);
+    m_chunk = position;
+    m_offset = 0;
+}
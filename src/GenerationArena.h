@@ -0,0 +1,103 @@
+
+/**
+ *
+ * Generation arena
+ *
+ * This class is a chunked bump allocator for the scratch memory of one surface
+ * generation. Allocations are never freed individually; reset() makes all of
+ * the memory available again in O(1). When a generation needed more than one
+ * chunk, the next reset replaces the chunks by a single one of the high-water
+ * size, so a steady recompute loop stops touching the system allocator.
+ *
+ * ArenaAllocator adapts the arena to standard containers (see ArenaVector).
+ * Containers must not outlive the next reset of their arena.
+ *
+ */
+
+#ifndef __GENERATION_ARENA__
+#define __GENERATION_ARENA__
+
+// STD
+#include <cstddef>
+#include <new>
+#include <vector>
+
+class GenerationArena
+{
+public:
+
+    GenerationArena(size_t initialBytes = 1 << 20);
+    ~GenerationArena();
+
+    /// Aligned memory that stays valid until the next reset.
+    void* allocate(size_t bytes, size_t alignment = 16);
+
+    /// Release everything at once.
+    void reset();
+
+    size_t getUsedBytes() const { return m_used; }
+    size_t getHighWaterBytes() const { return m_high_water; }
+    size_t getCapacityBytes() const;
+
+private:
+    GenerationArena(const GenerationArena&);
+    GenerationArena& operator=(const GenerationArena&);
+
+    struct Chunk
+    {
+        char*  data;
+        size_t size;
+    };
+
+    void addChunk(size_t minBytes);
+
+    std::vector<Chunk> m_chunks;
+    size_t m_chunk;     // chunk currently bumped
+    size_t m_offset;    // first free byte in it
+
+    size_t m_used;              // bytes handed out since the last reset
+    size_t m_high_water;        // largest m_used ever seen
+    size_t m_initial_bytes;
+};
+
+template<typename T>
+class ArenaAllocator
+{
+public:
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<typename U> struct rebind { typedef ArenaAllocator<U> other; };
+
+    ArenaAllocator(GenerationArena& arena) : m_arena(&arena) {}
+    template<typename U> ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena()) {}
+
+    T* allocate(size_t n)
+    {
+        return (T*)m_arena->allocate(n * sizeof(T), __alignof(T) > 16 ? __alignof(T) : 16);
+    }
+
+    // Memory returns to the arena on reset only
+    void deallocate(T*, size_t) {}
+
+    GenerationArena* arena() const { return m_arena; }
+
+    template<typename U> bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.arena(); }
+    template<typename U> bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.arena(); }
+
+private:
+    GenerationArena* m_arena;
+};
+
+/// A vector whose storage comes from a GenerationArena. Reserve up front: every regrowth
+/// leaves the previous block unused until the arena is reset.
+template<typename T>
+using ArenaVector = std::vector< T, ArenaAllocator<T> >;
+
+#endif
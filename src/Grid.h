@@ -64,6 +64,16 @@ public:
 	/// Get the list of primitive indices stored in a given cell.
 	GRID_INLINE std::vector<PrimitiveIndex>& getPrimitives( const size_t i, const size_t j, const size_t k );
 
+	/// Get the list of primitive indices stored in a given cell (read-only, safe for concurrent lookups).
+	GRID_INLINE const std::vector<PrimitiveIndex>& getPrimitives( const size_t i, const size_t j, const size_t k ) const;
+
+	/// Get the bounding box and the dimensions of the grid.
+	GRID_INLINE const AABB& getBounds() const;
+	GRID_INLINE void getDimensions( size_t &xDim, size_t &yDim, size_t &zDim ) const;
+
+	/// Get the bytes held by the cell table and the primitive lists (by capacity).
+	GRID_INLINE size_t getMemoryBytes() const;
+
 protected:
 
 	AABB m_bounds;
@@ -157,4 +167,32 @@ GRID_INLINE std::vector<Grid::PrimitiveIndex>& Grid::getPrimitives( const size_t
 	return m_cells[index];
 }
 
+GRID_INLINE const std::vector<Grid::PrimitiveIndex>& Grid::getPrimitives( const size_t i, const size_t j, const size_t k ) const
+{
+	assert( i<m_xDim && j<m_yDim && k<m_zDim );
+
+	const size_t index = i + ( j * m_xDim ) + ( k * m_xDim*m_yDim );
+	return m_cells[index];
+}
+
+GRID_INLINE const AABB& Grid::getBounds() const
+{
+	return m_bounds;
+}
+
+GRID_INLINE void Grid::getDimensions( size_t &xDim, size_t &yDim, size_t &zDim ) const
+{
+	xDim = m_xDim;
+	yDim = m_yDim;
+	zDim = m_zDim;
+}
+
+GRID_INLINE size_t Grid::getMemoryBytes() const
+{
+	size_t bytes = m_cells.capacity() * sizeof( std::vector<PrimitiveIndex> );
+	for ( size_t c = 0; c < m_cells.size(); c++ )
+		bytes += m_cells[c].capacity() * sizeof( PrimitiveIndex );
+	return bytes;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "JsonWriter.h"
+
+// STD
+#include <cmath>
+#include <cstdio>
+
+JsonWriter::JsonWriter(std::ostream& out)
+    : m_out(out)
+{
+    m_after_key = false;
+}
+
+void JsonWriter::indent()
+{
+    m_out << "\n";
+    for (size_t i = 0; i < m_object.size(); i++)
+        m_out << "  ";
+}
+
+void JsonWriter::separate()
+{
+    // A value right after its key stays on the key's line
+    if (m_after_key){
+        m_after_key = false;
+        return;
+    }
+
+    if (m_filled.empty())
+        return;
+
+    if (m_filled.back())
+        m_out << ",";
+    m_filled.back() = true;
+    indent();
+}
+
+void JsonWriter::beginObject()
+{
+    separate();
+    m_out << "{";
+    m_object.push_back(true);
+    m_filled.push_back(false);
+}
+
+void JsonWriter::endObject()
+{
+    bool filled = m_filled.back();
+    m_object.pop_back();
+    m_filled.pop_back();
+
+    if (filled)
+        indent();
+    m_out << "}";
+
+    if (m_object.empty())
+        m_out << "\n";
+}
+
+void JsonWriter::beginArray()
+{
+    separate();
+    m_out << "[";
+    m_object.push_back(false);
+    m_filled.push_back(false);
+}
+
+void JsonWriter::endArray()
+{
+    bool filled = m_filled.back();
+    m_object.pop_back();
+    m_filled.pop_back();
+
+    if (filled)
+        indent();
+    m_out << "]";
+
+    if (m_object.empty())
+        m_out << "\n";
+}
+
+JsonWriter& JsonWriter::key(const std::string& name)
+{
+    separate();
+    m_out << "\"" << escape(name) << "\": ";
+    m_after_key = true;
+    return *this;
+}
+
+void JsonWriter::value(const std::string& text)
+{
+    separate();
+    m_out << "\"" << escape(text) << "\"";
+}
+
+void JsonWriter::value(const char* text)
+{
+    value(std::string(text ? text : ""));
+}
+
+void JsonWriter::value(double number)
+{
+    separate();
+
+    // JSON has no representation for infinities and NaN
+    if (number != number || std::abs(number) > 1.0e308){
+        m_out << "null";
+        return;
+    }
+
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.10g", number);
+    m_out << text;
+}
+
+void JsonWriter::value(long long number)
+{
+    separate();
+    m_out << number;
+}
+
+void JsonWriter::value(unsigned long long number)
+{
+    separate();
+    m_out << number;
+}
+
+void JsonWriter::value(bool flag)
+{
+    separate();
+    m_out << (flag ? "true" : "false");
+}
+
+void JsonWriter::null()
+{
+    separate();
+    m_out << "null";
+}
+
+std::string JsonWriter::escape(const std::string& text)
+{
+    std::string result;
+    result.reserve(text.size());
+
+    for (size_t i = 0; i < text.size(); i++){
+        unsigned char c = (unsigned char)text[i];
+        switch (c){
+        case '"':  result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n";  break;
+        case '\r': result += "\\r";  break;
+        case '\t': result += "\\t";  break;
+        default:
+            if (c < 0x20){
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", c);
+                result += code;
+            }
+            else
+                result += (char)c;
+        }
+    }
+
+    return result;
+}
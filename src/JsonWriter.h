@@ -0,0 +1,59 @@
+
+/**
+ *
+ * Minimal streaming JSON writer
+ *
+ * This class writes JSON reports (batch statistics, benchmark results) to a
+ * stream without building a document in memory. Objects and arrays are opened
+ * and closed explicitly; separators, indentation and string escaping are
+ * handled here. Inside an object every value is preceded by key().
+ *
+ */
+
+#ifndef __JSON_WRITER__
+#define __JSON_WRITER__
+
+// STD
+#include <ostream>
+#include <string>
+#include <vector>
+
+class JsonWriter
+{
+public:
+    JsonWriter(std::ostream& out);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    JsonWriter& key(const std::string& name);
+
+    void value(const std::string& text);
+    void value(const char* text);
+    void value(double number);
+    void value(long long number);
+    void value(unsigned long long number);
+    void value(int number)              { value((long long)number); }
+    void value(unsigned int number)     { value((unsigned long long)number); }
+    void value(long number)             { value((long long)number); }
+    void value(unsigned long number)    { value((unsigned long long)number); }
+    void value(bool flag);
+    void null();
+
+    static std::string escape(const std::string& text);
+
+private:
+    void separate();
+    void indent();
+
+    std::ostream& m_out;
+
+    // Per open scope: true for objects; whether it has an element yet
+    std::vector<bool> m_object;
+    std::vector<bool> m_filled;
+    bool m_after_key;
+};
+
+#endif
@@ -0,0 +1,172 @@
+
+/**
+ *
+ * Memory-bounded cache of data loaded on demand
+ *
+ * This class keeps entries that are expensive to load, such as the time steps
+ * of a series or the bricks of an out-of-core field, in an LRU bounded by their
+ * bytes. Entries are keyed by index and filled by a loader callback. A miss is
+ * loaded with the lock released, so lookups of resident entries go on in the
+ * meantime, and an entry that is being loaded is waited for rather than loaded
+ * twice. Different entries load concurrently unless the loader serializes itself.
+ *
+ * The cache has no lock of its own: it is guarded by a mutex of its owner, held
+ * for every call, which find() releases while it loads. Entries are handed out
+ * as shared pointers, so entries in use stay alive when they are evicted.
+ *
+ *   std::unique_lock<std::mutex> lock(m_mutex);
+ *   LoadingCache<Brick>::Ptr brick = m_cache.find(index, lock);
+ *
+ */
+
+#ifndef __LOADING_CACHE__
+#define __LOADING_CACHE__
+
+// STD
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+template<typename T>
+class LoadingCache
+{
+public:
+
+    typedef std::shared_ptr<const T> Ptr;
+
+    /// Fill the entry of an index and tell the bytes it holds; false if it cannot be loaded.
+    typedef std::function<bool(size_t index, T& value, size_t& bytes)> Loader;
+
+    /// Eviction keeps the minResident most recently used entries, even if they alone exceed the budget.
+    LoadingCache(size_t maxResidentBytes, size_t minResident)
+        : m_resident_bytes(0), m_max_resident_bytes(maxResidentBytes), m_min_resident(minResident),
+          m_loads(0), m_evictions(0) {}
+
+    /// Drop all entries and counts once the loads in flight are done.
+    void clear(std::unique_lock<std::mutex>& lock)
+    {
+        // Loads in flight still use the loader and what it reads from
+        while (!m_loading.empty())
+            m_loaded.wait(lock);
+
+        m_lru.clear();
+        m_entries.clear();
+        m_resident_bytes = 0;
+        m_loads = m_evictions = 0;
+    }
+
+    /// Clear the cache and load with another loader from now on.
+    void reset(std::unique_lock<std::mutex>& lock, const Loader& loader)
+    {
+        clear(lock);
+        m_loader = loader;
+    }
+
+    /// The entry of an index from the cache, or loaded with the lock released. Called and returns
+    /// with the lock held. NULL if it cannot be loaded; loaded (if given) tells whether this call loaded it.
+    Ptr find(size_t index, std::unique_lock<std::mutex>& lock, bool* loaded = NULL)
+    {
+        if (loaded)
+            *loaded = false;
+
+        for (;;){
+            typename EntryMap::iterator it = m_entries.find(index);
+            if (it != m_entries.end()){
+                m_lru.splice(m_lru.begin(), m_lru, it->second);
+                return it->second->value;
+            }
+
+            if (m_loading.count(index) == 0)
+                break;
+            m_loaded.wait(lock);
+        }
+
+        m_loading.insert(index);
+        Loader loader = m_loader;
+        lock.unlock();
+
+        std::shared_ptr<T> value(new T);
+        size_t bytes = 0;
+        bool success = loader && loader(index, *value, bytes);
+
+        lock.lock();
+        m_loading.erase(index);
+        m_loaded.notify_all();
+
+        if (!success)
+            return Ptr();
+
+        Entry entry;
+        entry.index = index;
+        entry.value = value;
+        entry.bytes = bytes;
+        m_lru.push_front(entry);
+        m_entries[index] = m_lru.begin();
+        m_resident_bytes += bytes;
+        m_loads++;
+
+        if (loaded)
+            *loaded = true;
+
+        evict();
+        return value;
+    }
+
+    bool contains(size_t index) const { return m_entries.count(index) > 0; }
+    bool loading(size_t index) const  { return m_loading.count(index) > 0; }
+
+    void setMaxResidentBytes(size_t bytes)
+    {
+        m_max_resident_bytes = bytes;
+        evict();
+    }
+
+    size_t getMaxResidentBytes() const { return m_max_resident_bytes; }
+    size_t getResidentBytes() const    { return m_resident_bytes; }
+    size_t getResidentCount() const    { return m_lru.size(); }
+
+    /// Entries loaded and dropped since the cache was cleared.
+    unsigned long long getLoads() const     { return m_loads; }
+    unsigned long long getEvictions() const { return m_evictions; }
+
+private:
+    LoadingCache(const LoadingCache&);
+    LoadingCache& operator=(const LoadingCache&);
+
+    struct Entry
+    {
+        size_t index;
+        Ptr    value;
+        size_t bytes;
+    };
+
+    typedef std::list<Entry> LRUList;
+    typedef std::unordered_map< size_t, typename LRUList::iterator > EntryMap;
+
+    void evict()
+    {
+        while (m_resident_bytes > m_max_resident_bytes && m_lru.size() > m_min_resident){
+            m_resident_bytes -= m_lru.back().bytes;
+            m_entries.erase(m_lru.back().index);
+            m_lru.pop_back();
+            m_evictions++;
+        }
+    }
+
+    Loader      m_loader;
+    LRUList     m_lru;      // most recently used first
+    EntryMap    m_entries;
+    size_t      m_resident_bytes, m_max_resident_bytes, m_min_resident;
+
+    // Entries being loaded and their completion
+    std::unordered_set<size_t>  m_loading;
+    std::condition_variable     m_loaded;
+
+    unsigned long long m_loads, m_evictions;
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include "MemoryReport.h"
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <string>
+
+#ifdef _WIN32
+#    include <windows.h>
+#    include <psapi.h>
+#    pragma comment(lib, "psapi.lib")
+#endif
+
+// Stream Tracer
+#include "JsonWriter.h"
+
+#ifdef STREAM_SURFACE_MEMORY_TRACKING
+
+namespace
+{
+    // Every block starts with its size; 16 bytes keep the alignment malloc guarantees
+    const size_t HEADER_BYTES = 16;
+
+    std::atomic<long long> g_heap_bytes(0);
+    std::atomic<long long> g_peak_heap_bytes(0);
+
+    void* trackedAllocate(size_t size)
+    {
+        char* block = (char*)std::malloc(size + HEADER_BYTES);
+        if (!block)
+            return NULL;
+        *(size_t*)block = size;
+
+        long long bytes = g_heap_bytes.fetch_add((long long)size, std::memory_order_relaxed) + (long long)size;
+        long long peak = g_peak_heap_bytes.load(std::memory_order_relaxed);
+        while (bytes > peak && !g_peak_heap_bytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {}
+
+        return block + HEADER_BYTES;
+    }
+
+    void trackedRelease(void* pointer)
+    {
+        if (!pointer)
+            return;
+
+        char* block = (char*)pointer - HEADER_BYTES;
+        g_heap_bytes.fetch_sub((long long)*(size_t*)block, std::memory_order_relaxed);
+        std::free(block);
+    }
+}
+
+// Replacing the global operators routes every new and delete of the program through the counters
+void* operator new(size_t size)
+{
+    void* pointer = trackedAllocate(size > 0 ? size : 1);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&)
+{
+    return trackedAllocate(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&)
+{
+    return trackedAllocate(size > 0 ? size : 1);
+}
+
+void operator delete(void* pointer)
+{
+    trackedRelease(pointer);
+}
+
+void operator delete[](void* pointer)
+{
+    trackedRelease(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&)
+{
+    trackedRelease(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&)
+{
+    trackedRelease(pointer);
+}
+
+bool MemoryReport::heapTracking()
+{
+    return true;
+}
+
+long long MemoryReport::heapBytes()
+{
+    return g_heap_bytes.load(std::memory_order_relaxed);
+}
+
+long long MemoryReport::peakHeapBytes()
+{
+    return g_peak_heap_bytes.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool MemoryReport::heapTracking()
+{
+    return false;
+}
+
+long long MemoryReport::heapBytes()
+{
+    return -1;
+}
+
+long long MemoryReport::peakHeapBytes()
+{
+    return -1;
+}
+
+#endif
+
+namespace
+{
+#ifdef __linux__
+    /// A "Vm...:  1234 kB" line of /proc/self/status.
+    unsigned long long statusBytes(const char* field)
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        size_t length = std::strlen(field);
+        while (std::getline(status, line)){
+            if (line.compare(0, length, field) == 0 && line.size() > length && line[length] == ':')
+                return std::strtoull(line.c_str() + length + 1, NULL, 10) * 1024ULL;
+        }
+        return 0;
+    }
+#endif
+
+    double megabytes(long long bytes)
+    {
+        return (double)bytes / (1024.0 * 1024.0);
+    }
+}
+
+unsigned long long MemoryReport::residentBytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (unsigned long long)counters.WorkingSetSize;
+    return 0;
+#elif defined(__linux__)
+    return statusBytes("VmRSS");
+#else
+    return 0;
+#endif
+}
+
+unsigned long long MemoryReport::peakResidentBytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return (unsigned long long)counters.PeakWorkingSetSize;
+    return 0;
+#elif defined(__linux__)
+    return statusBytes("VmHWM");
+#else
+    return 0;
+#endif
+}
+
+void MemoryReport::resetPeaks()
+{
+#ifdef STREAM_SURFACE_MEMORY_TRACKING
+    g_peak_heap_bytes.store(g_heap_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+#endif
+
+#ifdef __linux__
+    // Writing 5 resets VmHWM to the current resident size (Linux 4.0 and later)
+    std::FILE* clearRefs = std::fopen("/proc/self/clear_refs", "w");
+    if (clearRefs){
+        std::fputs("5", clearRefs);
+        std::fclose(clearRefs);
+    }
+#endif
+}
+
+MemoryReport::MemoryReport()
+{
+}
+
+void MemoryReport::add(const std::string& name, unsigned long long bytes)
+{
+    Item item = { name, bytes };
+    m_items.push_back(item);
+}
+
+void MemoryReport::add(const std::vector<Item>& items)
+{
+    m_items.insert(m_items.end(), items.begin(), items.end());
+}
+
+void MemoryReport::endPhase(const std::string& name)
+{
+    Phase phase;
+    phase.name = name;
+    phase.items.swap(m_items);
+    phase.itemBytes = 0;
+    for (size_t i = 0; i < phase.items.size(); i++)
+        phase.itemBytes += phase.items[i].bytes;
+
+    phase.residentBytes     = residentBytes();
+    phase.peakResidentBytes = peakResidentBytes();
+    phase.heapBytes         = heapBytes();
+    phase.peakHeapBytes     = peakHeapBytes();
+    resetPeaks();
+
+    for (size_t p = 0; p < m_phases.size(); p++){
+        if (m_phases[p].name == name){
+            m_phases[p] = phase;
+            return;
+        }
+    }
+    m_phases.push_back(phase);
+}
+
+void MemoryReport::clear()
+{
+    m_items.clear();
+    m_phases.clear();
+    resetPeaks();
+}
+
+void MemoryReport::print(std::ostream& out) const
+{
+    // Rows in the order the items first appear
+    std::vector<std::string> names;
+    size_t width = 24;
+    for (size_t p = 0; p < m_phases.size(); p++){
+        for (size_t i = 0; i < m_phases[p].items.size(); i++){
+            const std::string& name = m_phases[p].items[i].name;
+            if (std::find(names.begin(), names.end(), name) == names.end()){
+                names.push_back(name);
+                width = std::max(width, name.size() + 2);
+            }
+        }
+    }
+
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+
+    out << "Memory (MB)" << std::string(width - 11, ' ');
+    for (size_t p = 0; p < m_phases.size(); p++)
+        out << std::setw(14) << m_phases[p].name;
+    out << "\n";
+
+    for (size_t n = 0; n < names.size(); n++){
+        out << std::left << std::setw((int)width) << names[n] << std::right;
+        for (size_t p = 0; p < m_phases.size(); p++){
+            const std::vector<Item>& items = m_phases[p].items;
+            unsigned long long bytes = 0;
+            bool found = false;
+            for (size_t i = 0; i < items.size(); i++){
+                if (items[i].name == names[n]){
+                    bytes += items[i].bytes;
+                    found = true;
+                }
+            }
+            if (found)
+                out << std::setw(14) << megabytes((long long)bytes);
+            else
+                out << std::setw(14) << "-";
+        }
+        out << "\n";
+    }
+
+    struct Row { const char* name; int column; };
+    static const Row rows[] = {
+        { "listed", 0 }, { "resident", 1 }, { "peak resident", 2 }, { "heap", 3 }, { "peak heap", 4 }
+    };
+    for (size_t r = 0; r < sizeof(rows) / sizeof(rows[0]); r++){
+        if (rows[r].column >= 3 && !heapTracking())
+            continue;
+
+        out << std::left << std::setw((int)width) << rows[r].name << std::right;
+        for (size_t p = 0; p < m_phases.size(); p++){
+            const Phase& phase = m_phases[p];
+            long long values[] = { (long long)phase.itemBytes, (long long)phase.residentBytes, (long long)phase.peakResidentBytes,
+                                   phase.heapBytes, phase.peakHeapBytes };
+            out << std::setw(14) << megabytes(values[rows[r].column]);
+        }
+        out << "\n";
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void MemoryReport::writeJson(JsonWriter& json) const
+{
+    json.beginObject();
+    json.key("heap_tracking").value(heapTracking());
+    json.key("phases").beginArray();
+    for (size_t p = 0; p < m_phases.size(); p++){
+        const Phase& phase = m_phases[p];
+
+        json.beginObject();
+        json.key("name").value(phase.name);
+        json.key("listed_bytes").value(phase.itemBytes);
+        json.key("resident_bytes").value(phase.residentBytes);
+        json.key("peak_resident_bytes").value(phase.peakResidentBytes);
+        if (heapTracking()){
+            json.key("heap_bytes").value(phase.heapBytes);
+            json.key("peak_heap_bytes").value(phase.peakHeapBytes);
+        }
+        json.key("items").beginObject();
+        for (size_t i = 0; i < phase.items.size(); i++)
+            json.key(phase.items[i].name).value(phase.items[i].bytes);
+        json.endObject();
+        json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+}
@@ -0,0 +1,100 @@
+
+/**
+ *
+ * Memory accounting
+ *
+ * This class collects the bytes held by the large containers of each subsystem
+ * (field, acceleration grid, surface meshes, GPU buffers) at the end of a phase,
+ * together with the process numbers of that phase:
+ *
+ *   MemoryReport report;
+ *   tracer.loadOpenFOAM(filename);
+ *   tracer.reportMemory(report);
+ *   report.endPhase("load");
+ *
+ * Containers are counted by capacity, which is what they occupy. The peak of a
+ * phase is the peak resident set size since the previous endPhase(); on Windows
+ * the operating system only keeps the peak of the whole process. Builds with the
+ * CMake option STREAM_SURFACE_GENERATOR_MEMORY_TRACKING also replace the global
+ * operator new and delete to count live heap bytes and their peak per phase,
+ * including the allocations no subsystem reports.
+ *
+ */
+
+#ifndef __MEMORY_REPORT__
+#define __MEMORY_REPORT__
+
+// STD
+#include <ostream>
+#include <string>
+#include <vector>
+
+class JsonWriter;
+
+class MemoryReport
+{
+public:
+
+    struct Item
+    {
+        std::string        name;    // "subsystem/container"
+        unsigned long long bytes;
+    };
+
+    struct Phase
+    {
+        std::string         name;
+        std::vector<Item>   items;
+        unsigned long long  itemBytes;          // sum of the items
+        unsigned long long  residentBytes;      // 0 where the platform does not tell
+        unsigned long long  peakResidentBytes;
+        long long           heapBytes;          // -1 without heap tracking
+        long long           peakHeapBytes;
+    };
+
+    MemoryReport();
+
+    /// Count a container of the phase being collected.
+    void add(const std::string& name, unsigned long long bytes);
+
+    template <class T>
+    void add(const std::string& name, const std::vector<T>& container)
+    {
+        add(name, (unsigned long long)container.capacity() * sizeof(T));
+    }
+
+    /// Items collected elsewhere, e.g. on the thread that owns the containers.
+    void add(const std::vector<Item>& items);
+
+    /// The items of the phase being collected.
+    const std::vector<Item>& getItems() const { return m_items; }
+
+    /// Close the phase: take the process numbers and start the next phase. A phase
+    /// that already exists under this name is replaced.
+    void endPhase(const std::string& name);
+
+    void clear();
+
+    const std::vector<Phase>& getPhases() const { return m_phases; }
+
+    /// One table: the items of all phases side by side, then the process numbers.
+    void print(std::ostream& out) const;
+    void writeJson(JsonWriter& json) const;
+
+    /// Resident set size of the process, and its peak since the last resetPeaks().
+    static unsigned long long residentBytes();
+    static unsigned long long peakResidentBytes();
+
+    /// Whether this build counts heap allocations, the live heap bytes and their peak since the last resetPeaks().
+    static bool heapTracking();
+    static long long heapBytes();
+    static long long peakHeapBytes();
+
+    static void resetPeaks();
+
+private:
+    std::vector<Item>  m_items;
+    std::vector<Phase> m_phases;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "MeshGeometry.h"
+
+// STD
+#include <cstring>
+#include <unordered_map>
+
+// Stream Tracer
+#include "Profiler.h"
+
+namespace
+{
+    // Geometries alive by content hash; entries expire with their last tracer
+    std::unordered_multimap< MeshGeometry::Hash, std::weak_ptr<MeshGeometry> > g_geometries;
+    std::mutex g_geometries_mutex;
+
+    // FNV-1a over 32 bit words: both arrays are made of floats. The words are copied
+    // out, since reading floats through an integer pointer breaks strict aliasing.
+    void hashWords(MeshGeometry::Hash& hash, const void* data, size_t bytes)
+    {
+        const unsigned char* bytePointer = (const unsigned char*)data;
+        for (size_t i = 0; i + sizeof(unsigned int) <= bytes; i += sizeof(unsigned int)){
+            unsigned int word;
+            std::memcpy(&word, bytePointer + i, sizeof(word));
+            hash ^= word;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    template<typename T> bool equalArrays(const std::vector<T>& a, const std::vector<T>& b)
+    {
+        return a.size() == b.size() && (a.empty() || std::memcmp(&a[0], &b[0], sizeof(T) * a.size()) == 0);
+    }
+
+    void pruneExpired()
+    {
+        for (std::unordered_multimap< MeshGeometry::Hash, std::weak_ptr<MeshGeometry> >::iterator it = g_geometries.begin(); it != g_geometries.end();){
+            if (it->second.expired())
+                it = g_geometries.erase(it);
+            else
+                ++it;
+        }
+    }
+}
+
+MeshGeometry::MeshGeometry()
+{
+    m_hash = 0;
+    m_accel_built = false;
+    m_accel_granularity = 0.0f;
+    m_accel_dims[0] = m_accel_dims[1] = m_accel_dims[2] = 0;
+}
+
+MeshGeometry::Hash MeshGeometry::computeHash(const std::vector<AABB>& cellBoxes, const std::vector<glm::vec3>& cellPoints)
+{
+    PROFILE_ZONE("MeshGeometry::computeHash");
+
+    Hash hash = 14695981039346656037ULL;
+    unsigned long long sizes[2] = { cellBoxes.size(), cellPoints.size() };
+    hashWords(hash, sizes, sizeof(sizes));
+    if (!cellBoxes.empty())
+        hashWords(hash, &cellBoxes[0], sizeof(AABB) * cellBoxes.size());
+    if (!cellPoints.empty())
+        hashWords(hash, &cellPoints[0], sizeof(glm::vec3) * cellPoints.size());
+    return hash;
+}
+
+std::shared_ptr<MeshGeometry> MeshGeometry::share(std::vector<AABB>& cellBoxes, std::vector<glm::vec3>& cellPoints)
+{
+    Hash hash = computeHash(cellBoxes, cellPoints);
+
+    std::lock_guard<std::mutex> lock(g_geometries_mutex);
+    pruneExpired();
+
+    typedef std::unordered_multimap< Hash, std::weak_ptr<MeshGeometry> >::iterator Iterator;
+    std::pair<Iterator, Iterator> range = g_geometries.equal_range(hash);
+    for (Iterator it = range.first; it != range.second; ++it){
+        std::shared_ptr<MeshGeometry> geometry = it->second.lock();
+        if (geometry && equalArrays(geometry->m_cellBoxes, cellBoxes) && equalArrays(geometry->m_cellPoints, cellPoints)){
+            std::vector<AABB>().swap(cellBoxes);
+            std::vector<glm::vec3>().swap(cellPoints);
+            return geometry;
+        }
+    }
+
+    std::shared_ptr<MeshGeometry> geometry(new MeshGeometry);
+    geometry->m_hash = hash;
+    geometry->m_cellBoxes.swap(cellBoxes);
+    geometry->m_cellPoints.swap(cellPoints);
+    std::vector<AABB>().swap(cellBoxes);
+    std::vector<glm::vec3>().swap(cellPoints);
+
+    g_geometries.insert(std::make_pair(hash, std::weak_ptr<MeshGeometry>(geometry)));
+    return geometry;
+}
+
+bool MeshGeometry::buildAccel(float granularity, size_t xDim, size_t yDim, size_t zDim)
+{
+    // Tracers sharing the geometry may ask at the same time; the first one builds
+    std::lock_guard<std::mutex> lock(m_accel_mutex);
+    if (m_accel_built)
+        return false;
+
+    m_sceneBox = AABB();
+    for (size_t i=0; i<m_cellBoxes.size(); i++)
+        m_sceneBox.extend(m_cellBoxes[i]);
+
+    // Enlarge grid box to avoid primitives on boundaries
+    const float EPSILON = 0.0001f;
+    AABB accelBox = m_sceneBox;
+    accelBox.enlarge(EPSILON);
+
+    if (xDim > 0 && yDim > 0 && zDim > 0)
+        m_sceneAccel.reset(accelBox, xDim, yDim, zDim);
+    else
+        m_sceneAccel.reset(accelBox, granularity);
+
+    m_accel_granularity = granularity;
+    m_accel_dims[0] = xDim;
+    m_accel_dims[1] = yDim;
+    m_accel_dims[2] = zDim;
+
+    {
+        PROFILE_ZONE("insertPrimitiveList");
+        m_sceneAccel.insertPrimitiveList(m_cellBoxes);
+    }
+
+    m_accel_built = true;
+    return true;
+}
+
+bool MeshGeometry::accelBuiltWith(float granularity, size_t xDim, size_t yDim, size_t zDim) const
+{
+    std::lock_guard<std::mutex> lock(m_accel_mutex);
+    if (!m_accel_built)
+        return false;
+
+    // Fixed dimensions override the granularity
+    bool fixed = xDim > 0 && yDim > 0 && zDim > 0;
+    bool builtFixed = m_accel_dims[0] > 0 && m_accel_dims[1] > 0 && m_accel_dims[2] > 0;
+    if (fixed || builtFixed)
+        return m_accel_dims[0] == xDim && m_accel_dims[1] == yDim && m_accel_dims[2] == zDim;
+
+    return m_accel_granularity == granularity;
+}
+
+void MeshGeometry::clearAccel()
+{
+    std::lock_guard<std::mutex> lock(m_accel_mutex);
+    m_sceneAccel = Grid();
+    m_sceneBox = AABB();
+    m_accel_built = false;
+    m_accel_granularity = 0.0f;
+    m_accel_dims[0] = m_accel_dims[1] = m_accel_dims[2] = 0;
+}
+
+unsigned long long MeshGeometry::getMemoryBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_accel_mutex);
+    return (unsigned long long)m_cellBoxes.capacity() * sizeof(AABB)
+         + (unsigned long long)m_cellPoints.capacity() * sizeof(glm::vec3)
+         + (unsigned long long)m_sceneAccel.getMemoryBytes();
+}
+
+size_t MeshGeometry::sharedCount()
+{
+    std::lock_guard<std::mutex> lock(g_geometries_mutex);
+    pruneExpired();
+    return g_geometries.size();
+}
+
+unsigned long long MeshGeometry::sharedBytes()
+{
+    std::lock_guard<std::mutex> lock(g_geometries_mutex);
+
+    unsigned long long bytes = 0;
+    for (std::unordered_multimap< Hash, std::weak_ptr<MeshGeometry> >::const_iterator it = g_geometries.begin(); it != g_geometries.end(); ++it){
+        std::shared_ptr<MeshGeometry> geometry = it->second.lock();
+        if (geometry)
+            bytes += geometry->getMemoryBytes();
+    }
+    return bytes;
+}
@@ -0,0 +1,99 @@
+
+/**
+ *
+ * Shared mesh geometry
+ *
+ * This class holds what the datasets of one mesh have in common: the cell
+ * bounds, the points and the acceleration grid over the cells. Time steps and
+ * ensemble runs of an OpenFOAM case usually share one polyMesh, so tracers
+ * attach to one reference-counted geometry and only keep their velocities:
+ *
+ *   std::shared_ptr<MeshGeometry> geometry = MeshGeometry::share(boxes, points);
+ *
+ * Geometries are identified by a hash of their contents and compared in full
+ * on a hash match, so only identical meshes are shared. The registry holds no
+ * references; a geometry is freed with the last tracer that uses it.
+ *
+ * The grid is built once and then only read, by any number of threads. A
+ * tracer that is the only user of its geometry may clear and rebuild it; a
+ * shared geometry keeps the grid of its first build, which the other tracers
+ * may be reading, and accelBuiltWith() tells whether that grid has the
+ * dimensions a tracer asked for.
+ *
+ */
+
+#ifndef __MESH_GEOMETRY__
+#define __MESH_GEOMETRY__
+
+// STD
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "AABB.h"
+#include "Grid.h"
+
+class MeshGeometry
+{
+public:
+
+    typedef unsigned long long Hash;
+
+    /// An empty geometry, shared with no one.
+    MeshGeometry();
+
+    /// The registered geometry with these contents, or a new one that takes them over.
+    /// The vectors are left empty either way.
+    static std::shared_ptr<MeshGeometry> share(std::vector<AABB>& cellBoxes, std::vector<glm::vec3>& cellPoints);
+
+    /// Build the grid over the cells: with a granularity (cells per unit) or with fixed
+    /// dimensions (all zero: the granularity). Returns false if the grid was already built.
+    bool buildAccel(float granularity, size_t xDim = 0, size_t yDim = 0, size_t zDim = 0);
+
+    /// Drop the grid, e.g. to build it again. Only while nobody else traces with the geometry.
+    void clearAccel();
+
+    bool hasAccel() const { return m_accel_built; }
+
+    /// Whether the grid was built with these parameters (see buildAccel()).
+    bool accelBuiltWith(float granularity, size_t xDim = 0, size_t yDim = 0, size_t zDim = 0) const;
+
+    Hash getHash() const { return m_hash; }
+
+    const std::vector<AABB>&      getCellBoxes() const  { return m_cellBoxes; }
+    const std::vector<glm::vec3>& getCellPoints() const { return m_cellPoints; }
+    const AABB&                   getSceneBox() const   { return m_sceneBox; }
+    const Grid&                   getSceneAccel() const { return m_sceneAccel; }
+
+    /// Geometries alive and their bytes, counted once however many tracers share them.
+    static size_t sharedCount();
+    static unsigned long long sharedBytes();
+
+    unsigned long long getMemoryBytes() const;
+
+private:
+    MeshGeometry(const MeshGeometry&);
+    MeshGeometry& operator=(const MeshGeometry&);
+
+    static Hash computeHash(const std::vector<AABB>& cellBoxes, const std::vector<glm::vec3>& cellPoints);
+
+    Hash                   m_hash;
+    std::vector<AABB>      m_cellBoxes;
+    std::vector<glm::vec3> m_cellPoints;
+
+    AABB m_sceneBox;
+    Grid m_sceneAccel;
+    bool m_accel_built;
+
+    // Parameters of the grid build
+    float  m_accel_granularity;
+    size_t m_accel_dims[3];
+
+    mutable std::mutex m_accel_mutex;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "MeshOptimizer.h"
+
+// STD
+#include <algorithm>
+#include <climits>
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& faces, size_t nVertices, unsigned int cacheSize)
+{
+    size_t nFaces = faces.size() / 3;
+    if (nFaces == 0 || nVertices == 0)
+        return;
+
+    // Vertex to triangle adjacency (compressed rows) and the number of triangles left per vertex
+    std::vector<unsigned int> offsets(nVertices + 1, 0);
+    for (size_t i = 0; i < nFaces * 3; i++)
+        offsets[faces[i] + 1]++;
+    for (size_t v = 0; v < nVertices; v++)
+        offsets[v + 1] += offsets[v];
+
+    std::vector<unsigned int> live(nVertices);
+    for (size_t v = 0; v < nVertices; v++)
+        live[v] = offsets[v + 1] - offsets[v];
+
+    std::vector<unsigned int> adjacency(nFaces * 3);
+    {
+        std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < nFaces * 3; i++)
+            adjacency[cursor[faces[i]]++] = (unsigned int)(i / 3);
+    }
+
+    // A vertex is in the cache while time - timestamp <= cacheSize
+    std::vector<unsigned int> timestamp(nVertices, 0);
+    unsigned int time = cacheSize + 1;
+
+    std::vector<bool> emitted(nFaces, false);
+    std::vector<unsigned int> result;
+    result.reserve(nFaces * 3);
+
+    // Vertices of recently emitted triangles, the first place to look after a dead end
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    size_t cursor = 0;
+
+    unsigned int fanning = 0;
+    while (fanning != UINT_MAX){
+        candidates.clear();
+
+        // Emit the whole remaining fan around the current vertex
+        for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++){
+            unsigned int f = adjacency[a];
+            if (emitted[f])
+                continue;
+
+            for (int c = 0; c < 3; c++){
+                unsigned int v = faces[f * 3 + c];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+
+                if (time - timestamp[v] > cacheSize)
+                    timestamp[v] = time++;
+            }
+            emitted[f] = true;
+        }
+
+        // Next fan: the candidate that stays in the cache longest while its remaining fan is emitted
+        unsigned int best = UINT_MAX;
+        int bestPriority = -1;
+        for (size_t c = 0; c < candidates.size(); c++){
+            unsigned int v = candidates[c];
+            if (live[v] == 0)
+                continue;
+
+            int priority = 0;
+            if (time - timestamp[v] + 2 * live[v] <= cacheSize)
+                priority = (int)(time - timestamp[v]);
+
+            if (priority > bestPriority){
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        // Dead end: go back through recent vertices, then scan forward for anything left
+        while (best == UINT_MAX && !deadEnd.empty()){
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                best = v;
+        }
+        while (best == UINT_MAX && cursor < nVertices){
+            if (live[cursor] > 0)
+                best = (unsigned int)cursor;
+            cursor++;
+        }
+
+        fanning = best;
+    }
+
+    faces.swap(result);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<unsigned int>& faces, size_t nVertices, size_t nFixed,
+                                        std::vector<unsigned int>& remap)
+{
+    nFixed = std::min(nFixed, nVertices);
+
+    remap.assign(nVertices, UINT_MAX);
+    for (size_t v = 0; v < nFixed; v++)
+        remap[v] = (unsigned int)v;
+
+    unsigned int next = (unsigned int)nFixed;
+    for (size_t i = 0; i < faces.size(); i++){
+        unsigned int& index = faces[i];
+        if (remap[index] == UINT_MAX)
+            remap[index] = next++;
+        index = remap[index];
+    }
+
+    for (size_t v = nFixed; v < nVertices; v++){
+        if (remap[v] == UINT_MAX)
+            remap[v] = next++;
+    }
+}
+
+float MeshOptimizer::computeACMR(ArrayView<unsigned int> faces, size_t nVertices, unsigned int cacheSize)
+{
+    size_t nFaces = faces.size() / 3;
+    if (nFaces == 0)
+        return 0.0f;
+
+    // FIFO: a vertex is cached while fewer than cacheSize misses happened since its own
+    std::vector<size_t> missedAt(nVertices, 0);
+    size_t misses = 0;
+
+    for (size_t i = 0; i < nFaces * 3; i++){
+        unsigned int v = faces[i];
+        if (missedAt[v] == 0 || misses - missedAt[v] >= cacheSize){
+            misses++;
+            missedAt[v] = misses;
+        }
+    }
+
+    return (float)misses / (float)nFaces;
+}
@@ -0,0 +1,57 @@
+
+/**
+ *
+ * Index and vertex reordering for the GPU
+ *
+ * The triangles of a traced surface come in the order of the ribbon recursion,
+ * which reuses few vertices from the post-transform cache. This class reorders
+ * the triangles with Tipsify (Sander et al., "Fast Triangle Reordering for Vertex
+ * Locality and Reduced Overdraw"), which runs in linear time, and then renumbers
+ * the vertices in the order the triangles first use them, so vertex fetches walk
+ * through memory instead of jumping around.
+ *
+ * The average cache miss ratio (ACMR, transformed vertices per triangle) of a FIFO
+ * cache measures the result: about 3 is the worst, 0.5 the limit for large meshes.
+ *
+ */
+
+#ifndef __MESH_OPTIMIZER__
+#define __MESH_OPTIMIZER__
+
+// STD
+#include <vector>
+
+// Stream Tracer
+#include "ArrayView.h"
+
+class MeshOptimizer
+{
+public:
+
+    /// Reorder the triangles for a post-transform cache of cacheSize vertices.
+    static void optimizeVertexCache(std::vector<unsigned int>& faces, size_t nVertices, unsigned int cacheSize = 16);
+
+    /// Renumber the vertices in order of first use by the triangles and rewrite the indices.
+    /// The vertices [0, nFixed) keep their numbers, vertices no triangle uses move to the end.
+    /// remap[old] is the new number of a vertex; apply it to the attributes with remapVertices.
+    static void optimizeVertexFetch(std::vector<unsigned int>& faces, size_t nVertices, size_t nFixed,
+                                    std::vector<unsigned int>& remap);
+
+    /// Move every value to its new position. Arrays that do not hold one value per vertex stay as they are.
+    template<typename T>
+    static void remapVertices(std::vector<T>& values, const std::vector<unsigned int>& remap)
+    {
+        if (values.size() != remap.size())
+            return;
+
+        std::vector<T> remapped(values.size());
+        for (size_t v = 0; v < values.size(); v++)
+            remapped[remap[v]] = values[v];
+        values.swap(remapped);
+    }
+
+    /// Transformed vertices per triangle for a FIFO cache of cacheSize vertices.
+    static float computeACMR(ArrayView<unsigned int> faces, size_t nVertices, unsigned int cacheSize = 16);
+};
+
+#endif
@@ -0,0 +1,440 @@
+#include "MeshSimplifier.h"
+
+// STD
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+    // Border constraint planes count this much more than the surface planes
+    const double BORDER_WEIGHT = 10.0;
+
+    struct EdgeRecord
+    {
+        unsigned long long key;     // (smaller vertex << 32) | larger vertex
+        unsigned int face;
+
+        bool operator<(const EdgeRecord& other) const
+        {
+            return key < other.key || (key == other.key && face < other.face);
+        }
+    };
+
+    glm::vec3 faceNormal(const std::vector<glm::vec3>& vertices, const unsigned int* face)
+    {
+        return glm::cross(vertices[face[1]] - vertices[face[0]], vertices[face[2]] - vertices[face[0]]);
+    }
+}
+
+MeshSimplifier::MeshSimplifier()
+{
+    m_error = 0.0f;
+}
+
+void MeshSimplifier::addPlane(Quadric& quadric, const glm::vec3& normal, const glm::vec3& point, double weight)
+{
+    double a = normal.x, b = normal.y, c = normal.z;
+    double d = -(a * point.x + b * point.y + c * point.z);
+
+    quadric.a00 += weight * a * a;  quadric.a01 += weight * a * b;  quadric.a02 += weight * a * c;  quadric.a03 += weight * a * d;
+    quadric.a11 += weight * b * b;  quadric.a12 += weight * b * c;  quadric.a13 += weight * b * d;
+    quadric.a22 += weight * c * c;  quadric.a23 += weight * c * d;
+    quadric.a33 += weight * d * d;
+    quadric.weight += weight;
+}
+
+void MeshSimplifier::addQuadric(Quadric& quadric, const Quadric& other)
+{
+    quadric.a00 += other.a00;  quadric.a01 += other.a01;  quadric.a02 += other.a02;  quadric.a03 += other.a03;
+    quadric.a11 += other.a11;  quadric.a12 += other.a12;  quadric.a13 += other.a13;
+    quadric.a22 += other.a22;  quadric.a23 += other.a23;
+    quadric.a33 += other.a33;
+    quadric.weight += other.weight;
+}
+
+double MeshSimplifier::evaluate(const Quadric& a, const Quadric& b, const glm::vec3& point)
+{
+    double x = point.x, y = point.y, z = point.z;
+
+    double q = (a.a00 + b.a00) * x * x + 2.0 * (a.a01 + b.a01) * x * y + 2.0 * (a.a02 + b.a02) * x * z + 2.0 * (a.a03 + b.a03) * x
+             + (a.a11 + b.a11) * y * y + 2.0 * (a.a12 + b.a12) * y * z + 2.0 * (a.a13 + b.a13) * y
+             + (a.a22 + b.a22) * z * z + 2.0 * (a.a23 + b.a23) * z
+             + (a.a33 + b.a33);
+
+    // Weighted mean squared distance to the merged planes
+    double weight = a.weight + b.weight;
+    return weight > 0.0 ? std::max(q, 0.0) / weight : 0.0;
+}
+
+void MeshSimplifier::setMesh(ArrayView<glm::vec3> vertices, ArrayView<unsigned int> faces, size_t nLocked)
+{
+    m_vertices.assign(vertices.begin(), vertices.end());
+    m_error = 0.0f;
+
+    m_faces.clear();
+    m_faces.reserve(faces.size());
+    for (size_t f = 0; f + 2 < faces.size(); f += 3){
+        if (faces[f] != faces[f + 1] && faces[f + 1] != faces[f + 2] && faces[f] != faces[f + 2])
+            m_faces.insert(m_faces.end(), faces.begin() + f, faces.begin() + f + 3);
+    }
+
+    size_t nVertices = m_vertices.size();
+    long long nFaces = (long long)(m_faces.size() / 3);
+
+    m_kind.assign(nVertices, VK_INTERIOR);
+    for (size_t v = 0; v < std::min(nLocked, nVertices); v++)
+        m_kind[v] = VK_LOCKED;
+
+    Quadric zero = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    m_quadrics.assign(nVertices, zero);
+
+    // Surface planes, weighted by triangle area; gathered per vertex so no two threads write the same quadric
+    buildAdjacency();
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (long long v = 0; v < (long long)nVertices; v++){
+        for (unsigned int a = m_adjacency_offsets[v]; a < m_adjacency_offsets[v + 1]; a++){
+            const unsigned int* face = &m_faces[m_adjacency[a] * 3];
+            glm::vec3 normal = faceNormal(m_vertices, face);
+
+            float length = glm::length(normal);
+            if (length > 0.0f)
+                addPlane(m_quadrics[v], normal / length, m_vertices[face[0]], 0.5 * length);
+        }
+    }
+
+    // Edges used by one triangle form the border, edges used by more than two are non-manifold
+    std::vector<EdgeRecord> edges(nFaces * 3);
+
+    #pragma omp parallel for schedule(static)
+    for (long long f = 0; f < nFaces; f++){
+        for (int c = 0; c < 3; c++){
+            unsigned int a = m_faces[f * 3 + c];
+            unsigned int b = m_faces[f * 3 + (c + 1) % 3];
+
+            EdgeRecord& edge = edges[f * 3 + c];
+            edge.key  = ((unsigned long long)std::min(a, b) << 32) | (unsigned long long)std::max(a, b);
+            edge.face = (unsigned int)f;
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t e = 0; e < edges.size();){
+        size_t run = e + 1;
+        while (run < edges.size() && edges[run].key == edges[e].key)
+            run++;
+
+        unsigned int a = (unsigned int)(edges[e].key >> 32);
+        unsigned int b = (unsigned int)(edges[e].key & 0xffffffffULL);
+
+        if (run - e == 1){
+            for (int i = 0; i < 2; i++){
+                unsigned int v = i == 0 ? a : b;
+                if (m_kind[v] == VK_INTERIOR)
+                    m_kind[v] = VK_BORDER;
+            }
+
+            // A plane through the edge, perpendicular to its triangle, keeps the border in place
+            glm::vec3 edgeVector = m_vertices[b] - m_vertices[a];
+            glm::vec3 normal = glm::cross(edgeVector, faceNormal(m_vertices, &m_faces[edges[e].face * 3]));
+
+            float length = glm::length(normal);
+            if (length > 0.0f){
+                double weight = BORDER_WEIGHT * glm::dot(edgeVector, edgeVector);
+                addPlane(m_quadrics[a], normal / length, m_vertices[a], weight);
+                addPlane(m_quadrics[b], normal / length, m_vertices[a], weight);
+            }
+        }
+        else if (run - e > 2){
+            m_kind[a] = VK_LOCKED;
+            m_kind[b] = VK_LOCKED;
+        }
+
+        e = run;
+    }
+}
+
+void MeshSimplifier::buildAdjacency()
+{
+    size_t nVertices = m_vertices.size();
+
+    m_adjacency_offsets.assign(nVertices + 1, 0);
+    for (size_t i = 0; i < m_faces.size(); i++)
+        m_adjacency_offsets[m_faces[i] + 1]++;
+    for (size_t v = 0; v < nVertices; v++)
+        m_adjacency_offsets[v + 1] += m_adjacency_offsets[v];
+
+    std::vector<unsigned int> cursor(m_adjacency_offsets.begin(), m_adjacency_offsets.end() - 1);
+
+    m_adjacency.resize(m_faces.size());
+    for (size_t i = 0; i < m_faces.size(); i++)
+        m_adjacency[cursor[m_faces[i]]++] = (unsigned int)(i / 3);
+}
+
+bool MeshSimplifier::findCollapse(unsigned int u, unsigned int& target, float& error, Scratch& scratch) const
+{
+    if (m_kind[u] == VK_LOCKED)
+        return false;
+
+    // Neighbours and the number of triangles shared with each
+    std::vector< std::pair<unsigned int, unsigned int> >& neighbours = scratch.neighbours;
+    neighbours.clear();
+    for (unsigned int a = m_adjacency_offsets[u]; a < m_adjacency_offsets[u + 1]; a++){
+        const unsigned int* face = &m_faces[m_adjacency[a] * 3];
+        for (int c = 0; c < 3; c++){
+            if (face[c] == u)
+                continue;
+
+            size_t n = 0;
+            while (n < neighbours.size() && neighbours[n].first != face[c])
+                n++;
+            if (n == neighbours.size())
+                neighbours.push_back(std::make_pair(face[c], 0u));
+            neighbours[n].second++;
+        }
+    }
+
+    std::vector< std::pair<double, unsigned int> >& candidates = scratch.candidates;
+    candidates.clear();
+    for (size_t n = 0; n < neighbours.size(); n++){
+        unsigned int v = neighbours[n].first;
+
+        // Border vertices may only slide along a border edge
+        if (m_kind[u] == VK_BORDER && neighbours[n].second != 1)
+            continue;
+
+        candidates.push_back(std::make_pair(evaluate(m_quadrics[u], m_quadrics[v], m_vertices[v]), v));
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    for (size_t c = 0; c < candidates.size(); c++){
+        if (collapseIsValid(u, candidates[c].second, scratch)){
+            target = candidates[c].second;
+            error = (float)std::sqrt(candidates[c].first);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MeshSimplifier::collapseIsValid(unsigned int u, unsigned int v, Scratch& scratch) const
+{
+    std::vector<unsigned int>& ringU = scratch.ringU;
+    std::vector<unsigned int>& ringV = scratch.ringV;
+    std::vector<unsigned int>& opposite = scratch.opposite;
+    ringU.clear();
+    ringV.clear();
+    opposite.clear();
+
+    for (unsigned int a = m_adjacency_offsets[u]; a < m_adjacency_offsets[u + 1]; a++){
+        const unsigned int* face = &m_faces[m_adjacency[a] * 3];
+        bool hasV = (face[0] == v || face[1] == v || face[2] == v);
+
+        for (int c = 0; c < 3; c++){
+            if (face[c] != u && face[c] != v){
+                ringU.push_back(face[c]);
+                if (hasV)
+                    opposite.push_back(face[c]);
+            }
+        }
+
+        // Triangles that stay must not flip or degenerate
+        if (!hasV){
+            glm::vec3 moved[3];
+            for (int c = 0; c < 3; c++)
+                moved[c] = m_vertices[face[c] == u ? v : face[c]];
+
+            glm::vec3 before = faceNormal(m_vertices, face);
+            glm::vec3 after  = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(before, after) <= 0.0f)
+                return false;
+        }
+    }
+
+    // Link condition: u and v may only share the vertices opposite to their common edge,
+    // otherwise the collapse pinches the surface into a non-manifold configuration
+    std::sort(ringU.begin(), ringU.end());
+    ringU.erase(std::unique(ringU.begin(), ringU.end()), ringU.end());
+    std::sort(opposite.begin(), opposite.end());
+    opposite.erase(std::unique(opposite.begin(), opposite.end()), opposite.end());
+
+    size_t shared = 0;
+    for (unsigned int a = m_adjacency_offsets[v]; a < m_adjacency_offsets[v + 1]; a++){
+        const unsigned int* face = &m_faces[m_adjacency[a] * 3];
+        for (int c = 0; c < 3; c++){
+            if (face[c] != u && face[c] != v)
+                ringV.push_back(face[c]);
+        }
+    }
+    std::sort(ringV.begin(), ringV.end());
+    ringV.erase(std::unique(ringV.begin(), ringV.end()), ringV.end());
+
+    for (size_t i = 0, j = 0; i < ringU.size() && j < ringV.size();){
+        if (ringU[i] < ringV[j])        i++;
+        else if (ringV[j] < ringU[i])   j++;
+        else                            { shared++; i++; j++; }
+    }
+
+    if (shared != opposite.size())
+        return false;
+
+    // An edge v-w of a removed triangle survives only through the triangle on the other side
+    // of u-w. Without it the border would lose an edge, e.g. the seed curve edge of a ripped strip.
+    for (size_t o = 0; o < opposite.size(); o++){
+        unsigned int w = opposite[o];
+        unsigned int countUW = 0, countVW = 0;
+
+        for (unsigned int a = m_adjacency_offsets[u]; a < m_adjacency_offsets[u + 1]; a++){
+            const unsigned int* face = &m_faces[m_adjacency[a] * 3];
+            countUW += (face[0] == w || face[1] == w || face[2] == w) ? 1 : 0;
+        }
+        for (unsigned int a = m_adjacency_offsets[v]; a < m_adjacency_offsets[v + 1]; a++){
+            const unsigned int* face = &m_faces[m_adjacency[a] * 3];
+            countVW += (face[0] == w || face[1] == w || face[2] == w) ? 1 : 0;
+        }
+
+        if (countUW == 1 && countVW == 1)
+            return false;
+    }
+
+    return true;
+}
+
+size_t MeshSimplifier::simplify(size_t targetTriangles, float maxError)
+{
+    size_t nVertices = m_vertices.size();
+
+    while (getTriangleCount() > targetTriangles){
+        buildAdjacency();
+
+        // The best collapse of every vertex, evaluated independently
+        std::vector<unsigned int> targets(nVertices, UINT_MAX);
+        std::vector<float> errors(nVertices, 0.0f);
+
+        #pragma omp parallel
+        {
+            Scratch scratch;
+
+            #pragma omp for schedule(dynamic, 1024)
+            for (long long u = 0; u < (long long)nVertices; u++){
+                if (m_adjacency_offsets[u] == m_adjacency_offsets[u + 1])
+                    continue;
+
+                unsigned int target;
+                float error;
+                if (findCollapse((unsigned int)u, target, error, scratch)){
+                    targets[u] = target;
+                    errors[u] = error;
+                }
+            }
+        }
+
+        std::vector< std::pair<float, unsigned int> > order;
+        for (size_t u = 0; u < nVertices; u++){
+            if (targets[u] != UINT_MAX && (maxError <= 0.0f || errors[u] <= maxError))
+                order.push_back(std::make_pair(errors[u], (unsigned int)u));
+        }
+        std::sort(order.begin(), order.end());
+
+        // A collapse removes at most two triangles. Costlier candidates than the cheapest that could reach
+        // the target wait for a later pass, so the skipped neighbours of cheap collapses go first.
+        size_t needed = (getTriangleCount() - targetTriangles + 1) / 2;
+        float  passError = order.empty() ? 0.0f : order[std::min(needed, order.size()) - 1].first;
+
+        // Cheapest first, skipping collapses whose neighbourhood was changed in this pass already
+        std::vector<char> touched(nVertices, 0);
+        std::vector<unsigned int> remap(nVertices);
+        for (size_t v = 0; v < nVertices; v++)
+            remap[v] = (unsigned int)v;
+
+        size_t triangles = getTriangleCount();
+        size_t collapses = 0;
+
+        for (size_t o = 0; o < order.size() && order[o].first <= passError && triangles > targetTriangles; o++){
+            unsigned int u = order[o].second;
+            unsigned int v = targets[u];
+
+            bool independent = true;
+            for (unsigned int a = m_adjacency_offsets[u]; a < m_adjacency_offsets[u + 1] && independent; a++){
+                const unsigned int* face = &m_faces[m_adjacency[a] * 3];
+                independent = !touched[face[0]] && !touched[face[1]] && !touched[face[2]];
+            }
+            if (!independent)
+                continue;
+
+            for (unsigned int a = m_adjacency_offsets[u]; a < m_adjacency_offsets[u + 1]; a++){
+                const unsigned int* face = &m_faces[m_adjacency[a] * 3];
+                touched[face[0]] = touched[face[1]] = touched[face[2]] = 1;
+
+                if (face[0] == v || face[1] == v || face[2] == v)
+                    triangles--;
+            }
+
+            remap[u] = v;
+            addQuadric(m_quadrics[v], m_quadrics[u]);
+            m_error = std::max(m_error, order[o].first);
+            collapses++;
+        }
+
+        if (collapses == 0)
+            break;
+
+        // Rewrite the triangles and drop the ones that collapsed
+        long long nFaces = (long long)(m_faces.size() / 3);
+
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < nFaces * 3; i++)
+            m_faces[i] = remap[m_faces[i]];
+
+        size_t kept = 0;
+        for (long long f = 0; f < nFaces; f++){
+            const unsigned int* face = &m_faces[f * 3];
+            if (face[0] == face[1] || face[1] == face[2] || face[0] == face[2])
+                continue;
+
+            if (kept != (size_t)f)
+                std::copy(face, face + 3, m_faces.begin() + kept * 3);
+            kept++;
+        }
+        m_faces.resize(kept * 3);
+    }
+
+    return getTriangleCount();
+}
+
+void MeshSimplifier::buildLevels(ArrayView<glm::vec3> vertices, ArrayView<unsigned int> faces, size_t nLocked,
+                                 unsigned int nLevels, float ratio, float maxError, std::vector<Level>& levels,
+                                 const std::atomic<bool>* cancel)
+{
+    levels.clear();
+
+    MeshSimplifier simplifier;
+    simplifier.setMesh(vertices, faces, nLocked);
+
+    size_t triangles = simplifier.getTriangleCount();
+    for (unsigned int l = 0; l < nLevels; l++){
+        if (cancel && *cancel)
+            break;
+
+        size_t target = (size_t)(triangles / ratio);
+        if (target == 0)
+            break;
+
+        // Stop once locked vertices, borders or the error limit leave nothing to collapse
+        size_t reached = simplifier.simplify(target, maxError);
+        if (reached >= triangles - triangles / 10)
+            break;
+
+        Level level;
+        level.faces = simplifier.getFaces();
+        level.error = simplifier.getError();
+        levels.push_back(level);
+
+        triangles = reached;
+    }
+}
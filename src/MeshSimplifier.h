@@ -0,0 +1,105 @@
+
+/**
+ *
+ * Quadric error mesh simplification
+ *
+ * This class decimates a triangle mesh by half-edge collapses ordered by the
+ * quadric error metric (Garland and Heckbert). Every pass evaluates the best
+ * collapse of all vertices in parallel, then applies the cheapest collapses
+ * whose neighbourhoods do not overlap, so the passes stay deterministic.
+ *
+ * Vertices are never moved or created: a collapse merges a vertex into one of
+ * its neighbours, so every level indexes the input vertex array and keeps its
+ * attributes. Locked vertices (e.g. the seed curve) stay, and border vertices
+ * only slide along the border, which is held in place by constraint planes.
+ *
+ */
+
+#ifndef __MESH_SIMPLIFIER__
+#define __MESH_SIMPLIFIER__
+
+// STD
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "ArrayView.h"
+
+class MeshSimplifier
+{
+public:
+
+    /// One level of detail: triangles over the input vertices and the largest
+    /// distance between the level and the input surface (an estimate from the quadrics).
+    struct Level
+    {
+        std::vector<unsigned int> faces;
+        float error;
+    };
+
+    MeshSimplifier();
+
+    /// Start from a mesh. The vertices [0, nLocked) are never removed.
+    void setMesh(ArrayView<glm::vec3> vertices, ArrayView<unsigned int> faces, size_t nLocked);
+
+    /// Collapse edges until at most targetTriangles remain, or until the next collapse would
+    /// exceed maxError (0 disables the limit). Calling it again with a lower target continues
+    /// from the current state. Returns the number of triangles left.
+    size_t simplify(size_t targetTriangles, float maxError);
+
+    const std::vector<unsigned int>& getFaces() const { return m_faces; }
+    size_t getTriangleCount() const { return m_faces.size() / 3; }
+    float getError() const { return m_error; }
+
+    /// A chain of up to nLevels levels, each with about ratio times fewer triangles than the previous
+    /// one. The input itself is not part of the chain; levels[0] is its first simplification.
+    /// No level exceeds maxError (0 disables the limit): the chain ends at the last level that
+    /// still reduces the mesh within it. A set cancel flag stops the chain after the current level.
+    static void buildLevels(ArrayView<glm::vec3> vertices, ArrayView<unsigned int> faces, size_t nLocked,
+                            unsigned int nLevels, float ratio, float maxError, std::vector<Level>& levels,
+                            const std::atomic<bool>* cancel = NULL);
+
+private:
+
+    // Symmetric 4x4 matrix (upper triangle) plus the total weight of the planes
+    struct Quadric
+    {
+        double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+        double weight;
+    };
+
+    enum VertexKind { VK_INTERIOR, VK_BORDER, VK_LOCKED };
+
+    // Buffers of the per-vertex evaluation, one set per thread
+    struct Scratch
+    {
+        std::vector< std::pair<unsigned int, unsigned int> > neighbours;
+        std::vector< std::pair<double, unsigned int> >       candidates;
+        std::vector<unsigned int> ringU, ringV, opposite;
+    };
+
+    static void addPlane(Quadric& quadric, const glm::vec3& normal, const glm::vec3& point, double weight);
+    static void addQuadric(Quadric& quadric, const Quadric& other);
+    static double evaluate(const Quadric& a, const Quadric& b, const glm::vec3& point);
+
+    void buildAdjacency();
+    bool findCollapse(unsigned int u, unsigned int& target, float& error, Scratch& scratch) const;
+    bool collapseIsValid(unsigned int u, unsigned int v, Scratch& scratch) const;
+
+    std::vector<glm::vec3>      m_vertices;
+    std::vector<unsigned int>   m_faces;
+    std::vector<Quadric>        m_quadrics;
+    std::vector<char>           m_kind;
+
+    // Vertex to face adjacency of the current faces (compressed rows)
+    std::vector<unsigned int>   m_adjacency_offsets;
+    std::vector<unsigned int>   m_adjacency;
+
+    float m_error;
+};
+
+#endif
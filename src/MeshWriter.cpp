@@ -0,0 +1,366 @@
+#include "MeshWriter.h"
+
+// STD
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    // Blocks are handed to the writer thread at this size, and at most this many wait
+    const size_t BLOCK_BYTES = 4 << 20;
+    const size_t MAX_QUEUED_BLOCKS = 16;
+
+    // Header numbers are padded to this width, so patching them never moves the data
+    const size_t COUNT_WIDTH = 20;
+
+    std::string padded(unsigned long long value)
+    {
+        std::ostringstream text;
+        text << value;
+
+        std::string result = text.str();
+        result.resize(std::max(result.size(), COUNT_WIDTH), ' ');
+        return result;
+    }
+
+    bool littleEndian()
+    {
+        unsigned int one = 1;
+        return *(const unsigned char*)&one == 1;
+    }
+
+    const unsigned char VTK_TRIANGLE = 5;
+}
+
+MeshWriter::MeshWriter()
+{
+    m_format = FORMAT_PLY;
+    m_open = false;
+    m_failed = false;
+    m_closing = false;
+    m_nVertices = m_nFaces = 0;
+}
+
+MeshWriter::~MeshWriter()
+{
+    if (m_open)
+        close();
+}
+
+bool MeshWriter::formatFromFilename(const std::string& filename, Format& format)
+{
+    size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+
+    std::string extension = filename.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    if (extension == "ply")         format = FORMAT_PLY;
+    else if (extension == "vtu")    format = FORMAT_VTU;
+    else if (extension == "obj")    format = FORMAT_OBJ;
+    else                            return false;
+
+    return true;
+}
+
+std::string MeshWriter::spillName(int stream) const
+{
+    std::ostringstream name;
+    name << m_filename << ".part" << stream;
+    return name.str();
+}
+
+int MeshWriter::spillCount() const
+{
+    switch (m_format){
+    case FORMAT_PLY: return 1;     // faces
+    case FORMAT_VTU: return 4;     // velocity, connectivity, offsets, types
+    default:         return 0;
+    }
+}
+
+bool MeshWriter::open(const std::string& filename, Format format)
+{
+    if (m_open)
+        close();
+
+    m_filename = filename;
+    m_format = format;
+    m_failed = false;
+    m_closing = false;
+    m_nVertices = m_nFaces = 0;
+
+    for (int s = 0; s <= spillCount(); s++){
+        m_files[s].open(s == S_MAIN ? m_filename.c_str() : spillName(s).c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!m_files[s]){
+            std::cout << "Could not create " << (s == S_MAIN ? m_filename : spillName(s)) << std::endl;
+            for (int c = 0; c <= s; c++){
+                m_files[c].close();
+                std::remove(c == S_MAIN ? m_filename.c_str() : spillName(c).c_str());
+            }
+            return false;
+        }
+
+        m_blocks[s].clear();
+        m_blocks[s].reserve(BLOCK_BYTES + 256);
+    }
+
+    // Headers are written with zero counts; close() overwrites them in place
+    if (m_format != FORMAT_OBJ)
+        putText(S_MAIN, header());
+    if (m_format == FORMAT_VTU)
+        put(S_MAIN, (unsigned long long)0);     // byte count of the points
+
+    m_open = true;
+    m_thread = std::thread(&MeshWriter::run, this);
+
+    return true;
+}
+
+std::string MeshWriter::header() const
+{
+    std::ostringstream text;
+
+    if (m_format == FORMAT_PLY){
+        text << "ply\n"
+             << "format " << (littleEndian() ? "binary_little_endian" : "binary_big_endian") << " 1.0\n"
+             << "element vertex " << padded(m_nVertices) << "\n"
+             << "property float x\nproperty float y\nproperty float z\n"
+             << "property float vx\nproperty float vy\nproperty float vz\n"
+             << "element face " << padded(m_nFaces) << "\n"
+             << "property list uchar int vertex_indices\n"
+             << "end_header\n";
+    }
+    else if (m_format == FORMAT_VTU){
+        // Offsets into the appended data; every array is preceded by its 64 bit byte count
+        unsigned long long points       = 0;
+        unsigned long long velocity     = points + 8 + 12ULL * m_nVertices;
+        unsigned long long connectivity = velocity + 8 + 12ULL * m_nVertices;
+        unsigned long long offsets      = connectivity + 8 + 12ULL * m_nFaces;
+        unsigned long long types        = offsets + 8 + 8ULL * m_nFaces;
+
+        text << "<?xml version=\"1.0\"?>\n"
+             << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << (littleEndian() ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\">\n"
+             << "  <UnstructuredGrid>\n"
+             << "    <Piece NumberOfPoints=\"" << padded(m_nVertices) << "\" NumberOfCells=\"" << padded(m_nFaces) << "\">\n"
+             << "      <PointData Vectors=\"velocity\">\n"
+             << "        <DataArray type=\"Float32\" Name=\"velocity\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << padded(velocity) << "\"/>\n"
+             << "      </PointData>\n"
+             << "      <Points>\n"
+             << "        <DataArray type=\"Float32\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << padded(points) << "\"/>\n"
+             << "      </Points>\n"
+             << "      <Cells>\n"
+             << "        <DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"" << padded(connectivity) << "\"/>\n"
+             << "        <DataArray type=\"Int64\" Name=\"offsets\" format=\"appended\" offset=\"" << padded(offsets) << "\"/>\n"
+             << "        <DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"" << padded(types) << "\"/>\n"
+             << "      </Cells>\n"
+             << "    </Piece>\n"
+             << "  </UnstructuredGrid>\n"
+             << "  <AppendedData encoding=\"raw\">\n"
+             << "   _";
+    }
+
+    return text.str();
+}
+
+void MeshWriter::write(ArrayView<glm::vec3> vertices, ArrayView<glm::vec3> derivatives, ArrayView<unsigned int> faces)
+{
+    if (!m_open)
+        return;
+
+    size_t nFaces = faces.size() / 3;
+    char line[96];
+
+    switch (m_format){
+    case FORMAT_PLY:
+        for (size_t v = 0; v < vertices.size(); v++){
+            glm::vec3 velocity = v < derivatives.size() ? derivatives[v] : glm::vec3(0.0f, 0.0f, 0.0f);
+            put(S_MAIN, vertices[v]);
+            put(S_MAIN, velocity);
+            flush(S_MAIN, false);
+        }
+        for (size_t f = 0; f < nFaces; f++){
+            put(S_SPILL0, (unsigned char)3);
+            for (int c = 0; c < 3; c++)
+                put(S_SPILL0, (int)faces[f * 3 + c]);
+            flush(S_SPILL0, false);
+        }
+        break;
+
+    case FORMAT_VTU:
+        for (size_t v = 0; v < vertices.size(); v++){
+            put(S_MAIN, vertices[v]);
+            put(S_SPILL0, v < derivatives.size() ? derivatives[v] : glm::vec3(0.0f, 0.0f, 0.0f));
+            flush(S_MAIN, false);
+            flush(S_SPILL0, false);
+        }
+        for (size_t f = 0; f < nFaces; f++){
+            for (int c = 0; c < 3; c++)
+                put(S_SPILL1, (int)faces[f * 3 + c]);
+            put(S_SPILL2, (long long)(3 * (m_nFaces + f + 1)));
+            put(S_SPILL3, VTK_TRIANGLE);
+            flush(S_SPILL1, false);
+            flush(S_SPILL2, false);
+            flush(S_SPILL3, false);
+        }
+        break;
+
+    case FORMAT_OBJ:
+        // OBJ allows vertices and faces in any order, as long as faces come after their vertices
+        for (size_t v = 0; v < vertices.size(); v++){
+            int length = std::snprintf(line, sizeof(line), "v %.7g %.7g %.7g\n", vertices[v].x, vertices[v].y, vertices[v].z);
+            m_blocks[S_MAIN].insert(m_blocks[S_MAIN].end(), line, line + length);
+            flush(S_MAIN, false);
+        }
+        for (size_t f = 0; f < nFaces; f++){
+            int length = std::snprintf(line, sizeof(line), "f %u %u %u\n", faces[f * 3] + 1, faces[f * 3 + 1] + 1, faces[f * 3 + 2] + 1);
+            m_blocks[S_MAIN].insert(m_blocks[S_MAIN].end(), line, line + length);
+            flush(S_MAIN, false);
+        }
+        break;
+    }
+
+    m_nVertices += vertices.size();
+    m_nFaces += nFaces;
+}
+
+void MeshWriter::putText(int stream, const std::string& text)
+{
+    m_blocks[stream].insert(m_blocks[stream].end(), text.begin(), text.end());
+}
+
+void MeshWriter::flush(int stream, bool force)
+{
+    std::vector<char>& data = m_blocks[stream];
+    if (data.size() < BLOCK_BYTES && !(force && !data.empty()))
+        return;
+
+    {
+        // Back-pressure: tracing waits for the disk rather than filling memory
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_queue.size() >= MAX_QUEUED_BLOCKS)
+            m_condition.wait(lock);
+
+        m_queue.push_back(Block());
+        m_queue.back().stream = stream;
+        m_queue.back().data.swap(data);
+    }
+    m_condition.notify_all();
+
+    data.reserve(BLOCK_BYTES + 256);
+}
+
+void MeshWriter::run()
+{
+    while (true){
+        Block block;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_queue.empty() && !m_closing)
+                m_condition.wait(lock);
+
+            if (m_queue.empty())
+                return;
+
+            block.stream = m_queue.front().stream;
+            block.data.swap(m_queue.front().data);
+            m_queue.pop_front();
+        }
+        m_condition.notify_all();
+
+        std::ofstream& file = m_files[block.stream];
+        file.write(&block.data[0], block.data.size());
+        if (!file)
+            m_failed = true;
+    }
+}
+
+bool MeshWriter::close()
+{
+    if (!m_open)
+        return false;
+
+    for (int s = 0; s <= spillCount(); s++)
+        flush(s, true);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+
+    for (int s = 0; s <= spillCount(); s++)
+        m_files[s].close();
+    m_open = false;
+
+    // Append the spilled arrays to the file, then fix up the header in place
+    std::fstream file(m_filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(0, std::ios::end);
+
+    std::vector<char> buffer(BLOCK_BYTES);
+    for (int s = S_SPILL0; s <= spillCount(); s++){
+        std::ifstream spill(spillName(s).c_str(), std::ios::binary | std::ios::ate);
+        unsigned long long bytes = (unsigned long long)spill.tellg();
+        spill.seekg(0);
+
+        if (m_format == FORMAT_VTU)
+            file.write((const char*)&bytes, sizeof(bytes));
+
+        while (spill && bytes > 0){
+            spill.read(&buffer[0], std::min((unsigned long long)buffer.size(), bytes));
+            file.write(&buffer[0], spill.gcount());
+            bytes -= (unsigned long long)spill.gcount();
+        }
+
+        spill.close();
+        std::remove(spillName(s).c_str());
+    }
+
+    if (m_format == FORMAT_VTU)
+        file << "\n  </AppendedData>\n</VTKFile>\n";
+
+    if (m_format != FORMAT_OBJ){
+        std::string text = header();
+        file.seekp(0);
+        file.write(text.c_str(), text.size());
+
+        if (m_format == FORMAT_VTU){
+            unsigned long long bytes = 12ULL * m_nVertices;
+            file.write((const char*)&bytes, sizeof(bytes));
+        }
+    }
+
+    if (!file || m_failed){
+        std::cout << "Writing " << m_filename << " failed" << std::endl;
+        return false;
+    }
+
+    std::cout << "Wrote " << m_filename << ": " << m_nVertices << " vertices, " << m_nFaces << " triangles" << std::endl;
+    return true;
+}
+
+void MeshWriter::discard()
+{
+    if (m_open){
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.clear();
+            m_closing = true;
+        }
+        m_condition.notify_all();
+        m_thread.join();
+
+        for (int s = 0; s <= spillCount(); s++)
+            m_files[s].close();
+        m_open = false;
+    }
+
+    for (int s = S_SPILL0; s <= spillCount(); s++)
+        std::remove(spillName(s).c_str());
+    std::remove(m_filename.c_str());
+}
@@ -0,0 +1,115 @@
+
+/**
+ *
+ * Streaming surface export
+ *
+ * This class writes a surface to disk while it is being generated: binary PLY,
+ * VTK XML unstructured grid (VTU, appended raw data) or Wavefront OBJ. Every
+ * write() encodes the new vertices and triangles into large blocks, which a
+ * background thread writes out, so tracing never waits on the disk unless the
+ * bounded queue is full.
+ *
+ * PLY and VTU store all vertices before the triangles, so the triangle data is
+ * spilled into temporary files next to the output and appended on close(); the
+ * element counts in the header are written with a fixed width and patched in
+ * at the end. Nothing is kept in memory beyond the queued blocks.
+ *
+ * PLY and VTU vertices carry their position and velocity, OBJ vertices only the
+ * position. Normals are left out, as they keep changing until the surface is finished.
+ *
+ */
+
+#ifndef __MESH_WRITER__
+#define __MESH_WRITER__
+
+// STD
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "ArrayView.h"
+
+class MeshWriter
+{
+public:
+
+    enum Format { FORMAT_PLY, FORMAT_VTU, FORMAT_OBJ };
+
+    MeshWriter();
+    ~MeshWriter();
+
+    /// Create the file and start the writer thread.
+    bool open(const std::string& filename, Format format);
+
+    /// Append vertices and triangles. Face indices count from the first vertex ever written
+    /// and may only reference vertices written before or in the same call.
+    void write(ArrayView<glm::vec3> vertices, ArrayView<glm::vec3> derivatives, ArrayView<unsigned int> faces);
+
+    /// Write the remaining blocks, assemble the file and fix up its header.
+    bool close();
+
+    /// Close and delete the output, e.g. when the surface was cancelled.
+    void discard();
+
+    bool isOpen() const { return m_open; }
+    size_t getVertexCount() const { return m_nVertices; }
+    size_t getFaceCount() const { return m_nFaces; }
+
+    /// The format that matches the extension (.ply, .vtu, .obj). Returns false for anything else.
+    static bool formatFromFilename(const std::string& filename, Format& format);
+
+private:
+
+    // Output streams: the file itself first, then one temporary file per spilled array
+    enum Stream { S_MAIN, S_SPILL0, S_SPILL1, S_SPILL2, S_SPILL3, S_COUNT };
+
+    struct Block
+    {
+        int stream;
+        std::vector<char> data;
+    };
+
+    template<typename T>
+    void put(int stream, const T& value)
+    {
+        std::vector<char>& block = m_blocks[stream];
+        const char* bytes = (const char*)&value;
+        block.insert(block.end(), bytes, bytes + sizeof(T));
+    }
+    void putText(int stream, const std::string& text);
+    void flush(int stream, bool force);
+
+    void run();
+    std::string header() const;
+    std::string spillName(int stream) const;
+    int spillCount() const;
+
+    std::string m_filename;
+    Format      m_format;
+    bool        m_open;
+    bool        m_failed;
+
+    size_t m_nVertices, m_nFaces;
+
+    // Blocks being filled by write(), one per stream
+    std::vector<char> m_blocks[S_COUNT];
+
+    // Filled blocks waiting for the writer thread
+    std::thread             m_thread;
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Block>       m_queue;
+    bool                    m_closing;
+
+    std::ofstream m_files[S_COUNT];
+};
+
+#endif
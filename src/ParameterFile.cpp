@@ -0,0 +1,170 @@
+#include "ParameterFile.h"
+
+// STD
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    std::string trim(const std::string& text)
+    {
+        size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+        size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+
+    std::string lower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+        return text;
+    }
+
+    bool parseBool(const std::string& text, bool& flag)
+    {
+        std::string value = lower(text);
+        if (value == "true" || value == "on" || value == "yes" || value == "1")        flag = true;
+        else if (value == "false" || value == "off" || value == "no" || value == "0") flag = false;
+        else                                                                           return false;
+        return true;
+    }
+
+    template<typename T>
+    bool parseNumber(const std::string& text, T& number)
+    {
+        std::istringstream in(text);
+        in >> number;
+        return !in.fail() && (in >> std::ws).eof();
+    }
+
+    bool parseVector(const std::string& text, glm::vec3& vector)
+    {
+        std::istringstream in(text);
+        in >> vector.x >> vector.y >> vector.z;
+        return !in.fail() && (in >> std::ws).eof();
+    }
+}
+
+bool ParameterFile::load(const std::string& filename, std::vector<Surface>& surfaces)
+{
+    surfaces.clear();
+
+    std::ifstream in(filename.c_str());
+    if (!in){
+        std::cout << "ParameterFile: cannot open " << filename << std::endl;
+        return false;
+    }
+
+    // Settings before the first section apply to every surface
+    StreamTracer::BatchItem defaults;
+    defaults.addition = true;
+    defaults.remove   = false;
+    defaults.ripping  = true;
+
+    std::string line;
+    for (unsigned int number = 1; std::getline(in, line); number++){
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        line = trim(line);
+        if (line.empty())
+            continue;
+
+        std::string error;
+
+        if (line[0] == '['){
+            if (line[line.size() - 1] != ']')
+                error = "unterminated section";
+            else {
+                Surface surface;
+                surface.name = trim(line.substr(1, line.size() - 2));
+                surface.item = defaults;
+                surfaces.push_back(surface);
+            }
+        }
+        else {
+            size_t equals = line.find('=');
+            if (equals == std::string::npos)
+                error = "expected key = value";
+            else {
+                std::string key   = lower(trim(line.substr(0, equals)));
+                std::string value = trim(line.substr(equals + 1));
+                apply(key, value, surfaces.empty() ? defaults : surfaces.back().item, error);
+            }
+        }
+
+        if (!error.empty()){
+            std::cout << filename << ":" << number << ": " << error << ": " << line << std::endl;
+            return false;
+        }
+    }
+
+    // Name unnamed surfaces by their position
+    for (size_t s = 0; s < surfaces.size(); s++){
+        if (surfaces[s].name.empty()){
+            std::ostringstream name;
+            name << "surface_" << s;
+            surfaces[s].name = name.str();
+        }
+    }
+
+    if (surfaces.empty())
+        std::cout << filename << ": no [surface] sections" << std::endl;
+
+    return !surfaces.empty();
+}
+
+bool ParameterFile::apply(const std::string& key, const std::string& value, StreamTracer::BatchItem& item, std::string& error)
+{
+    StreamTracer::SurfaceParameters& parameters = item.parameters;
+    bool ok = true;
+
+    if (key == "seed_curve"){
+        std::string type = lower(value);
+        if (type == "line")             parameters.seedCurveType = StreamTracer::SurfaceParameters::SC_LINE;
+        else if (type == "circle")      parameters.seedCurveType = StreamTracer::SurfaceParameters::SC_CIRCLE;
+        else if (type == "polyline")    parameters.seedCurveType = StreamTracer::SurfaceParameters::SC_POLYLINE;
+        else if (type == "spline")      parameters.seedCurveType = StreamTracer::SurfaceParameters::SC_SPLINE;
+        else                            ok = false;
+    }
+    else if (key == "center")       ok = parseVector(value, parameters.seedingLineCenter);
+    else if (key == "direction")    ok = parseVector(value, parameters.seedingLineDirection);
+    else if (key == "extent")       ok = parseNumber(value, parameters.seedingLineLength);
+    else if (key == "points"){
+        parameters.seedCurvePoints.clear();
+
+        std::istringstream in(value);
+        std::string point;
+        while (ok && std::getline(in, point, ',')){
+            glm::vec3 p;
+            ok = parseVector(trim(point), p);
+            parameters.seedCurvePoints.push_back(p);
+        }
+    }
+    else if (key == "step_size")    ok = parseNumber(value, parameters.traceStepSize) && parameters.traceStepSize > 0.0f;
+    else if (key == "max_steps")    ok = parseNumber(value, parameters.traceMaxSteps);
+    else if (key == "max_seeds")    ok = parseNumber(value, parameters.traceMaxSeeds) && parameters.traceMaxSeeds >= 2;
+    else if (key == "trace"){
+        std::string direction = lower(value);
+        if (direction == "forward")         parameters.traceDirection = StreamTracer::SurfaceParameters::TD_FORWARD;
+        else if (direction == "backward")   parameters.traceDirection = StreamTracer::SurfaceParameters::TD_BACKWARD;
+        else if (direction == "both")       parameters.traceDirection = StreamTracer::SurfaceParameters::TD_BOTH;
+        else                                ok = false;
+    }
+    else if (key == "adaptive")     ok = parseBool(value, parameters.adaptiveSeeding);
+    else if (key == "addition")     ok = parseBool(value, item.addition);
+    else if (key == "remove")       ok = parseBool(value, item.remove);
+    else if (key == "ripping")      ok = parseBool(value, item.ripping);
+    else {
+        error = "unknown key '" + key + "'";
+        return false;
+    }
+
+    if (!ok)
+        error = "invalid value for '" + key + "'";
+    return ok;
+}
@@ -0,0 +1,57 @@
+
+/**
+ *
+ * Surface parameter files
+ *
+ * This class reads the list of surfaces for batch generation from a text file.
+ * Every [section] describes one surface; its name labels the output. Settings
+ * before the first section are defaults for all surfaces. Lines starting with
+ * '#' are comments.
+ *
+ *   step_size  = 0.001
+ *   ripping    = true
+ *
+ *   [inlet]
+ *   seed_curve = line             # line, circle, polyline or spline
+ *   center     = 0.05 0.05 0.0
+ *   direction  = 0 0 1
+ *   extent     = 0.4              # line length or circle radius
+ *
+ *   [vortex_core]
+ *   seed_curve = spline
+ *   points     = 0 0 0, 0.1 0.05 0, 0.2 0 0
+ *   max_seeds  = 200
+ *   adaptive   = true
+ *
+ * Further keys: max_steps, trace (forward, backward, both), addition, remove.
+ *
+ */
+
+#ifndef __PARAMETER_FILE__
+#define __PARAMETER_FILE__
+
+// STD
+#include <string>
+#include <vector>
+
+// Stream Tracer
+#include "StreamTracer.h"
+
+class ParameterFile
+{
+public:
+
+    struct Surface
+    {
+        std::string name;
+        StreamTracer::BatchItem item;
+    };
+
+    /// Read all surfaces of a file. Prints the offending line and returns false on errors.
+    static bool load(const std::string& filename, std::vector<Surface>& surfaces);
+
+private:
+    static bool apply(const std::string& key, const std::string& value, StreamTracer::BatchItem& item, std::string& error);
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include "PathSurface.h"
+
+// STD
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+// Stream Tracer
+#include "FieldTimeSeries.h"
+#include "Profiler.h"
+#include "StreamSurface.h"
+
+PathSurface::PathSurface(const StreamTracer& field)
+    : m_field(&field)
+{
+    field.getParameters(m_surface_parameters);
+
+    m_start_time = m_end_time = 0.0;
+}
+
+void PathSurface::setParameters(const StreamTracer::SurfaceParameters &parameters)
+{
+    m_surface_parameters = parameters;
+}
+
+bool PathSurface::compute(bool addition)
+{
+    PROFILE_ZONE("PathSurface::compute");
+
+    m_vertices.clear();
+    m_derivatives.clear();
+    m_normals.clear();
+    m_texCoords.clear();
+    m_faces.clear();
+    m_end_time = m_start_time;
+
+    const float stepSize = m_surface_parameters.traceDirection == StreamTracer::SurfaceParameters::TD_BACKWARD
+        ? -m_surface_parameters.traceStepSize : m_surface_parameters.traceStepSize;
+    const int direction = stepSize < 0.0f ? -1 : 1;
+
+    // Every interval request also points the prefetcher at the steps that follow
+    const FieldTimeSeries& series = m_field->getTimeSeries();
+    FieldTimeSeries::Interval interval;
+    double time = m_start_time;
+    if (!series.interval(time, interval, direction)){
+        std::cout << "PathSurface: the field has no time steps" << std::endl;
+        return false;
+    }
+
+    std::vector<glm::vec3>& seeds = m_surface_parameters.seedingPoints;
+    StreamSurface::sampleSeedCurve(m_surface_parameters, std::max(m_surface_parameters.traceMaxSeeds, 2u), seeds);
+
+    std::vector<char> valid;
+    m_field->seedsAreValid(seeds, valid);
+
+    // The vertex of every particle, in curve order, and whether it still moves
+    std::vector<unsigned int> front(seeds.size());
+    std::vector<char>         alive(seeds.size());
+    for (size_t p = 0; p < seeds.size(); p++){
+        front[p] = (unsigned int)m_vertices.size();
+        alive[p] = valid[p];
+
+        m_vertices.push_back(seeds[p]);
+        m_derivatives.push_back(m_field->derivate(seeds[p], interval, time));
+        m_texCoords.push_back(glm::length(m_derivatives.back()));
+    }
+
+    // Seeds are uniform in arc length; refine where neighbours drift apart, up to a bound on the front
+    const float  maxSpacing   = seeds.size() > 1 ? 2.0f * glm::distance(seeds[0], seeds[1]) : 0.0f;
+    const size_t maxParticles = 8 * seeds.size();
+
+    // The last particle of a closed curve is stitched to the first
+    const bool closed = m_surface_parameters.isSeedCurveClosed() && seeds.size() >= 3;
+
+    std::vector<glm::vec3>    next, nextDerivatives;
+    std::vector<char>         moved;
+    std::vector<unsigned int> nextVertex, nextFront;
+    std::vector<char>         nextAlive;
+
+    bool complete = true;
+    for (unsigned int step = 0; step < m_surface_parameters.traceMaxSteps; step++){
+        if (!interval.contains(time) && !series.interval(time, interval, direction)){
+            complete = false;
+            break;
+        }
+
+        // Advance all particles by one Euler step through the interpolated field
+        const int n = (int)front.size();
+        next.resize(n);
+        nextDerivatives.resize(n);
+        moved.assign(n, 0);
+
+        #pragma omp parallel for schedule(static)
+        for (int p = 0; p < n; p++){
+            if (!alive[p])
+                continue;
+
+            glm::vec3 d = m_field->derivate(m_vertices[front[p]], interval, time);
+            if (d == glm::vec3(0.0f, 0.0f, 0.0f))
+                continue;
+
+            next[p] = m_vertices[front[p]] + stepSize * d;
+            nextDerivatives[p] = d;
+            moved[p] = 1;
+        }
+
+        time += stepSize;
+
+        // Append the moved particles, then stitch them to the previous front
+        bool anyMoved = false;
+        nextVertex.assign(n, 0);
+        for (int p = 0; p < n; p++){
+            if (!moved[p])
+                continue;
+
+            anyMoved = true;
+            nextVertex[p] = (unsigned int)m_vertices.size();
+            m_vertices.push_back(next[p]);
+            m_derivatives.push_back(nextDerivatives[p]);
+            m_texCoords.push_back(glm::length(nextDerivatives[p]));
+        }
+
+        if (!anyMoved)
+            break;
+
+        nextFront.clear();
+        nextAlive.clear();
+        size_t inserted = 0;
+        for (int p = 0; p < n; p++){
+            unsigned int a  = front[p];
+            unsigned int a1 = moved[p] ? nextVertex[p] : a;
+            nextFront.push_back(a1);
+            nextAlive.push_back(moved[p]);
+
+            int q = p + 1 < n ? p + 1 : (closed ? 0 : n);
+            if (q >= n || !moved[p] || !moved[q])
+                continue;
+
+            unsigned int b  = front[q];
+            unsigned int b1 = nextVertex[q];
+
+            if (addition && n + inserted < maxParticles && glm::distance(m_vertices[a1], m_vertices[b1]) > maxSpacing){
+                unsigned int m = (unsigned int)m_vertices.size();
+                m_vertices.push_back(0.5f * (m_vertices[a1] + m_vertices[b1]));
+                m_derivatives.push_back(0.5f * (m_derivatives[a1] + m_derivatives[b1]));
+                m_texCoords.push_back(glm::length(m_derivatives.back()));
+
+                m_faces.push_back(a); m_faces.push_back(b);  m_faces.push_back(m);
+                m_faces.push_back(b); m_faces.push_back(b1); m_faces.push_back(m);
+                m_faces.push_back(a); m_faces.push_back(m);  m_faces.push_back(a1);
+
+                nextFront.push_back(m);
+                nextAlive.push_back(1);
+                inserted++;
+            }
+            else {
+                m_faces.push_back(a); m_faces.push_back(b);  m_faces.push_back(b1);
+                m_faces.push_back(a); m_faces.push_back(b1); m_faces.push_back(a1);
+            }
+        }
+
+        front.swap(nextFront);
+        alive.swap(nextAlive);
+        m_end_time = time;
+    }
+
+    computeNormals();
+    return complete;
+}
+
+void PathSurface::takeResult(StreamTracer::SurfaceResult& result)
+{
+    result.seedingPoints = std::move(m_surface_parameters.seedingPoints);
+    result.vertices      = std::move(m_vertices);
+    result.derivatives   = std::move(m_derivatives);
+    result.normals       = std::move(m_normals);
+    result.texCoords     = std::move(m_texCoords);
+    result.faces         = std::move(m_faces);
+
+    m_surface_parameters.seedingPoints.clear();
+    m_vertices.clear();
+    m_derivatives.clear();
+    m_normals.clear();
+    m_texCoords.clear();
+    m_faces.clear();
+
+    StreamSurface::optimize(result);
+}
+
+void PathSurface::computeNormals()
+{
+    // Area-weighted: the cross product of two edges is twice the triangle area
+    m_normals.assign(m_vertices.size(), glm::vec3(0.0f, 0.0f, 0.0f));
+    for (size_t f = 0; f + 2 < m_faces.size(); f += 3){
+        const glm::vec3& p0 = m_vertices[m_faces[f]];
+        glm::vec3 normal = glm::cross(m_vertices[m_faces[f + 1]] - p0, m_vertices[m_faces[f + 2]] - p0);
+
+        m_normals[m_faces[f]]     += normal;
+        m_normals[m_faces[f + 1]] += normal;
+        m_normals[m_faces[f + 2]] += normal;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int v = 0; v < (int)m_normals.size(); v++){
+        float length = glm::length(m_normals[v]);
+        if (length > 0.0f)
+            m_normals[v] /= length;
+    }
+}
+
+bool PathSurface::tracePathlines(const StreamTracer& field, const std::vector<glm::vec3>& seeds, double startTime,
+                                 float stepSize, unsigned int maxSteps, std::vector< std::vector<glm::vec3> >& lines)
+{
+    PROFILE_ZONE("PathSurface::tracePathlines");
+
+    const int direction = stepSize < 0.0f ? -1 : 1;
+
+    const FieldTimeSeries& series = field.getTimeSeries();
+    FieldTimeSeries::Interval interval;
+    double time = startTime;
+    if (!series.interval(time, interval, direction))
+        return false;
+
+    std::vector<char> alive;
+    field.seedsAreValid(seeds, alive);
+
+    lines.assign(seeds.size(), std::vector<glm::vec3>());
+    for (size_t s = 0; s < seeds.size(); s++)
+        lines[s].push_back(seeds[s]);
+
+    for (unsigned int step = 0; step < maxSteps; step++){
+        if (!interval.contains(time) && !series.interval(time, interval, direction))
+            return false;
+
+        #pragma omp parallel for schedule(static)
+        for (int s = 0; s < (int)seeds.size(); s++){
+            if (!alive[s])
+                continue;
+
+            glm::vec3 d = field.derivate(lines[s].back(), interval, time);
+            if (d == glm::vec3(0.0f, 0.0f, 0.0f))
+                alive[s] = 0;
+            else
+                lines[s].push_back(lines[s].back() + stepSize * d);
+        }
+
+        time += stepSize;
+
+        if (std::find(alive.begin(), alive.end(), 1) == alive.end())
+            break;
+    }
+
+    return true;
+}
@@ -0,0 +1,78 @@
+
+/**
+ *
+ * Path surface generation
+ *
+ * This class releases particles along the seed curve at a start time and moves
+ * them through the time steps of an unsteady StreamTracer; the surface swept by
+ * the particles is triangulated between consecutive steps. All particles share
+ * the same time, so one pair of resident time steps serves the whole front, and
+ * the front advances in parallel. With addition, a particle is inserted where
+ * two neighbours drift further apart than twice their initial spacing.
+ *
+ * The trace direction selects forward or backward in time (TD_BOTH traces
+ * forward). Pathlines are the same particles without the surface between them.
+ *
+ */
+
+#ifndef __PATH_SURFACE__
+#define __PATH_SURFACE__
+
+// STD
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "StreamTracer.h"
+
+class PathSurface
+{
+public:
+
+    PathSurface(const StreamTracer& field);
+
+    void setParameters(const StreamTracer::SurfaceParameters &parameters);
+
+    /// Time at which the particles are released.
+    void setStartTime(double time) { m_start_time = time; }
+    double getStartTime() const { return m_start_time; }
+
+    /// Time reached by the last particle of the latest compute().
+    double getEndTime() const { return m_end_time; }
+
+    /// Trace the surface. Returns false if a time step could not be loaded; the surface then ends there.
+    bool compute(bool addition);
+
+    const std::vector<glm::vec3>&    getVertices() const      { return m_vertices; }
+    const std::vector<glm::vec3>&    getDerivatives() const   { return m_derivatives; }
+    const std::vector<glm::vec3>&    getNormals() const       { return m_normals; }
+    const std::vector<float>&        getTexCoords() const     { return m_texCoords; }
+    const std::vector<unsigned int>& getFaceIndices() const   { return m_faces; }
+    const std::vector<glm::vec3>&    getSeedingPoints() const { return m_surface_parameters.seedingPoints; }
+
+    /// Move the geometry out, reordered like a stream surface (see StreamSurface::optimize).
+    void takeResult(StreamTracer::SurfaceResult& result);
+
+    /// Trace one pathline per seed, released at startTime, over maxSteps steps of stepSize
+    /// (negative: backward in time). A line ends where it leaves the domain or stalls.
+    static bool tracePathlines(const StreamTracer& field, const std::vector<glm::vec3>& seeds, double startTime,
+                               float stepSize, unsigned int maxSteps, std::vector< std::vector<glm::vec3> >& lines);
+
+private:
+    void computeNormals();
+
+    const StreamTracer* m_field;
+
+    StreamTracer::SurfaceParameters m_surface_parameters;
+    double m_start_time, m_end_time;
+
+    std::vector< glm::vec3 >    m_vertices;
+    std::vector< glm::vec3 >    m_derivatives;
+    std::vector< glm::vec3 >    m_normals;
+    std::vector< float >        m_texCoords;
+    std::vector< unsigned int > m_faces;
+};
+
+#endif
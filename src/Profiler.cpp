@@ -0,0 +1,211 @@
+#include "Profiler.h"
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#    include <windows.h>
+#endif
+
+// Stream Tracer
+#include "JsonWriter.h"
+#include "ThreadLocal.h"
+
+#ifdef STREAM_SURFACE_PROFILER
+
+namespace
+{
+    // Zones kept per thread (24 bytes each)
+    const unsigned long long RING_SIZE = 1 << 16;
+
+    struct Event
+    {
+        const char* name;
+        long long   begin, end;
+    };
+
+    /// Written by its thread only. head counts all zones ever recorded; the reader
+    /// discards slots that may have been overwritten while it was copying them.
+    struct Ring
+    {
+        Ring(unsigned int id) : id(id), head(0) { name[0] = '\0'; }
+
+        unsigned int id;
+        char name[64];
+        std::atomic<unsigned long long> head;
+        Event events[RING_SIZE];
+    };
+
+    // Rings live until the program ends, so zones of finished threads are kept
+    std::mutex         g_rings_mutex;
+    std::vector<Ring*> g_rings;
+
+    THREAD_LOCAL Ring* t_ring = NULL;
+
+    Ring* threadRing()
+    {
+        if (!t_ring){
+            std::lock_guard<std::mutex> lock(g_rings_mutex);
+            t_ring = new Ring((unsigned int)g_rings.size());
+            g_rings.push_back(t_ring);
+        }
+        return t_ring;
+    }
+}
+
+bool Profiler::enabled()
+{
+    return true;
+}
+
+void Profiler::setThreadName(const char* name)
+{
+    Ring* ring = threadRing();
+    std::strncpy(ring->name, name, sizeof(ring->name) - 1);
+    ring->name[sizeof(ring->name) - 1] = '\0';
+}
+
+void Profiler::record(const char* name, long long begin, long long end)
+{
+    Ring* ring = threadRing();
+
+    unsigned long long head = ring->head.load(std::memory_order_relaxed);
+    Event& event = ring->events[head % RING_SIZE];
+    event.name  = name;
+    event.begin = begin;
+    event.end   = end;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Profiler::writeChromeTrace(const std::string& filename)
+{
+    struct Recorded
+    {
+        unsigned int thread;
+        Event        event;
+    };
+
+    std::vector<Recorded> zones;
+    std::vector<std::pair<unsigned int, std::string> > threads;
+
+    {
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        for (size_t r = 0; r < g_rings.size(); r++){
+            Ring* ring = g_rings[r];
+
+            unsigned long long head  = ring->head.load(std::memory_order_acquire);
+            unsigned long long first = head > RING_SIZE ? head - RING_SIZE : 0;
+
+            size_t copied = zones.size();
+            for (unsigned long long e = first; e < head; e++){
+                Recorded zone = { ring->id, ring->events[e % RING_SIZE] };
+                zones.push_back(zone);
+            }
+
+            // Drop what the thread overwrote in the meantime
+            unsigned long long after = ring->head.load(std::memory_order_acquire);
+            unsigned long long valid = after > RING_SIZE ? after - RING_SIZE : 0;
+            if (valid > first)
+                zones.erase(zones.begin() + copied, zones.begin() + copied + (size_t)std::min(valid - first, head - first));
+
+            threads.push_back(std::make_pair(ring->id, std::string(ring->name)));
+        }
+    }
+
+    std::ofstream out(filename.c_str());
+    if (!out){
+        std::cout << "Profiler: cannot write " << filename << std::endl;
+        return false;
+    }
+
+    long long origin = 0;
+    for (size_t z = 0; z < zones.size(); z++)
+        origin = z == 0 ? zones[z].event.begin : std::min(origin, zones[z].event.begin);
+
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("displayTimeUnit").value("ms");
+    json.key("traceEvents").beginArray();
+
+    for (size_t t = 0; t < threads.size(); t++){
+        if (threads[t].second.empty())
+            continue;
+
+        json.beginObject();
+        json.key("name").value("thread_name");
+        json.key("ph").value("M");
+        json.key("pid").value(1);
+        json.key("tid").value(threads[t].first);
+        json.key("args").beginObject();
+        json.key("name").value(threads[t].second);
+        json.endObject();
+        json.endObject();
+    }
+
+    // Complete events, timestamps in microseconds
+    for (size_t z = 0; z < zones.size(); z++){
+        const Event& event = zones[z].event;
+
+        json.beginObject();
+        json.key("name").value(event.name);
+        json.key("ph").value("X");
+        json.key("pid").value(1);
+        json.key("tid").value(zones[z].thread);
+        json.key("ts").value((event.begin - origin) / 1000.0);
+        json.key("dur").value((event.end - event.begin) / 1000.0);
+        json.endObject();
+    }
+
+    json.endArray();
+    json.endObject();
+    out << std::endl;
+
+    std::cout << "Profiler: " << zones.size() << " zones of " << threads.size() << " threads written to " << filename << std::endl;
+    return !!out;
+}
+
+#else
+
+bool Profiler::enabled()
+{
+    return false;
+}
+
+void Profiler::setThreadName(const char*)
+{
+}
+
+void Profiler::record(const char*, long long, long long)
+{
+}
+
+bool Profiler::writeChromeTrace(const std::string& filename)
+{
+    std::cout << "Profiler: not written to " << filename << ", configure with -DSTREAM_SURFACE_GENERATOR_PROFILER=ON" << std::endl;
+    return false;
+}
+
+#endif
+
+long long Profiler::now()
+{
+#ifdef _WIN32
+    // steady_clock only ticks every few milliseconds with some Visual Studio versions
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (long long)((double)counter.QuadPart * 1.0e9 / (double)frequency.QuadPart);
+#else
+    return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
@@ -0,0 +1,74 @@
+
+/**
+ *
+ * Hot-path zone profiler
+ *
+ * This class records scoped zones (name, wall-clock begin and end) and dumps
+ * them as a Chrome trace, which chrome://tracing and ui.perfetto.dev display as
+ * a timeline per thread:
+ *
+ *   void StreamTracer::computeAccel()
+ *   {
+ *       PROFILE_ZONE("computeAccel");
+ *       ...
+ *   }
+ *
+ * Zones are only recorded in builds with the CMake option
+ * STREAM_SURFACE_GENERATOR_PROFILER; otherwise PROFILE_ZONE expands to nothing
+ * and writeChromeTrace() reports that there is nothing to write.
+ *
+ * Every thread appends to its own ring buffer, so recording takes no lock; when
+ * a ring is full the oldest zones are overwritten. Zone names must be string
+ * literals, as only the pointer is stored.
+ *
+ */
+
+#ifndef __PROFILER__
+#define __PROFILER__
+
+// STD
+#include <string>
+
+#ifdef STREAM_SURFACE_PROFILER
+#    define PROFILE_CONCAT_(a, b) a##b
+#    define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#    define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#    define PROFILE_ZONE(name)
+#endif
+
+class Profiler
+{
+public:
+
+    /// Whether zones are recorded in this build.
+    static bool enabled();
+
+    /// Label the calling thread in the trace, e.g. "Surface worker".
+    static void setThreadName(const char* name);
+
+    /// Write all recorded zones of all threads. Returns false if profiling is compiled out or the file cannot be written.
+    static bool writeChromeTrace(const std::string& filename);
+
+    /// Wall-clock time in nanoseconds.
+    static long long now();
+
+    /// Append a finished zone to the ring of the calling thread.
+    static void record(const char* name, long long begin, long long end);
+
+    class Zone
+    {
+    public:
+        Zone(const char* name) : m_name(name), m_begin(now()) {}
+        ~Zone() { record(m_name, m_begin, now()); }
+
+    private:
+        Zone(const Zone&);
+        Zone& operator=(const Zone&);
+
+        const char* m_name;
+        long long   m_begin;
+    };
+};
+
+#endif
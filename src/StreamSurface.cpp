@@ -0,0 +1,600 @@
+#include "StreamSurface.h"
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+// Stream Tracer
+#include "MemoryReport.h"
+#include "MeshOptimizer.h"
+#include "Profiler.h"
+#include "TracerStats.h"
+
+StreamSurface::StreamSurface(const StreamTracer& field)
+    : m_field(&field)
+{
+    field.getParameters(m_surface_parameters);
+
+    m_trace_addition = m_trace_remove = m_trace_ripping = false;
+    m_trace_advance = m_trace_total_advances = 0;
+    m_cancel = NULL;
+    m_closed_front = false;
+
+    m_normal_indices = m_normal_vertices = 0;
+    m_peak_vertices = m_peak_indices = m_peak_front = 0;
+}
+
+void StreamSurface::getParameters(StreamTracer::SurfaceParameters &parameters) const
+{
+    parameters = m_surface_parameters;
+}
+
+void StreamSurface::setParameters(const StreamTracer::SurfaceParameters &parameters)
+{
+    m_surface_parameters = parameters;
+}
+
+void StreamSurface::compute(bool addition, bool remove, bool ripping) {
+    begin(addition, remove, ripping);
+    advance(0, 0.0);
+    updateNormals();
+}
+
+bool StreamSurface::traceRibbon(const unsigned int& ribbon_id, bool addition, bool remove, bool ripping, unsigned int depth) {
+    
+    // The last ribbon of an open front is not traced; a closed front has no last ribbon
+    size_t ribbons = m_advancing_front.size() / 2;
+    if (ribbon_id >= (m_closed_front ? ribbons : ribbons - 1))
+        return false;
+
+    TracerStats::Local& stats = TracerStats::local();
+    stats.add(TracerStats::RIBBON_CALLS);
+    stats.sample(TracerStats::RECURSION_DEPTH, depth);
+    stats.maximum(TracerStats::MAX_RECURSION_DEPTH, depth);
+
+    bool caught_up = false;
+    float prev_diagonal = 0.0f;
+    while (true){
+
+        if (m_cancel && *m_cancel)
+            return false;
+
+        unsigned int L0 = m_advancing_front[2 * ribbon_id];
+        unsigned int R0 = m_advancing_front[2 * ribbon_id + 1];
+
+        glm::vec3 d_l = m_field->derivate(m_vertices[L0]);
+        if (glm::length(d_l) < 1e-14f){
+            stats.add(TracerStats::ZERO_VELOCITY_EXITS);
+            break;
+        }
+
+        glm::vec3 d_r = m_field->derivate(m_vertices[R0]);
+        if (glm::length(d_r) < 1e-14f){
+            stats.add(TracerStats::ZERO_VELOCITY_EXITS);
+            break;
+        }
+
+        // Ripping
+        if (ripping && glm::dot(glm::normalize(d_l), glm::normalize(d_r)) < 0.8f){
+            stats.add(TracerStats::RIPS);
+            return false;
+        }
+
+        glm::vec3 p_l = m_vertices[L0] + d_l * m_surface_parameters.traceStepSize;
+        glm::vec3 p_r = m_vertices[R0] + d_r * m_surface_parameters.traceStepSize;
+
+        // A step too small to move the vertex stops the ribbon like a vanishing velocity
+        if (p_l == m_vertices[L0] || p_r == m_vertices[R0]){
+            stats.add(TracerStats::ZERO_VELOCITY_EXITS);
+            break;
+        }
+
+        if (addition){
+            // Addition
+            //glm::float32 maxW = glm::max(glm::length(m_vertices[L1] - m_vertices[R1]), glm::length(m_vertices[L0] - m_vertices[R0]));
+            //glm::float32 minH = glm::min(glm::length(m_vertices[L0] - m_vertices[L1]), glm::length(m_vertices[R1] - m_vertices[R0]));
+            glm::float32 maxW = glm::length(p_l - p_r) + glm::length(m_vertices[L0] - m_vertices[R0]);
+            glm::float32 minH = glm::length(m_vertices[L0] - p_l) + glm::length(p_r - m_vertices[R0]);
+            if (maxW / minH > 2.0f){
+                glm::vec3 newVert = (p_l + p_r) / 2.0f;
+                m_vertices.push_back(p_l);
+                m_derivaties.push_back(d_l);
+                m_texCoords.push_back(glm::length(d_l));
+                m_advancing_front[2 * ribbon_id] = m_vertices.size() - 1;
+
+                m_vertices.push_back(newVert);
+                m_derivaties.push_back(m_field->derivate(newVert));
+                m_texCoords.push_back(glm::length(m_derivaties.back()));
+                m_advancing_front.insert((m_advancing_front.begin() + (2 * ribbon_id + 1)), m_vertices.size() - 1);
+                m_advancing_front.insert((m_advancing_front.begin() + (2 * ribbon_id + 1)), m_vertices.size() - 1);
+                
+                m_vertices.push_back(p_r);
+                m_derivaties.push_back(d_r);
+                m_texCoords.push_back(glm::length(d_r));
+                m_advancing_front[2 * ribbon_id + 3] = m_vertices.size() - 1;
+
+                m_faces.push_back(L0); m_faces.push_back(m_vertices.size() - 2); m_faces.push_back(m_vertices.size() - 3);
+                m_faces.push_back(L0); m_faces.push_back(R0);                    m_faces.push_back(m_vertices.size() - 2);
+                m_faces.push_back(R0); m_faces.push_back(m_vertices.size() - 1); m_faces.push_back(m_vertices.size() - 2);
+
+                stats.add(TracerStats::ADDITIONS);
+                return true;
+            }
+        }
+
+        float left_diagonal = glm::length(p_l - m_vertices[R0]);
+        float right_diagonal = glm::length(p_r - m_vertices[L0]);
+        float min_diagonal = glm::min(left_diagonal, right_diagonal);
+        bool trace_left = (left_diagonal == min_diagonal);
+
+        if (caught_up && (trace_left || right_diagonal > prev_diagonal)) return false;
+
+        if (trace_left){
+
+            m_vertices.push_back(p_l);
+            m_derivaties.push_back(d_l);
+            m_texCoords.push_back(glm::length(d_l));
+            m_advancing_front[2 * ribbon_id] = m_vertices.size() - 1;
+
+            m_faces.push_back(L0);
+            m_faces.push_back(R0);
+            m_faces.push_back(m_vertices.size() - 1);
+
+            caught_up = true;
+        } else{
+            m_vertices.push_back(p_r);
+            m_derivaties.push_back(d_r);
+            m_texCoords.push_back(glm::length(d_r));
+            int newVertIdx = m_vertices.size() - 1;
+
+            m_faces.push_back(L0);
+            m_faces.push_back(R0);
+            m_faces.push_back(newVertIdx);
+
+            // The closing ribbon does not pull the first one along: the chain would come back to the
+            // ribbons still being traced further up, and an addition in the first ribbon would shift them
+            traceRibbon(ribbon_id + 1, addition, remove, ripping, depth + 1);
+
+            m_advancing_front[2 * ribbon_id + 1] = newVertIdx;
+        }
+        
+        prev_diagonal = min_diagonal;
+    }
+
+    return false;
+}
+
+void StreamSurface::reportMemory(MemoryReport& report) const {
+    report.add("surface/vertices", m_vertices);
+    report.add("surface/derivatives", m_derivaties);
+    report.add("surface/normals", m_normals);
+    report.add("surface/normal sums", (unsigned long long)(m_normal_sums.capacity() * sizeof(glm::vec3) + m_normal_counts.capacity() * sizeof(glm::uint32)));
+    report.add("surface/tex coords", m_texCoords);
+    report.add("surface/faces", m_faces);
+    report.add("surface/front", m_advancing_front);
+    report.add("surface/scratch", (unsigned long long)m_scratch.getCapacityBytes());
+}
+
+void StreamSurface::recordPeaks() {
+    m_peak_vertices = std::max(m_peak_vertices, m_vertices.size());
+    m_peak_indices  = std::max(m_peak_indices, m_faces.size());
+    m_peak_front    = std::max(m_peak_front, m_advancing_front.size());
+}
+
+void StreamSurface::begin(bool addition, bool remove, bool ripping) {
+    recordPeaks();
+
+    m_vertices.clear();
+    m_faces.clear();
+    m_derivaties.clear();
+    m_texCoords.clear();
+    m_advancing_front.clear();
+
+    m_normals.clear();
+    m_normal_sums.clear();
+    m_normal_counts.clear();
+    m_normal_indices = m_normal_vertices = 0;
+
+    // clear() keeps the capacity, but a taken result leaves empty buffers behind. Reserving
+    // the previous peak avoids the reallocation copies while the surface grows again.
+    m_vertices.reserve(m_peak_vertices);
+    m_derivaties.reserve(m_peak_vertices);
+    m_texCoords.reserve(m_peak_vertices);
+    m_faces.reserve(m_peak_indices);
+    m_advancing_front.reserve(m_peak_front);
+
+    m_trace_addition = addition;
+    m_trace_remove   = remove;
+    m_trace_ripping  = ripping;
+
+    generateSeedingPoints();
+
+    // All seeds in one lookup, so that an out-of-core field reads each of their bricks once
+    std::vector<glm::vec3> seedDerivatives;
+    m_field->derivate(m_surface_parameters.seedingPoints, seedDerivatives);
+
+    for (size_t p = 0; p < m_surface_parameters.seedingPoints.size(); p++){
+        m_vertices.push_back(m_surface_parameters.seedingPoints[p]);
+        m_derivaties.push_back(seedDerivatives[p]);
+        m_texCoords.push_back(glm::length(m_derivaties[p]));
+
+        if (p < m_surface_parameters.seedingPoints.size() - 1){
+            m_advancing_front.push_back(p);
+            m_advancing_front.push_back(p + 1);
+        }
+    }
+
+    // A closed curve gets one more ribbon, from its last seed back to the first
+    size_t nSeeds = m_surface_parameters.seedingPoints.size();
+    m_closed_front = m_surface_parameters.isSeedCurveClosed() && nSeeds >= 3;
+    if (m_closed_front){
+        m_advancing_front.push_back((int)nSeeds - 1);
+        m_advancing_front.push_back(0);
+    }
+
+    // A front needs at least one ribbon (two seeds) to advance
+    int nSeedingPoints = 20; //m_advancing_front.size();
+    m_trace_advance = 0;
+    m_trace_total_advances = m_advancing_front.empty() ? 0 : nSeedingPoints * m_surface_parameters.traceMaxSeeds;
+}
+
+bool StreamSurface::advance(size_t maxAdvances, double maxMilliseconds) {
+    PROFILE_ZONE("traceRibbon batch");
+
+    std::chrono::steady_clock::time_point slice_start = std::chrono::steady_clock::now();
+
+    TracerStats::Local& stats = TracerStats::local();
+    size_t vertices = m_vertices.size(), triangles = m_faces.size() / 3;
+
+    for (size_t n = 0; m_trace_advance < m_trace_total_advances; n++, m_trace_advance++){
+        if (maxAdvances > 0 && n >= maxAdvances)
+            break;
+
+        if (m_cancel && *m_cancel)
+            break;
+
+        // Checking the clock on every advance is too expensive for short ribbons
+        if (maxMilliseconds > 0.0 && n > 0 && (n % 16) == 0){
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - slice_start).count();
+            if (elapsed >= maxMilliseconds)
+                break;
+        }
+
+        unsigned int ribbons = (unsigned int)(m_advancing_front.size() / 2);
+        stats.sample(TracerStats::FRONT_SIZE, ribbons);
+        stats.maximum(TracerStats::MAX_FRONT_SIZE, ribbons);
+        if ((m_trace_advance % 256) == 0)
+            TracerStats::sampleFrontSize(ribbons);
+
+        traceRibbon(m_trace_advance % (m_advancing_front.size() - 1), m_trace_addition, m_trace_remove, m_trace_ripping);
+    }
+
+    stats.add(TracerStats::VERTICES_EMITTED, m_vertices.size() - vertices);
+    stats.add(TracerStats::TRIANGLES_EMITTED, m_faces.size() / 3 - triangles);
+
+    return finished();
+}
+
+bool StreamSurface::finished() const {
+    return m_trace_advance >= m_trace_total_advances;
+}
+
+void StreamSurface::setCancellationToken(const std::atomic<bool>* token) {
+    m_cancel = token;
+}
+
+void StreamSurface::takeResult(StreamTracer::SurfaceResult& result) {
+    recordPeaks();
+
+    result.seedingPoints = std::move(m_surface_parameters.seedingPoints);
+    result.vertices      = std::move(m_vertices);
+    result.derivatives   = std::move(m_derivaties);
+    result.normals       = std::move(m_normals);
+    result.texCoords     = std::move(m_texCoords);
+    result.faces         = std::move(m_faces);
+
+    // Moved-from vectors are only guaranteed to be valid, not empty
+    m_surface_parameters.seedingPoints.clear();
+    m_vertices.clear();
+    m_derivaties.clear();
+    m_normals.clear();
+    m_texCoords.clear();
+    m_faces.clear();
+
+    m_advancing_front.clear();
+    m_closed_front = false;
+    m_normal_sums.clear();
+    m_normal_counts.clear();
+    m_normal_indices = m_normal_vertices = 0;
+    m_trace_advance = m_trace_total_advances = 0;
+
+    optimize(result);
+}
+
+void StreamSurface::optimize(StreamTracer::SurfaceResult& surface) {
+    PROFILE_ZONE("optimize");
+
+    // The seed curve stays at the front, where the simplifier and the cache expect it
+    MeshOptimizer::optimizeVertexCache(surface.faces, surface.vertices.size());
+
+    std::vector<unsigned int> remap;
+    MeshOptimizer::optimizeVertexFetch(surface.faces, surface.vertices.size(), surface.seedingPoints.size(), remap);
+
+    MeshOptimizer::remapVertices(surface.vertices, remap);
+    MeshOptimizer::remapVertices(surface.derivatives, remap);
+    MeshOptimizer::remapVertices(surface.normals, remap);
+    MeshOptimizer::remapVertices(surface.texCoords, remap);
+}
+
+size_t StreamSurface::updateNormals() {
+    size_t nVertices = m_vertices.size();
+    size_t firstChanged = m_normal_vertices;
+
+    if (m_normals.capacity() < m_peak_vertices){
+        m_normals.reserve(m_peak_vertices);
+        m_normal_sums.reserve(m_peak_vertices);
+        m_normal_counts.reserve(m_peak_vertices);
+    }
+
+    m_normals.resize(nVertices, glm::vec3(0.0f, 0.0f, 0.0f));
+    m_normal_sums.resize(nVertices, glm::vec3(0.0f, 0.0f, 0.0f));
+    m_normal_counts.resize(nVertices, 0);
+    m_normal_vertices = nVertices;
+
+    long long firstFace = m_normal_indices / 3;
+    long long nFaces = (long long)(m_faces.size() / 3) - firstFace;
+    m_normal_indices = (size_t)(firstFace + nFaces) * 3;
+    if (nFaces <= 0)
+        return firstChanged;
+
+    // The cross product is twice the triangle area, which gives the area weighting for free
+    m_scratch.reset();
+    ArenaVector<glm::vec3> faceNormals(nFaces, glm::vec3(), ArenaAllocator<glm::vec3>(m_scratch));
+    ArenaVector<unsigned long long> incidence(nFaces * 3, 0, ArenaAllocator<unsigned long long>(m_scratch));
+
+    #pragma omp parallel for
+    for (long long f = 0; f < nFaces; f++){
+        const unsigned int* face = &m_faces[(firstFace + f) * 3];
+        faceNormals[f] = glm::cross(m_vertices[face[1]] - m_vertices[face[0]], m_vertices[face[2]] - m_vertices[face[0]]);
+
+        // (vertex, face) pairs; sorted by vertex, every vertex owns a contiguous run
+        for (int c = 0; c < 3; c++)
+            incidence[f * 3 + c] = ((unsigned long long)face[c] << 32) | (unsigned long long)f;
+    }
+
+    std::sort(incidence.begin(), incidence.end());
+
+    ArenaAllocator<size_t> runAllocator(m_scratch);
+    ArenaVector<size_t> runs(runAllocator);
+    runs.reserve(incidence.size() + 1);
+    for (size_t i = 0; i < incidence.size(); i++){
+        if (i == 0 || (incidence[i] >> 32) != (incidence[i - 1] >> 32))
+            runs.push_back(i);
+    }
+    runs.push_back(incidence.size());
+
+    firstChanged = std::min(firstChanged, (size_t)(incidence[0] >> 32));
+
+    // Each run writes a different vertex, so the scatter needs no synchronization
+    long long nRuns = (long long)runs.size() - 1;
+    #pragma omp parallel for
+    for (long long r = 0; r < nRuns; r++){
+        size_t v = (size_t)(incidence[runs[r]] >> 32);
+
+        glm::vec3 sum(0.0f, 0.0f, 0.0f);
+        for (size_t i = runs[r]; i < runs[r + 1]; i++)
+            sum += faceNormals[incidence[i] & 0xffffffffULL];
+
+        m_normal_sums[v] += sum;
+        m_normal_counts[v] += (glm::uint32)(runs[r + 1] - runs[r]);
+
+        float length = glm::length(m_normal_sums[v]);
+        m_normals[v] = length > 0.0f ? m_normal_sums[v] / length : glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    return firstChanged;
+}
+
+void StreamSurface::generateSeedingPoints() {
+    std::vector<glm::vec3>& seeds = m_surface_parameters.seedingPoints;
+    seeds.clear();
+
+    const unsigned int maxSeeds = m_surface_parameters.traceMaxSeeds;
+    if (maxSeeds < 2)
+        return;
+
+    // Densely sampled candidates along the curve, uniform in arc length
+    std::vector<glm::vec3> candidates;
+    sampleSeedCurve(m_surface_parameters, std::max(8 * maxSeeds, 256u), candidates);
+    if (candidates.size() < 2)
+        return;
+
+    std::vector<char> valid;
+    m_field->seedsAreValid(candidates, valid);
+
+    // Seeding density per candidate; seeds never land outside the domain
+    std::vector<float> density(candidates.size(), 0.0f);
+    for (size_t c = 0; c < candidates.size(); c++)
+        density[c] = valid[c] ? 1.0f : 0.0f;
+
+    unsigned int nSeeds = maxSeeds;
+    if (m_surface_parameters.adaptiveSeeding){
+        float spacing = glm::length(candidates[1] - candidates[0]);
+        nSeeds = adaptSeedingDensity(candidates, valid, spacing, density);
+    }
+
+    // A closed curve also has the segment from its last candidate back to the first
+    bool closed = m_surface_parameters.isSeedCurveClosed();
+    if (closed){
+        candidates.push_back(candidates.front());
+        density.push_back(density.front());
+    }
+
+    // Inverse transform sampling of the density over the curve segments
+    std::vector<float> cdf(candidates.size(), 0.0f);
+    for (size_t c = 1; c < candidates.size(); c++)
+        cdf[c] = cdf[c - 1] + 0.5f * (density[c - 1] + density[c]);
+
+    float total = cdf.back();
+    if (total <= 0.0f)
+        return;
+
+    size_t c = 1;
+    for (unsigned int s = 0; s < nSeeds; s++){
+        float target = total * s / (closed ? nSeeds : nSeeds - 1);
+        while (c < cdf.size() - 1 && cdf[c] < target)
+            c++;
+
+        float width = cdf[c] - cdf[c - 1];
+        float t = width > 0.0f ? glm::clamp((target - cdf[c - 1]) / width, 0.0f, 1.0f) : 0.0f;
+        seeds.push_back(glm::mix(candidates[c - 1], candidates[c], t));
+    }
+
+    // Interpolated seeds next to the domain boundary can still fall outside
+    m_field->seedsAreValid(seeds, valid);
+    size_t kept = 0;
+    for (size_t s = 0; s < seeds.size(); s++)
+        if (valid[s])
+            seeds[kept++] = seeds[s];
+    seeds.resize(kept);
+}
+
+unsigned int StreamSurface::adaptSeedingDensity(const std::vector<glm::vec3>& candidates, const std::vector<char>& valid, float spacing, std::vector<float>& density) const {
+    // Laminar stretches keep this fraction of the uniform seed density
+    const float MIN_DENSITY = 0.25f;
+
+    // Relative velocity variation over one candidate spacing: |velocity gradient| + |divergence|,
+    // estimated with central differences and normalized by the local speed
+    std::vector<float> variation(candidates.size(), 0.0f);
+    float h = std::max(spacing, 1e-6f);
+
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < (int)candidates.size(); c++){
+        if (!valid[c])
+            continue;
+
+        float gradient = 0.0f, divergence = 0.0f;
+        for (int axis = 0; axis < 3; axis++){
+            glm::vec3 offset(0.0f, 0.0f, 0.0f);
+            offset[axis] = h;
+
+            glm::vec3 column = (m_field->derivate(candidates[c] + offset) - m_field->derivate(candidates[c] - offset)) / (2.0f * h);
+            gradient   += glm::dot(column, column);
+            divergence += column[axis];
+        }
+
+        float speed = glm::length(m_field->derivate(candidates[c]));
+        variation[c] = (std::sqrt(gradient) + std::abs(divergence)) * h / std::max(speed, 1e-14f);
+    }
+
+    // Normalize by a high percentile so single outliers do not flatten the rest of the curve
+    std::vector<float> sorted;
+    for (size_t c = 0; c < candidates.size(); c++)
+        if (valid[c])
+            sorted.push_back(variation[c]);
+    if (sorted.empty())
+        return 0;
+
+    size_t percentile = (sorted.size() * 9) / 10;
+    std::nth_element(sorted.begin(), sorted.begin() + percentile, sorted.end());
+    float reference = sorted[percentile];
+
+    float sum = 0.0f;
+    for (size_t c = 0; c < candidates.size(); c++){
+        if (!valid[c])
+            continue;
+
+        density[c] = reference > 0.0f ? glm::clamp(variation[c] / reference, MIN_DENSITY, 1.0f) : MIN_DENSITY;
+        sum += density[c];
+    }
+
+    // The mean density scales the seed budget down for mostly laminar curves
+    unsigned int nSeeds = (unsigned int)(m_surface_parameters.traceMaxSeeds * sum / candidates.size() + 0.5f);
+    return std::max(nSeeds, 2u);
+}
+
+void StreamSurface::sampleSeedCurve(const StreamTracer::SurfaceParameters& parameters, unsigned int nSamples, std::vector<glm::vec3>& samples) {
+    samples.clear();
+
+    // Control polygon of the curve
+    std::vector<glm::vec3> polygon;
+    const glm::vec3& center = parameters.seedingLineCenter;
+    glm::vec3 direction = parameters.seedingLineDirection;
+    if (glm::length(direction) > 0.0f)
+        direction = glm::normalize(direction);
+
+    switch (parameters.seedCurveType){
+    case StreamTracer::SurfaceParameters::SC_LINE:
+        polygon.push_back(center - 0.5f * parameters.seedingLineLength * direction);
+        polygon.push_back(center + 0.5f * parameters.seedingLineLength * direction);
+        break;
+
+    case StreamTracer::SurfaceParameters::SC_CIRCLE:
+    {
+        // Orthonormal basis of the circle plane; the polygon returns to its first point
+        glm::vec3 helper = std::abs(direction.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 e1 = glm::normalize(glm::cross(direction, helper));
+        glm::vec3 e2 = glm::cross(direction, e1);
+
+        for (unsigned int i = 0; i <= nSamples; i++){
+            float angle = 2.0f * 3.14159265f * i / nSamples;
+            polygon.push_back(center + parameters.seedingLineLength * (std::cos(angle) * e1 + std::sin(angle) * e2));
+        }
+        break;
+    }
+
+    case StreamTracer::SurfaceParameters::SC_POLYLINE:
+        polygon = parameters.seedCurvePoints;
+        break;
+
+    case StreamTracer::SurfaceParameters::SC_SPLINE:
+    {
+        // Uniform Catmull-Rom spline with duplicated end points, 16 segments per span
+        const std::vector<glm::vec3>& p = parameters.seedCurvePoints;
+        if (p.size() < 3){
+            polygon = p;
+            break;
+        }
+
+        for (size_t i = 0; i + 1 < p.size(); i++){
+            const glm::vec3& p0 = p[i > 0 ? i - 1 : i];
+            const glm::vec3& p1 = p[i];
+            const glm::vec3& p2 = p[i + 1];
+            const glm::vec3& p3 = p[i + 2 < p.size() ? i + 2 : i + 1];
+
+            for (int k = 0; k < 16; k++){
+                float t = k / 16.0f, t2 = t * t, t3 = t2 * t;
+                polygon.push_back(0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3));
+            }
+        }
+        polygon.push_back(p.back());
+        break;
+    }
+    }
+
+    if (polygon.size() < 2 || nSamples < 2)
+        return;
+
+    // Resample the polygon uniformly in arc length. A closed curve stops one spacing
+    // short of its end, which is its first sample again.
+    bool closed = parameters.isSeedCurveClosed();
+    std::vector<float> arc(polygon.size(), 0.0f);
+    for (size_t i = 1; i < polygon.size(); i++)
+        arc[i] = arc[i - 1] + glm::length(polygon[i] - polygon[i - 1]);
+
+    if (arc.back() <= 0.0f)
+        return;
+
+    size_t i = 1;
+    for (unsigned int s = 0; s < nSamples; s++){
+        float target = arc.back() * s / (closed ? nSamples : nSamples - 1);
+        while (i < arc.size() - 1 && arc[i] < target)
+            i++;
+
+        float length = arc[i] - arc[i - 1];
+        float t = length > 0.0f ? glm::clamp((target - arc[i - 1]) / length, 0.0f, 1.0f) : 0.0f;
+        samples.push_back(glm::mix(polygon[i - 1], polygon[i], t));
+    }
+}
@@ -0,0 +1,108 @@
+
+/**
+ *
+ * Stream surface generation state
+ *
+ * This class grows one Hultquist stream surface through the field of a StreamTracer.
+ * The field is only read, so any number of surfaces can be traced concurrently.
+ *
+ */
+
+#ifndef __STREAM_SURFACE__
+#define __STREAM_SURFACE__
+
+// STD
+#include <atomic>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "GenerationArena.h"
+#include "StreamTracer.h"
+
+class MemoryReport;
+
+class StreamSurface
+{
+public:
+
+    StreamSurface(const StreamTracer& field);
+
+    void getParameters(StreamTracer::SurfaceParameters &parameters) const;
+    void setParameters(const StreamTracer::SurfaceParameters &parameters);
+
+    /// Progressive generation, see StreamTracer::beginStreamsurfaces.
+    void begin(bool addition, bool remove, bool ripping);
+    bool advance(size_t maxAdvances, double maxMilliseconds);
+    bool finished() const;
+
+    void compute(bool addition, bool remove, bool ripping);
+
+    void setCancellationToken(const std::atomic<bool>* token);
+
+    /// Accumulate area-weighted vertex normals for the triangles appended since the last call.
+    /// Returns the first vertex whose normal changed (the vertex count if none did); normals
+    /// of vertices that are not referenced by any triangle yet are zero.
+    size_t updateNormals();
+
+    /// Add the bytes of the surface buffers and the scratch memory.
+    void reportMemory(MemoryReport& report) const;
+
+    const std::vector<glm::vec3>&    getVertices() const      { return m_vertices; }
+    const std::vector<glm::vec3>&    getDerivatives() const   { return m_derivaties; }
+    const std::vector<glm::vec3>&    getNormals() const       { return m_normals; }
+    const std::vector<float>&        getTexCoords() const     { return m_texCoords; }
+    const std::vector<unsigned int>& getFaceIndices() const   { return m_faces; }
+    const std::vector<glm::vec3>&    getSeedingPoints() const { return m_surface_parameters.seedingPoints; }
+
+    /// Move the geometry out, reordered by optimize(), and leave an empty, finished surface behind.
+    void takeResult(StreamTracer::SurfaceResult& result);
+
+    /// Reorder a finished surface for the GPU: triangles for the vertex cache, then vertices in
+    /// order of first use. The seeding points keep their place at the front of the vertices.
+    static void optimize(StreamTracer::SurfaceResult& surface);
+
+    /// Sample a seed curve at nSamples points, uniformly spaced in arc length. A closed
+    /// curve is sampled without repeating its first point at the end.
+    static void sampleSeedCurve(const StreamTracer::SurfaceParameters& parameters, unsigned int nSamples, std::vector<glm::vec3>& samples);
+
+private:
+    void recordPeaks();
+    void generateSeedingPoints();
+    unsigned int adaptSeedingDensity(const std::vector<glm::vec3>& candidates, const std::vector<char>& valid, float spacing, std::vector<float>& density) const;
+    bool traceRibbon(const unsigned int& ribbon_id, bool addition, bool remove, bool ripping, unsigned int depth = 1);
+
+    const StreamTracer* m_field;
+
+    StreamTracer::SurfaceParameters m_surface_parameters;
+
+    std::vector< glm::vec3 >    m_vertices;
+    std::vector< glm::vec3 >    m_derivaties;
+    std::vector< glm::vec3 >    m_normals;
+    std::vector< glm::uint32 >  m_normal_counts;
+
+    // Unnormalized area-weighted sums and the part of the mesh they already cover
+    std::vector< glm::vec3 >    m_normal_sums;
+    size_t                      m_normal_indices, m_normal_vertices;
+
+    std::vector< float >        m_texCoords;
+    std::vector< unsigned int>  m_faces;
+
+    std::vector< int >  m_advancing_front;
+    bool                m_closed_front;     // the last ribbon joins the last seed to the first
+
+    // Scratch memory of one stage (e.g. a normal update), reset when the stage starts
+    GenerationArena m_scratch;
+
+    // Largest surface generated so far; begin() reserves the output buffers from it
+    size_t  m_peak_vertices, m_peak_indices, m_peak_front;
+
+    // Progressive generation state
+    bool    m_trace_addition, m_trace_remove, m_trace_ripping;
+    size_t  m_trace_advance, m_trace_total_advances;
+    const std::atomic<bool>* m_cancel;
+};
+
+#endif
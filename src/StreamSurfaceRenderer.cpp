@@ -4,8 +4,40 @@
 
 #include <GL/glew.h>
 
-StreamSurfaceRenderer::StreamSurfaceRenderer() {
+// STD
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+// Stream Tracer
+#include "Profiler.h"
+
+StreamSurfaceRenderer::StreamSurfaceRenderer()
+    : m_worker(m_streamtracer) {
     buffer_needs_update = true;
+
+    m_buffers[0] = m_buffers[1] = m_buffers[2] = m_buffers[3] = 0;
+    m_bounding_box_buffer = m_seeding_line_buffer = 0;
+    m_nIndices = m_nVertices = m_nSeedingPoints = 0;
+    m_vertex_capacity = m_index_capacity = 0;
+
+    m_compact = false;
+    m_compact_buffers[0] = m_compact_buffers[1] = 0;
+    m_compact_radius = 0.0f;
+    m_compact_bytes = 0;
+    m_displayed_request_id = 0;
+    m_memory_reported = false;
+
+    m_viewport_height = 0;
+    m_max_pixel_error = 1.0f;
+    m_lod_max_error   = 0.0f;
+
+    m_preview_enabled  = true;
+    m_preview_delay    = 0.25;
+    m_last_change_time = 0.0;
+    m_refine_pending   = false;
+    m_addition = m_remove = m_ripping = false;
+    m_refine_request_id = 0;
 }
 
 void StreamSurfaceRenderer::compileShaders() {
@@ -63,25 +95,134 @@ void StreamSurfaceRenderer::compileShaders() {
 }
 
 void StreamSurfaceRenderer::loadOpenFOAM(std::string filename) {
+    m_worker.stop();
+
+    m_memory.clear();
+    m_memory_reported = false;
+
     m_streamtracer.loadOpenFOAM(filename);
+    m_streamtracer.reportMemory(m_memory);
+    m_memory.endPhase("load");
+
     m_streamtracer.computeAccel();
-}
+    m_streamtracer.reportMemory(m_memory);
+    m_memory.endPhase("accel");
 
-void StreamSurfaceRenderer::computeStreamSurface(bool addition, bool remove, bool ripping) {
-    std::cout << "Computing the stream lines...\n";
+    m_streamtracer.getParameters(m_parameters);
+    m_boundingbox_points = m_streamtracer.getAABB();
 
-    m_streamtracer.computeStreamsurfaces(addition, remove, ripping);
+    // Surfaces of a dataset are kept next to its binary cache
+    m_cache.clear();
+    m_cache.setDiskDirectory(filename + ".surfaces");
+    m_worker.setCache(&m_cache, m_streamtracer.getDatasetIdentity());
 
-    std::cout << "Computing the stream lines...Done.\n";
+    m_worker.start();
+    buffer_needs_update = true;
 }
 
 void StreamSurfaceRenderer::update(const double& time, const double& timeSinceLastFrame, bool addition, bool remove, bool ripping) {
+    m_addition = addition;
+    m_remove   = remove;
+    m_ripping  = ripping;
+
     if (buffer_needs_update){
-        m_streamtracer.computeStreamsurfaces(addition, remove, ripping);
-        update_buffers();
+        submitRequest(m_preview_enabled);
+
+        m_last_change_time = time;
+        m_refine_pending = m_preview_enabled;
+        buffer_needs_update = false;
+    }
+    else if (m_refine_pending && time - m_last_change_time >= m_preview_delay){
+        submitRequest(false);
+        m_refine_pending = false;
+    }
+
+    if (m_worker.fetch(m_result)){
+        // Levels of detail arriving after the last slice only concern the surface on screen
+        if (!m_result.restart && m_result.vertices.empty() && m_result.faces.empty() && !m_result.levels.empty()){
+            if (m_result.request_id == m_displayed_request_id){
+                upload_compact(m_result.levels);
+                report_memory(m_result.request_id);
+            }
+            m_result.levels.clear();
+            return;
+        }
+
+        if (m_result.request_id == m_refine_request_id && m_preview_enabled){
+            // Keep showing the preview until the refined surface is complete
+            if (m_result.restart)
+                m_refined = m_result;
+            else
+                m_refined.append(m_result);
+
+            if (!m_refined.finished)
+                return;
+
+            std::swap(m_result, m_refined);
+            m_refined.clear();
+            m_result.restart = true;
+        }
+
+        if (m_result.restart)
+            update_buffers();
+
+        // A surface that arrives complete goes straight to its compact form
+        if (!(m_result.restart && !m_result.levels.empty()))
+            append_buffers();
+
+        if (!m_result.levels.empty()){
+            upload_compact(m_result.levels);
+            m_result.levels.clear();
+            report_memory(m_result.request_id);
+        }
+
+        m_displayed_request_id = m_result.request_id;
     }
 }
 
+void StreamSurfaceRenderer::report_memory(unsigned int request_id) {
+    // Only full-quality surfaces; previews would understate what generation needs
+    if (m_memory_reported || request_id == 0 || request_id != m_refine_request_id)
+        return;
+
+    m_worker.reportMemory(m_memory);
+
+    m_memory.add("renderer/surface", (unsigned long long)(m_result.vertices.capacity() + m_result.derivatives.capacity() + m_result.normals.capacity()) * sizeof(glm::vec3)
+                                   + (unsigned long long)m_result.faces.capacity() * sizeof(unsigned int));
+    m_memory.add("gl/surface buffers", (unsigned long long)(3 * m_vertex_capacity * sizeof(glm::vec3) + m_index_capacity * sizeof(glm::uint32)));
+    m_memory.add("gl/compact buffers", (unsigned long long)(m_compact ? m_compact_bytes : 0));
+    m_memory.add("gl/box and seeds", (unsigned long long)((24 + m_nSeedingPoints) * sizeof(glm::vec3)));
+    m_memory.endPhase("generation");
+
+    m_memory.print(std::cout);
+    m_memory_reported = true;
+}
+
+void StreamSurfaceRenderer::submitRequest(bool preview, const std::string& exportFilename) {
+    SurfaceWorker::Request request;
+    request.parameters = m_parameters;
+    request.addition   = m_addition;
+    request.remove     = m_remove;
+    request.ripping    = m_ripping;
+    request.lodMaxError    = m_lod_max_error;
+    request.exportFilename = exportFilename;
+
+    if (preview){
+        request.parameters.traceMaxSeeds = std::max(2u, m_parameters.traceMaxSeeds / 4);
+        request.parameters.traceStepSize = m_parameters.traceStepSize * 4.0f;
+        request.addition = false;
+    }
+
+    unsigned int id = m_worker.submit(request);
+    m_refine_request_id = preview ? 0 : id;
+    m_refined.clear();
+}
+
+void StreamSurfaceRenderer::exportSurface(const std::string& filename) {
+    submitRequest(false, filename);
+    m_refine_pending = false;
+}
+
 void StreamSurfaceRenderer::setMode(Mode mode) {
     if (m_mode != mode){
         buffer_needs_update = true;
@@ -90,67 +231,47 @@ void StreamSurfaceRenderer::setMode(Mode mode) {
 }
 
 void StreamSurfaceRenderer::update_buffers() {
+    PROFILE_ZONE("update_buffers");
+
     GLsizei nbuffers = sizeof(m_buffers) / sizeof(GLuint);
     if (m_buffers[0] > 0){
         glDeleteBuffers(nbuffers, m_buffers);
+        m_buffers[0] = m_buffers[1] = m_buffers[2] = m_buffers[3] = 0;
+    }
+    if (m_bounding_box_buffer > 0){
         glDeleteBuffers(1, &m_bounding_box_buffer);
         glDeleteBuffers(1, &m_seeding_line_buffer);
     }
+    m_compact = false;
 
     GLenum e = glGetError();
 
-    std::vector<glm::vec3> vertices   = m_streamtracer.getVertices();
-    std::vector<glm::vec3> colors     = m_streamtracer.getDerivatives();
-    std::vector<glm::vec3> normals    = m_streamtracer.getDerivatives();
-
-    std::vector<glm::vec3> seedingPoints = m_streamtracer.getSeedingPoints();
-    std::vector<glm::vec3> boundingboxPoints = m_streamtracer.getAABB();
-
-    std::vector<unsigned int> indices = m_streamtracer.getFaceIndices();
-
+    std::vector<glm::vec3> seedingPoints = m_result.seedingPoints;
+    std::vector<glm::vec3> boundingboxPoints = m_boundingbox_points;
 
-    glm::vec3 center(0.0f, 0.0f, 0.0f);
-    for (size_t v = 0; v < vertices.size(); v++){
-        center += vertices[v];
-    }
-    center /= vertices.size();
-    for (size_t v = 0; v < vertices.size(); v++){
-        vertices[v] -= center;
+    // The surface grows after this point, so it is centred on its seeding curve
+    // instead of on the mean of the (not yet known) final vertices.
+    m_center = glm::vec3(0.0f, 0.0f, 0.0f);
+    for (size_t s = 0; s < seedingPoints.size(); s++){
+        m_center += seedingPoints[s];
     }
+    if (!seedingPoints.empty())
+        m_center /= seedingPoints.size();
+
     for (size_t s = 0; s < seedingPoints.size(); s++){
-        seedingPoints[s] -= center;
+        seedingPoints[s] -= m_center;
     }
     for (size_t b = 0; b < boundingboxPoints.size(); b++){
-        boundingboxPoints[b] -= center;
-    }
-    for (size_t c = 0; c < colors.size(); c++){
-        colors[c] = glm::normalize(colors[c]) * 0.5f + glm::vec3(0.5f, 0.5f, 0.5f);
+        boundingboxPoints[b] -= m_center;
     }
 
-    m_nIndices = indices.size();
+    m_nIndices = 0;
+    m_nVertices = 0;
     m_nSeedingPoints = seedingPoints.size();
+    m_vertex_capacity = m_index_capacity = 0;
 
-    glGenBuffers(4, m_buffers);
-    e = glGetError();
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_buffers[0]);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    e = glGetError();
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_buffers[1]);
-    glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(glm::vec3), &colors[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    e = glGetError();
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[2]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(glm::uint32), &indices[0], GL_STATIC_DRAW);
-    e = glGetError();
-
-    glBindBuffer(GL_ARRAY_BUFFER, m_buffers[3]);
-    glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    e = glGetError();
+    // With no capacity left, this creates all four buffers
+    reserve_buffers(1 << 16, 1 << 18);
 
     glGenBuffers(1, &m_bounding_box_buffer);
     glBindBuffer(GL_ARRAY_BUFFER, m_bounding_box_buffer);
@@ -159,10 +280,219 @@ void StreamSurfaceRenderer::update_buffers() {
 
     glGenBuffers(1, &m_seeding_line_buffer);
     glBindBuffer(GL_ARRAY_BUFFER, m_seeding_line_buffer);
-    glBufferData(GL_ARRAY_BUFFER, seedingPoints.size() * sizeof(glm::vec3), &seedingPoints[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, seedingPoints.size() * sizeof(glm::vec3), seedingPoints.empty() ? NULL : &seedingPoints[0], GL_STATIC_DRAW);
+    e = glGetError();
+}
+
+void StreamSurfaceRenderer::reserve_buffers(size_t nVertices, size_t nIndices) {
+    // Grow each buffer geometrically and carry over what was uploaded so far
+    if (nVertices > m_vertex_capacity){
+        size_t capacity = std::max(nVertices, 2 * m_vertex_capacity);
+
+        for (int b = 0; b < 4; b++){
+            if (b == 2)
+                continue;
+
+            GLuint buffer;
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(glm::vec3), NULL, GL_DYNAMIC_DRAW);
+
+            if (m_nVertices > 0){
+                glBindBuffer(GL_COPY_READ_BUFFER, m_buffers[b]);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_nVertices * sizeof(glm::vec3));
+            }
+
+            glDeleteBuffers(1, &m_buffers[b]);
+            m_buffers[b] = buffer;
+        }
+
+        m_vertex_capacity = capacity;
+    }
+
+    if (nIndices > m_index_capacity){
+        size_t capacity = std::max(nIndices, 2 * m_index_capacity);
+
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * sizeof(glm::uint32), NULL, GL_DYNAMIC_DRAW);
+
+        if (m_nIndices > 0){
+            glBindBuffer(GL_COPY_READ_BUFFER, m_buffers[2]);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_nIndices * sizeof(glm::uint32));
+        }
+
+        glDeleteBuffers(1, &m_buffers[2]);
+        m_buffers[2] = buffer;
+
+        m_index_capacity = capacity;
+    }
+}
+
+namespace
+{
+    struct Recentre
+    {
+        glm::vec3 center;
+        glm::vec3 operator()(const glm::vec3& vertex) const { return vertex - center; }
+    };
+
+    struct VelocityColor
+    {
+        glm::vec3 operator()(const glm::vec3& derivative) const { return glm::normalize(derivative) * 0.5f + glm::vec3(0.5f, 0.5f, 0.5f); }
+    };
+
+    // Transform values straight into a mapped range of the bound array buffer, so the
+    // result is neither modified in place nor staged in a temporary copy
+    template<typename Transform>
+    void writeTransformed(GLintptr offset, const std::vector<glm::vec3>& values, Transform transform)
+    {
+        GLsizeiptr size = values.size() * sizeof(glm::vec3);
+
+        glm::vec3* mapped = (glm::vec3*)glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (mapped){
+            std::transform(values.begin(), values.end(), mapped, transform);
+            if (glUnmapBuffer(GL_ARRAY_BUFFER))
+                return;
+        }
+
+        // Mapping failed or the buffer contents were lost
+        std::vector<glm::vec3> transformed(values.size());
+        std::transform(values.begin(), values.end(), transformed.begin(), transform);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, size, &transformed[0]);
+    }
+}
+
+void StreamSurfaceRenderer::append_buffers() {
+    PROFILE_ZONE("append_buffers");
+
+    GLenum e = glGetError();
+
+    const std::vector<glm::vec3>& vertices = m_result.vertices;
+    const std::vector<glm::vec3>& colors   = m_result.derivatives;
+    const std::vector<glm::vec3>& normals  = m_result.normals;
+
+    const std::vector<unsigned int>& indices = m_result.faces;
+
+    size_t nVertices = m_nVertices + vertices.size();
+    size_t nIndices  = m_nIndices + indices.size();
+    if (nVertices == m_nVertices && nIndices == m_nIndices && normals.empty())
+        return;
+
+    reserve_buffers(nVertices, nIndices);
+
+    if (!vertices.empty()){
+        GLintptr offset = m_nVertices * sizeof(glm::vec3);
+
+        Recentre recentre = { m_center };
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffers[0]);
+        writeTransformed(offset, vertices, recentre);
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffers[1]);
+        writeTransformed(offset, colors, VelocityColor());
+        e = glGetError();
+    }
+
+    // Normals of earlier vertices change as triangles attach to them, so they are uploaded by range
+    if (!normals.empty()){
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffers[3]);
+        glBufferSubData(GL_ARRAY_BUFFER, m_result.normalsFirst * sizeof(glm::vec3), normals.size() * sizeof(glm::vec3), &normals[0]);
+        e = glGetError();
+    }
+
+    if (!indices.empty()){
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[2]);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, m_nIndices * sizeof(glm::uint32), indices.size() * sizeof(glm::uint32), &indices[0]);
+        e = glGetError();
+    }
+
+    m_nVertices = nVertices;
+    m_nIndices  = nIndices;
+}
+
+void StreamSurfaceRenderer::upload_compact(const std::vector<SurfaceWorker::Result::Level>& levels) {
+    PROFILE_ZONE("upload_compact");
+
+    GLenum e = glGetError();
+
+    // The float buffers only served the growing surface
+    GLsizei nbuffers = sizeof(m_buffers) / sizeof(GLuint);
+    glDeleteBuffers(nbuffers, m_buffers);
+    m_buffers[0] = m_buffers[1] = m_buffers[2] = m_buffers[3] = 0;
+    m_nVertices = m_nIndices = 0;
+    m_vertex_capacity = m_index_capacity = 0;
+
+    size_t nVertices = 0, nIndices = 0;
+    for (size_t l = 0; l < levels.size(); l++){
+        nVertices += levels[l].mesh->vertices.size();
+        nIndices  += levels[l].mesh->indices.size();
+    }
+
+    if (m_compact_buffers[0] == 0)
+        glGenBuffers(2, m_compact_buffers);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_compact_buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, nVertices * sizeof(CompactVertex), NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_compact_buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, nIndices * sizeof(glm::uint16), NULL, GL_STATIC_DRAW);
+    m_compact_bytes = nVertices * sizeof(CompactVertex) + nIndices * sizeof(glm::uint16);
+
+    m_compact_levels.assign(levels.size(), CompactLevel());
+
+    size_t vertexBase = 0, indexBase = 0;
+    for (size_t l = 0; l < levels.size(); l++){
+        const CompactMesh& mesh = *levels[l].mesh;
+
+        if (!mesh.vertices.empty())
+            glBufferSubData(GL_ARRAY_BUFFER, vertexBase * sizeof(CompactVertex), mesh.vertices.size() * sizeof(CompactVertex), &mesh.vertices[0]);
+        if (!mesh.indices.empty())
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexBase * sizeof(glm::uint16), mesh.indices.size() * sizeof(glm::uint16), &mesh.indices[0]);
+
+        CompactLevel& level = m_compact_levels[l];
+        level.chunks = mesh.chunks;
+        for (size_t c = 0; c < level.chunks.size(); c++){
+            level.chunks[c].firstVertex += vertexBase;
+            level.chunks[c].firstIndex  += indexBase;
+        }
+        level.offset = mesh.boundsMin - m_center;
+        level.scale  = mesh.boundsExtent;
+        level.error  = levels[l].error;
+
+        vertexBase += mesh.vertices.size();
+        indexBase  += mesh.indices.size();
+    }
     e = glGetError();
 
-    buffer_needs_update = false;
+    // Bounding sphere of the full surface, for the screen-space error
+    const CompactMesh& full = *levels[0].mesh;
+    m_compact_center = full.boundsMin + full.boundsExtent * 0.5f - m_center;
+    m_compact_radius = glm::length(full.boundsExtent) * 0.5f;
+    m_compact = true;
+}
+
+void StreamSurfaceRenderer::setView(const glm::mat4& modelview, const glm::mat4& projection, int viewportHeight) {
+    m_modelview = modelview;
+    m_projection = projection;
+    m_viewport_height = viewportHeight;
+}
+
+size_t StreamSurfaceRenderer::select_level() const {
+    if (m_compact_levels.size() < 2 || m_viewport_height <= 0)
+        return 0;
+
+    // Pixels per surface unit at the point of the bounding sphere closest to the camera
+    glm::vec4 center = m_modelview * glm::vec4(m_compact_center, 1.0f);
+    float scale = glm::length(glm::vec3(m_modelview[0].x, m_modelview[0].y, m_modelview[0].z));
+    float distance = -center.z - m_compact_radius * scale;
+    if (distance <= 0.0f)
+        return 0;
+
+    float pixelsPerUnit = m_projection[1][1] * 0.5f * m_viewport_height * scale / distance;
+
+    size_t level = 0;
+    while (level + 1 < m_compact_levels.size() && m_compact_levels[level + 1].error * pixelsPerUnit <= m_max_pixel_error)
+        level++;
+    return level;
 }
 
 void StreamSurfaceRenderer::draw() {
@@ -175,6 +505,39 @@ void StreamSurfaceRenderer::draw() {
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
     e = glGetError();
+
+    GLenum primitive = (m_mode == Mode::STREAM_LINES) ? GL_LINES : GL_TRIANGLES;
+
+    if (m_compact){
+        const CompactLevel& level = m_compact_levels[select_level()];
+
+        glUniform3fv(5, 1, (float*)&level.offset);
+        glUniform3fv(6, 1, (float*)&level.scale);
+        glUniform1i(7, 1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_compact_buffers[0]);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, position));
+        glVertexAttribPointer(1, 3, GL_UNSIGNED_BYTE,  GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, color));
+        glVertexAttribPointer(2, 2, GL_SHORT,          GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, normal));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_compact_buffers[1]);
+
+        for (size_t c = 0; c < level.chunks.size(); c++){
+            const CompactMesh::Chunk& chunk = level.chunks[c];
+            glDrawElementsBaseVertex(primitive, (GLsizei)chunk.indexCount, GL_UNSIGNED_SHORT,
+                                     (void*)(chunk.firstIndex * sizeof(glm::uint16)), (GLint)chunk.firstVertex);
+        }
+
+        glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(1);
+        glDisableVertexAttribArray(2);
+        return;
+    }
+
+    glm::vec3 offset(0.0f, 0.0f, 0.0f), scale(1.0f, 1.0f, 1.0f);
+    glUniform3fv(5, 1, (float*)&offset);
+    glUniform3fv(6, 1, (float*)&scale);
+    glUniform1i(7, 0);
+
     glBindBuffer(GL_ARRAY_BUFFER, m_buffers[0]);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
     e = glGetError();
@@ -187,10 +550,7 @@ void StreamSurfaceRenderer::draw() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[2]);
     e = glGetError();
 
-    if (m_mode == Mode::STREAM_SURFACE)
-        glDrawElements(GL_TRIANGLES, m_nIndices, GL_UNSIGNED_INT, 0);
-    else if (m_mode == Mode::STREAM_LINES)
-        glDrawElements(GL_LINES, m_nIndices, GL_UNSIGNED_INT, 0);
+    glDrawElements(primitive, m_nIndices, GL_UNSIGNED_INT, 0);
 
     e = glGetError();
     glDisableVertexAttribArray(0);
@@ -230,8 +590,7 @@ void StreamSurfaceRenderer::draw_2d(){
 }
 
 void StreamSurfaceRenderer::getParameters(unsigned int& maxseeds, unsigned int& maxsteps, float& stepsize, float center[3], float dir[3]) {
-    StreamTracer::SurfaceParameters params;
-    m_streamtracer.getParameters(params);
+    const StreamTracer::SurfaceParameters& params = m_parameters;
 
     maxseeds = params.traceMaxSeeds;
     maxsteps = params.traceMaxSteps;
@@ -243,8 +602,7 @@ void StreamSurfaceRenderer::getParameters(unsigned int& maxseeds, unsigned int&
 }
 
 void StreamSurfaceRenderer::setParameters(const unsigned int& maxseeds, const unsigned int& maxsteps, const float& stepsize, const float center[3], const float dir[3]) {
-    StreamTracer::SurfaceParameters params;
-    StreamTracer::SurfaceParameters last_params;
+    StreamTracer::SurfaceParameters params = m_parameters;
 
     params.traceDirection = StreamTracer::SurfaceParameters::TraceDirection::TD_BOTH;
     params.traceMaxSeeds = maxseeds;
@@ -253,16 +611,36 @@ void StreamSurfaceRenderer::setParameters(const unsigned int& maxseeds, const un
     params.seedingLineCenter    = glm::vec3(center[0], center[1], center[2]);
     params.seedingLineDirection = glm::vec3(dir[0], dir[1], dir[2]);
 
-    m_streamtracer.getParameters(last_params);
+    if (!(m_parameters == params)){
+        m_parameters = params;
+        buffer_needs_update = true;
+    }
+}
+
+void StreamSurfaceRenderer::setSeedCurve(StreamTracer::SurfaceParameters::SeedCurveType type, const float& extent, bool adaptive) {
+    StreamTracer::SurfaceParameters params = m_parameters;
+
+    params.seedCurveType     = type;
+    params.seedingLineLength = extent;
+    params.adaptiveSeeding   = adaptive;
+
+    if (!(m_parameters == params)){
+        m_parameters = params;
+        buffer_needs_update = true;
+    }
+}
 
-    if (!(last_params == params)){
-        m_streamtracer.setParameters(params);
+void StreamSurfaceRenderer::setLodMaxError(float maxError) {
+    if (m_lod_max_error != maxError){
+        m_lod_max_error = maxError;
         buffer_needs_update = true;
     }
 }
 
 void StreamSurfaceRenderer::shutdown() {
-    glDeleteBuffers(3, m_buffers);
+    m_worker.stop();
+    glDeleteBuffers(4, m_buffers);
+    glDeleteBuffers(2, m_compact_buffers);
 }
 
 StreamSurfaceRenderer::~StreamSurfaceRenderer() {
@@ -21,7 +21,10 @@
 #include <GL/glew.h>
 
 // Stream Tracer
+#include "CompactMesh.h"
+#include "MemoryReport.h"
 #include "StreamTracer.h"
+#include "SurfaceWorker.h"
 
 // Camera
 #include "Camera.h"
@@ -32,7 +35,6 @@ public:
     StreamSurfaceRenderer();
 
     void loadOpenFOAM(std::string filename);
-    void computeStreamSurface(bool addition, bool remove, bool ripping);
 
     void compileShaders();
     void update(const double& time, const double& timeSinceLastFrame, bool addition, bool remove, bool ripping);
@@ -45,14 +47,55 @@ public:
     void setMode(Mode);
     void getParameters(unsigned int& maxseeds, unsigned int& maxsteps, float& stepsize, float center[3], float dir[3]);
     void setParameters(const unsigned int& maxseeds, const unsigned int& maxsteps, const float& stepsize, const float center[3], const float dir[3]);
+    void setSeedCurve(StreamTracer::SurfaceParameters::SeedCurveType type, const float& extent, bool adaptive);
 
     void setAsDirty() { buffer_needs_update = true; }
 
+    /// While parameters change, trace a cheap preview (fewer seeds, larger steps, no
+    /// addition) and refine it in the background once they have been stable for a while.
+    void setPreviewEnabled(bool enabled) { m_preview_enabled = enabled; }
+
+    /// The view the surface is drawn with, to pick a level of detail whose estimated
+    /// error stays below maxPixelError pixels on screen.
+    void setView(const glm::mat4& modelview, const glm::mat4& projection, int viewportHeight);
+    void setMaxPixelError(float maxPixelError) { m_max_pixel_error = maxPixelError; }
+
+    /// Largest estimated error of the levels built for a surface, in surface coordinates
+    /// (0: no limit). A change submits the surface again; the cache serves it with new levels.
+    void setLodMaxError(float maxError);
+
+    /// Trace the current surface at full quality and write it to filename (.ply, .vtu or .obj) on the way.
+    void exportSurface(const std::string& filename);
+
     virtual ~StreamSurfaceRenderer();
 
 private:
     StreamTracer m_streamtracer;
+    SurfaceCache m_cache;
+    SurfaceWorker m_worker;
+
+    // Render-thread copies; the tracer itself belongs to the worker once it runs
+    StreamTracer::SurfaceParameters m_parameters;
+    std::vector<glm::vec3> m_boundingbox_points;
+    SurfaceWorker::Result m_result;
+
+    // Coarse preview, then refine
+    bool   m_preview_enabled;
+    double m_preview_delay;
+    double m_last_change_time;
+    bool   m_refine_pending;
+    bool   m_addition, m_remove, m_ripping;
+    unsigned int m_refine_request_id;
+    SurfaceWorker::Result m_refined;     // full-quality surface, swapped in once complete
+
+    void submitRequest(bool preview, const std::string& exportFilename = "");
+
     void update_buffers();
+    void append_buffers();
+    void reserve_buffers(size_t nVertices, size_t nIndices);
+    void upload_compact(const std::vector<SurfaceWorker::Result::Level>& levels);
+    size_t select_level() const;
+    void report_memory(unsigned int request_id);
 
     bool buffer_needs_update;
     Mode m_mode;
@@ -60,8 +103,41 @@ private:
     GLuint m_buffers[4];    // vertexbuffer, m_colorbuffer, m_indicesbuffer, m_normalbuffer
     size_t m_nIndices;
 
+    // Progressive generation: the worker hands over the surface in slices and
+    // each slice is appended to the GPU buffers, which grow geometrically.
+    size_t m_nVertices;
+    size_t m_vertex_capacity, m_index_capacity;
+    glm::vec3 m_center;
+
+    // A finished surface replaces the float buffers by its compact form: one interleaved
+    // 16 byte vertex stream and 16 bit indices, drawn chunk by chunk with a base vertex.
+    // All levels of detail share the two buffers, one after the other.
+    struct CompactLevel
+    {
+        std::vector<CompactMesh::Chunk> chunks;     // offsets into the shared buffers
+        glm::vec3 offset, scale;
+        float error;
+    };
+
+    bool m_compact;
+    GLuint m_compact_buffers[2];    // interleaved vertices, indices
+    std::vector<CompactLevel> m_compact_levels;
+    glm::vec3 m_compact_center;
+    float m_compact_radius;
+    unsigned int m_displayed_request_id;
+
+    glm::mat4 m_modelview, m_projection;
+    int m_viewport_height;
+    float m_max_pixel_error;
+    float m_lod_max_error;
+
     GLuint m_bounding_box_buffer, m_seeding_line_buffer;
     size_t m_nSeedingPoints;
+
+    // Where memory goes after load, accel build and the first full-quality surface of a dataset
+    MemoryReport m_memory;
+    bool   m_memory_reported;
+    size_t m_compact_bytes;
 };
 
 #endif
\ No newline at end of file
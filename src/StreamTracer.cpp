@@ -1,15 +1,16 @@
 #include "StreamTracer.h"
 
 // STD
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 
 // Boost
 #include <boost/filesystem.hpp>
-#include <boost/random/mersenne_twister.hpp>
-#include <boost/random/uniform_real_distribution.hpp>
 
 // OpenMP
 #include <omp.h>
@@ -24,25 +25,77 @@
 #include <vtkDataSetMapper.h>
 #include <vtkOpenFOAMReader.h>
 #include <vtkMultiBlockDataSet.h>
+#include <vtkDoubleArray.h>
 #include <vtkIdList.h>
 
 // RPE
 #include "AABB.h"
+#include "BinaryIO.h"
 #include "Grid.h"
+#include "MemoryReport.h"
+#include "MeshWriter.h"
+#include "PathSurface.h"
+#include "Profiler.h"
+#include "StreamSurface.h"
+#include "TracerStats.h"
 
 // #define STREAM_TRACER_USE_CELL_LIST // Test all primitives in an acceleration cell
 #define STREAM_TRACER_USE_OMP       // Use OpenMP multi-threading
 
-StreamTracer::StreamTracer()
+namespace
+{
+    // Slices of tracing between two writes of a streamed export
+    const double EXPORT_SLICE_MILLISECONDS = 100.0;
+
+    // Open a writer for the format of the file name
+    bool openExport(const std::string& filename, MeshWriter& writer)
+    {
+        MeshWriter::Format format;
+        if (!MeshWriter::formatFromFilename(filename, format)){
+            std::cout << "Unknown export format: " << filename << std::endl;
+            return false;
+        }
+        return writer.open(filename, format);
+    }
+
+    // Write the part of a surface that was added since the last write
+    template <class Surface>
+    void writeAdded(MeshWriter& writer, const Surface& surface)
+    {
+        size_t vertices = writer.getVertexCount(), indices = writer.getFaceCount() * 3;
+        writer.write(ArrayView<glm::vec3>(surface.getVertices()).sub(vertices),
+                     ArrayView<glm::vec3>(surface.getDerivatives()).sub(vertices),
+                     ArrayView<unsigned int>(surface.getFaceIndices()).sub(indices));
+    }
+}
+
+StreamTracer::SurfaceParameters::SurfaceParameters()
 {
     // Default surface tracing parameters
-    m_surface_parameters.traceDirection = SurfaceParameters::TD_BOTH;
-    m_surface_parameters.traceStepSize  = 0.001f;
-    m_surface_parameters.traceMaxSteps  = 1000;
-    m_surface_parameters.traceMaxSeeds  = 100;
+    traceDirection = TD_BOTH;
+    traceStepSize  = 0.001f;
+    traceMaxSteps  = 1000;
+    traceMaxSeeds  = 100;
+
+    seedCurveType     = SC_LINE;
+    seedingLineLength = 0.4f;
+    adaptiveSeeding   = false;
 
-    m_surface_parameters.seedingLineCenter = glm::vec3(0.0f, 0.0f, 0.0f);
-    m_surface_parameters.seedingLineDirection = glm::vec3(0.0f, 0.0f, 1.0f); 
+    seedingLineCenter    = glm::vec3(0.0f, 0.0f, 0.0f);
+    seedingLineDirection = glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+StreamTracer::StreamTracer()
+{
+
+    m_geometry.reset(new MeshGeometry);
+    m_surface.reset(new StreamSurface(*this));
+
+    m_cancel = NULL;
+    m_writer = NULL;
+    m_written_vertices = m_written_indices = 0;
+
+    m_out_of_core_bytes = 0;
 }
 
 StreamTracer::~StreamTracer()
@@ -51,20 +104,47 @@ StreamTracer::~StreamTracer()
 
 void StreamTracer::loadOpenFOAM(std::string filename)
 {
-    // Load binary, if available
+    loadOpenFOAM(filename, AABB());
+}
+
+void StreamTracer::loadOpenFOAM(std::string filename, const AABB& regionOfInterest)
+{
+    PROFILE_ZONE("loadOpenFOAM");
+
+    // Steps of the previous dataset still being loaded (e.g. prefetched) read the file name, the
+    // field and the reader; clearing the time series waits for them before any of these change
+    m_timeSeries.clear();
+
+    // Load bricks or binary, if available
     m_filename = filename;
-    if (loadBinary(filename + ".bin"))
+    m_region = regionOfInterest;
+    m_bricks.close();
+    if (m_out_of_core_bytes > 0 && openBricks())
         return;
 
+    if (loadBinary(filename + ".bin", m_region)){
+        loadTimeSeries();
+        return;
+    }
+
     std::cout << "loadOpenFOAM: loading " << filename << std::endl;
 
     // Read the file
     m_reader = vtkSmartPointer<vtkOpenFOAMReader>::New();
     m_reader->SetFileName(filename.c_str());
     m_reader->Update();
-    //m_reader->SetTimeValue(0.5);
-    m_reader->SetTimeValue(2700);
-    //m_reader->SetTimeValue(8000.5);
+
+    // The steady field is the last time step; unsteady cases keep the list for the time series
+    std::vector<double> times;
+    vtkDoubleArray *timeValues = m_reader->GetTimeValues();
+    for (vtkIdType i=0; timeValues && i<timeValues->GetNumberOfTuples(); i++)
+        times.push_back(timeValues->GetValue(i));
+
+    if (!times.empty())
+        m_reader->SetTimeValue(times.back());
+    if (times.size() > 1)
+        FieldTimeSeries::saveTimes(FieldTimeSeries::timesPath(filename), times);
+
     m_reader->ReadZonesOn();
     m_reader->Update();
 
@@ -83,6 +163,8 @@ void StreamTracer::loadOpenFOAM(std::string filename)
            << "  number of tuples: U: " << numTuples << " (components: " << dataArray->GetNumberOfComponents() << ")" << std::endl;
 
     // Construct cell boxes
+    std::vector<AABB> cellBoxes;
+    std::vector<glm::vec3> cellPoints;
     for (vtkIdType i=0; i<numCells; i++)
     {
         vtkSmartPointer<vtkIdList> cellPointIds = vtkSmartPointer<vtkIdList>::New();
@@ -95,7 +177,7 @@ void StreamTracer::loadOpenFOAM(std::string filename)
             block0->GetPoint(cellPointIds->GetId(j), point);
             box.extend((float)point[0], (float)point[1], (float)point[2]);
         }
-        m_cellBoxes.push_back(box);
+        cellBoxes.push_back(box);
     }
 
     // Import point data
@@ -103,10 +185,13 @@ void StreamTracer::loadOpenFOAM(std::string filename)
     {
         double point[3];
         block0->GetPoint(i, point);
-        m_cellPoints.push_back(glm::vec3((float)point[0], (float)point[1], (float)point[2]));
+        cellPoints.push_back(glm::vec3((float)point[0], (float)point[1], (float)point[2]));
     }
 
+    m_geometry = MeshGeometry::share(cellBoxes, cellPoints);
+
     // Import cell data
+    m_cellVectors.clear();
     for (vtkIdType i=0; i<numTuples; i++)
     {
         double tuple[3];
@@ -115,247 +200,502 @@ void StreamTracer::loadOpenFOAM(std::string filename)
     }
 
     saveBinary(filename + ".bin");
+
+    // A case too large for memory is still read whole once to write the binary cache
+    if (m_out_of_core_bytes > 0 && openBricks())
+        return;
+
+    if (m_region.valid() && loadBinary(filename + ".bin", m_region)){
+        m_reader = vtkSmartPointer<vtkOpenFOAMReader>();
+        m_timeSeries.clear();
+        return;
+    }
+
+    loadTimeSeries();
+}
+
+void StreamTracer::setOutOfCore(size_t maxResidentBytes)
+{
+    m_out_of_core_bytes = maxResidentBytes;
+    if (maxResidentBytes > 0)
+        m_bricks.setMaxResidentBytes(maxResidentBytes);
+}
+
+bool StreamTracer::updateBricks(const std::string& binaryPath, const std::string& bricksPath)
+{
+    boost::system::error_code binaryError, bricksError;
+    std::time_t binaryModified = boost::filesystem::last_write_time(binaryPath, binaryError);
+    std::time_t bricksModified = boost::filesystem::last_write_time(bricksPath, bricksError);
+    if (binaryError)
+        return false;
+
+    if (!bricksError && bricksModified >= binaryModified)
+        return true;
+
+    return BrickedField::build(binaryPath, bricksPath);
+}
+
+bool StreamTracer::openBricks()
+{
+    std::string bricks = BrickedField::bricksPath(m_filename);
+    if (!updateBricks(m_filename + ".bin", bricks) || !m_bricks.open(bricks))
+        return false;
+
+    // Only the index stays in memory; the steady field is the one stored in the bricks
+    m_geometry.reset(new MeshGeometry);
+    std::vector<glm::vec3>().swap(m_cellVectors);
+    m_reader = vtkSmartPointer<vtkOpenFOAMReader>();
+    m_timeSeries.clear();
+    return true;
+}
+
+void StreamTracer::loadTimeSeries()
+{
+    // The time steps hold all cells, the cells of a region are a subset
+    if (m_region.valid()){
+        m_timeSeries.clear();
+        return;
+    }
+
+    std::vector<double> times;
+    if (!FieldTimeSeries::loadTimes(FieldTimeSeries::timesPath(m_filename), times) || times.size() < 2){
+        m_timeSeries.clear();
+        return;
+    }
+
+    std::cout << "loadTimeSeries: " << times.size() << " time steps from " << times.front() << " to " << times.back() << std::endl;
+    m_timeSeries.reset(times, [this](size_t step, FieldTimeSeries::Velocities& velocities){
+        return loadTimeStep(step, velocities);
+    });
+}
+
+bool StreamTracer::loadTimeStep(size_t step, FieldTimeSeries::Velocities& velocities)
+{
+    // Steps read from the case before are cached next to the binary
+    std::string path = FieldTimeSeries::stepPath(m_filename, step);
+    if (FieldTimeSeries::loadVelocities(path, velocities) && velocities.size() == m_cellVectors.size())
+        return true;
+
+    PROFILE_ZONE("loadTimeStep");
+    std::cout << "loadTimeStep: reading time " << m_timeSeries.getTimes()[step] << " of " << m_filename << std::endl;
+
+    if (!m_reader){
+        m_reader = vtkSmartPointer<vtkOpenFOAMReader>::New();
+        m_reader->SetFileName(m_filename.c_str());
+        m_reader->ReadZonesOn();
+    }
+    m_reader->SetTimeValue(m_timeSeries.getTimes()[step]);
+    m_reader->Update();
+
+    vtkMultiBlockDataSet *output = m_reader->GetOutput();
+    vtkDataSet   *block0    = output ? vtkDataSet::SafeDownCast(output->GetBlock(0)) : NULL;
+    vtkDataArray *dataArray = block0 ? block0->GetCellData()->GetVectors("U") : NULL;
+    if (!dataArray || dataArray->GetNumberOfTuples() != (vtkIdType)m_cellVectors.size())
+        return false;
+
+    velocities.resize(m_cellVectors.size());
+    for (vtkIdType i=0; i<dataArray->GetNumberOfTuples(); i++)
+    {
+        double tuple[3];
+        dataArray->GetTuple(i, tuple);
+        velocities[i] = glm::vec3((float)tuple[0], (float)tuple[1], (float)tuple[2]);
+    }
+
+    FieldTimeSeries::saveVelocities(path, velocities);
+    return true;
 }
 
 void StreamTracer::computeAccel()
 {
+    PROFILE_ZONE("computeAccel");
+
     std::cout << "Computing Acceleration Structure...";
-    for (size_t i=0; i<m_cellBoxes.size(); i++)
-        m_sceneBox.extend(m_cellBoxes[i]);
 
-    // Enlarge grid box to avoid primitives on boundaries
-    const float EPSILON = 0.0001f;
-    AABB accelBox = m_sceneBox;
-    accelBox.enlarge(EPSILON);
+    // The only user of a geometry builds its grid again; a shared one keeps the first
+    if (m_geometry.use_count() == 1)
+        m_geometry->clearAccel();
 
     // Use optimized parameters for known scenes
+    float granularity = 1000;
+    size_t xDim = 0, yDim = 0, zDim = 0;
     if (boost::filesystem::path(m_filename).filename() == "othmer.foam")
     {
-        m_sceneAccel.reset(accelBox, 1000);
         m_surface_parameters.traceMaxSteps = 1000;
         m_surface_parameters.traceStepSize = 0.01f;
     }
     else if (boost::filesystem::path(m_filename).filename() == "Numeca_StuetzLaufSaug_Q82_Lauf0.cgns")
     {
-        m_sceneAccel.reset(accelBox, 50, 100, 100);
+        xDim = 50; yDim = 100; zDim = 100;
         m_surface_parameters.traceMaxSteps = 1000;
         m_surface_parameters.traceStepSize = 0.0001f;
     }
     //this should be adapted later. currently, we only have one cgns file that is to large to be loaded with the default parameters (leads to crash)
+    //such files can be traced out of core instead (setOutOfCore), where every brick has a grid of its own
     else if (boost::filesystem::path(m_filename).extension() == ".cgns")
     {
-        m_sceneAccel.reset(accelBox, 50, 100, 100);
+        xDim = 50; yDim = 100; zDim = 100;
         m_surface_parameters.traceMaxSteps = 1000;
         m_surface_parameters.traceStepSize = 0.0001f;
     }
-    else
-    {
-        m_sceneAccel.reset(accelBox);
-    }
 
-    m_sceneAccel.insertPrimitiveList(m_cellBoxes);
+    // Out of core, the bricks build their grids when they are read
+    bool built = !isOutOfCore() && m_geometry->buildAccel(granularity, xDim, yDim, zDim);
 
+    const AABB& sceneBox = getSceneBox();
     glm::vec3 center = 0.5f * ( 
-        glm::vec3(m_sceneBox.min[0], m_sceneBox.min[1], m_sceneBox.min[2]) + 
-        glm::vec3(m_sceneBox.max[0], m_sceneBox.max[1], m_sceneBox.max[2]) );
+        glm::vec3(sceneBox.min[0], sceneBox.min[1], sceneBox.min[2]) + 
+        glm::vec3(sceneBox.max[0], sceneBox.max[1], sceneBox.max[2]) );
     m_surface_parameters.seedingLineCenter = center;
 
-    std::cout << "Done\n";
+    std::cout << (isOutOfCore() ? "Bricks\n" : built ? "Done\n" : "Shared\n");
+
+    // Other tracers may be reading the shared grid, so it is kept as it is
+    if (!isOutOfCore() && !built && !m_geometry->accelBuiltWith(granularity, xDim, yDim, zDim))
+        std::cout << "computeAccel: " << m_filename << " keeps the shared grid of its mesh, built with other dimensions" << std::endl;
 }
 
-bool StreamTracer::traceRibbon(const unsigned int& ribbon_id, bool addition, bool remove, bool ripping) {
-    
-    if (ribbon_id >= (m_advancing_front.size() / 2) - 1)
+bool StreamTracer::findCell(const glm::vec3& point, unsigned int& cell) const
+{
+    TracerStats::Local& stats = TracerStats::local();
+    stats.add(TracerStats::DERIVATE_CALLS);
+
+    size_t i, j, k;
+    if (!seedIsValid(point, i, j, k)){
+        stats.add(TracerStats::DERIVATE_OUTSIDE);
         return false;
+    }
 
-    bool caught_up = false;
-    float prev_diagonal = 0.0f;
-    while (true){
+    const std::vector<Grid::PrimitiveIndex> &primitives = m_geometry->getSceneAccel().getPrimitives(i, j, k);
+    cell = primitives[0];
 
-        unsigned int L0 = m_advancing_front[2 * ribbon_id];
-        unsigned int R0 = m_advancing_front[2 * ribbon_id + 1];
+    // Candidates a cell list test would have to check; the lookup itself takes the first
+    stats.sample(TracerStats::CANDIDATES, primitives.size());
+    stats.maximum(TracerStats::MAX_CANDIDATES, primitives.size());
 
-        glm::vec3 d_l = derivate(m_vertices[L0]);
-        if (glm::length(d_l) < 1e-14f){
-            break;
-        }
+//    std::vector<Grid::PrimitiveIndex> &primitives = m_sceneAccel.getPrimitives(i, j, k);
+//    size_t t = 0;
+//
+//#ifdef STREAM_TRACER_USE_CELL_LIST
+//    for (; t<primitives.size(); t++)
+//        if (m_cellBoxes[primitives[t]].contains((float*)(&s0)))
+//            break;
+//    if (t == primitives.size())
+//        break;
+//#endif
 
-        glm::vec3 d_r = derivate(m_vertices[R0]);
-        if (glm::length(d_r) < 1e-14f){
-            break;
-        }
+    return true;
+}
 
-        // Ripping
-        if (ripping && glm::dot(glm::normalize(d_l), glm::normalize(d_r)) < 0.8f){
-            return false;
-        }
+glm::vec3 StreamTracer::derivate(const glm::vec3& point) const
+{
+    if (isOutOfCore()){
+        TracerStats::Local& stats = TracerStats::local();
+        stats.add(TracerStats::DERIVATE_CALLS);
+
+        glm::vec3 velocity;
+        if (!outsideRegion(point) && m_bricks.sample(point, velocity))
+            return velocity;
+
+        stats.add(TracerStats::DERIVATE_OUTSIDE);
+        return glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+
+    unsigned int cell;
+    if (!findCell(point, cell))
+        return glm::vec3(0.0f, 0.0f, 0.0f);
+
+    return m_cellVectors[cell];
+}
 
-        glm::vec3 p_l = m_vertices[L0] + d_l * m_surface_parameters.traceStepSize;
-        glm::vec3 p_r = m_vertices[R0] + d_r * m_surface_parameters.traceStepSize;
-
-        if (p_l == m_vertices[L0])
-            break;
-
-        if (p_r == m_vertices[R0])
-            break;
-
-        if (addition){
-            // Addition
-            //glm::float32 maxW = glm::max(glm::length(m_vertices[L1] - m_vertices[R1]), glm::length(m_vertices[L0] - m_vertices[R0]));
-            //glm::float32 minH = glm::min(glm::length(m_vertices[L0] - m_vertices[L1]), glm::length(m_vertices[R1] - m_vertices[R0]));
-            glm::float32 maxW = glm::length(p_l - p_r) + glm::length(m_vertices[L0] - m_vertices[R0]);
-            glm::float32 minH = glm::length(m_vertices[L0] - p_l) + glm::length(p_r - m_vertices[R0]);
-            if (maxW / minH > 2.0f){
-                glm::vec3 newVert = (p_l + p_r) / 2.0f;
-                m_vertices.push_back(p_l);
-                m_derivaties.push_back(d_l);
-                m_texCoords.push_back(glm::length(d_l));
-                m_advancing_front[2 * ribbon_id] = m_vertices.size() - 1;
-
-                m_vertices.push_back(newVert);
-                m_derivaties.push_back(derivate(newVert));
-                m_texCoords.push_back(glm::length(m_derivaties.back()));
-                m_advancing_front.insert((m_advancing_front.begin() + (2 * ribbon_id + 1)), m_vertices.size() - 1);
-                m_advancing_front.insert((m_advancing_front.begin() + (2 * ribbon_id + 1)), m_vertices.size() - 1);
-                
-                m_vertices.push_back(p_r);
-                m_derivaties.push_back(d_r);
-                m_texCoords.push_back(glm::length(d_r));
-                m_advancing_front[2 * ribbon_id + 3] = m_vertices.size() - 1;
-
-                m_faces.push_back(L0); m_faces.push_back(m_vertices.size() - 2); m_faces.push_back(m_vertices.size() - 3);
-                m_faces.push_back(L0); m_faces.push_back(R0);                    m_faces.push_back(m_vertices.size() - 2);
-                m_faces.push_back(R0); m_faces.push_back(m_vertices.size() - 1); m_faces.push_back(m_vertices.size() - 2);
-
-                return true;
+void StreamTracer::derivate(const std::vector<glm::vec3>& points, std::vector<glm::vec3>& derivatives) const
+{
+    if (isOutOfCore()){
+        std::vector<char> inside;
+        m_bricks.sample(points, derivatives, &inside);
+        for (size_t p = 0; p < points.size(); p++){
+            if (inside[p] && outsideRegion(points[p])){
+                inside[p] = 0;
+                derivatives[p] = glm::vec3(0.0f, 0.0f, 0.0f);
             }
         }
 
-        float left_diagonal = glm::length(p_l - m_vertices[R0]);
-        float right_diagonal = glm::length(p_r - m_vertices[L0]);
-        float min_diagonal = glm::min(left_diagonal, right_diagonal);
-        bool trace_left = (left_diagonal == min_diagonal);
+        TracerStats::Local& stats = TracerStats::local();
+        stats.add(TracerStats::DERIVATE_CALLS, points.size());
+        stats.add(TracerStats::DERIVATE_OUTSIDE, std::count(inside.begin(), inside.end(), 0));
+        return;
+    }
 
-        if (caught_up && (trace_left || right_diagonal > prev_diagonal)) return false;
+    derivatives.resize(points.size());
 
-        if (trace_left){
+    #pragma omp parallel for schedule(static)
+    for (int p = 0; p < (int)points.size(); p++)
+        derivatives[p] = derivate(points[p]);
+}
+
+glm::vec3 StreamTracer::derivate(const glm::vec3& point, const FieldTimeSeries::Interval& interval, double time) const
+{
+    unsigned int cell;
+    if (!findCell(point, cell))
+        return glm::vec3(0.0f, 0.0f, 0.0f);
 
-            m_vertices.push_back(p_l);
-            m_derivaties.push_back(d_l);
-            m_texCoords.push_back(glm::length(d_l));
-            m_advancing_front[2 * ribbon_id] = m_vertices.size() - 1;
+    float w = interval.weight(time);
+    return (1.0f - w) * (*interval.v0)[cell] + w * (*interval.v1)[cell];
+}
 
-            m_faces.push_back(L0);
-            m_faces.push_back(R0);
-            m_faces.push_back(m_vertices.size() - 1);
+glm::vec3 StreamTracer::derivate(const glm::vec3& point, double time) const
+{
+    FieldTimeSeries::Interval interval;
+    if (!m_timeSeries.interval(time, interval))
+        return derivate(point);
 
-            caught_up = true;
-        } else{
-            m_vertices.push_back(p_r);
-            m_derivaties.push_back(d_r);
-            m_texCoords.push_back(glm::length(d_r));
-            int newVertIdx = m_vertices.size() - 1;
+    return derivate(point, interval, time);
+}
 
-            m_faces.push_back(L0);
-            m_faces.push_back(R0);
-            m_faces.push_back(newVertIdx);
+void StreamTracer::reportMemory(MemoryReport& report) const
+{
+    report.add("field/cell boxes", m_geometry->getCellBoxes());
+    report.add("field/cell points", m_geometry->getCellPoints());
+    report.add("field/cell vectors", m_cellVectors);
+    report.add("grid/cells", (unsigned long long)m_geometry->getSceneAccel().getMemoryBytes());
 
-            traceRibbon(ribbon_id + 1, addition, remove, ripping);
+    if (isUnsteady())
+        report.add("field/time steps", (unsigned long long)m_timeSeries.getResidentBytes());
 
-            m_advancing_front[2 * ribbon_id + 1] = newVertIdx;
-        }
-        
-        prev_diagonal = min_diagonal;
+    if (isOutOfCore()){
+        report.add("field/brick index", m_bricks.getIndexBytes());
+        report.add("field/bricks", (unsigned long long)m_bricks.getResidentBytes());
     }
 
-    return false;
+    // The reader keeps the whole VTK dataset after an OpenFOAM load (KiB)
+    if (m_reader && m_reader->GetOutput())
+        report.add("field/vtk reader", (unsigned long long)m_reader->GetOutput()->GetActualMemorySize() * 1024ULL);
+
+    // Batch runs trace surfaces of their own and leave this one unused
+    if (m_surface && m_surface->getVertices().capacity() > 0)
+        m_surface->reportMemory(report);
 }
 
-glm::vec3 StreamTracer::derivate(const glm::vec3& point)
-{
-    glm::vec3 d;
+void StreamTracer::computeStreamsurfaces(bool addition, bool remove, bool ripping) {
+    PROFILE_ZONE("computeStreamsurfaces");
 
-    size_t i, j, k;
-    if (!seedIsValid(point, i, j, k))
-        return glm::vec3(0.0f, 0.0f, 0.0f);
+    // Wall-clock time: clock() counts CPU time, which differs once tracing runs in parallel or waits
+    std::chrono::steady_clock::time_point streamComputation_start = std::chrono::steady_clock::now();
 
-    std::vector<Grid::PrimitiveIndex> &primitives = m_sceneAccel.getPrimitives(i, j, k);
-    unsigned int primitiveIdx = primitives[0];
+    beginStreamsurfaces(addition, remove, ripping);
 
-//    std::vector<Grid::PrimitiveIndex> &primitives = m_sceneAccel.getPrimitives(i, j, k);
-//    size_t t = 0;
-//
-//#ifdef STREAM_TRACER_USE_CELL_LIST
-//    for (; t<primitives.size(); t++)
-//        if (m_cellBoxes[primitives[t]].contains((float*)(&s0)))
-//            break;
-//    if (t == primitives.size())
-//        break;
-//#endif
+    // With a writer attached, generate in slices so the export runs alongside
+    double sliceMilliseconds = m_writer ? EXPORT_SLICE_MILLISECONDS : 0.0;
+    bool finished = false;
+    while (!finished && !(m_cancel && *m_cancel))
+        finished = advanceStreamsurfaces(0, sliceMilliseconds);
+    updateNormals();
+
+    double computationTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - streamComputation_start).count();
+    std::cout << "Computation Time: " << computationTime << std::endl;
+}
 
-    d = m_cellVectors[primitiveIdx];
+void StreamTracer::beginStreamsurfaces(bool addition, bool remove, bool ripping) {
+    m_surface->setParameters(m_surface_parameters);
+    m_surface->begin(addition, remove, ripping);
 
-    return d;
+    m_written_vertices = m_written_indices = 0;
 }
 
-void StreamTracer::computeStreamsurfaces(bool addition, bool remove, bool ripping) {
-    clock_t streamComputation_start = clock();
-
-    m_vertices.clear();
-    m_faces.clear();
-    m_derivaties.clear();
-    m_texCoords.clear();
-    m_advancing_front.clear();
-
-    generateSeedingPoints();
-    //m_advancing_front.resize(m_surface_parameters.seedingPoints.size());
-
-    std::vector<int> lastConnectedPoint(m_surface_parameters.seedingPoints.size() * 2, 0);
-    for (size_t p = 0; p < m_surface_parameters.seedingPoints.size(); p++){
-        m_vertices.push_back(m_surface_parameters.seedingPoints[p]);
-        m_derivaties.push_back(derivate(m_surface_parameters.seedingPoints[p]));
-        m_texCoords.push_back(glm::length(m_derivaties[p]));
-        
-
-        if (p < m_surface_parameters.seedingPoints.size() - 1){
-            m_advancing_front.push_back(p);
-            m_advancing_front.push_back(p + 1);
+bool StreamTracer::advanceStreamsurfaces(size_t maxAdvances, double maxMilliseconds) {
+    bool finished = m_surface->advance(maxAdvances, maxMilliseconds);
+
+    if (m_writer){
+        ArrayView<glm::vec3>    vertices    = viewVertices().sub(m_written_vertices);
+        ArrayView<glm::vec3>    derivatives = viewDerivatives().sub(m_written_vertices);
+        ArrayView<unsigned int> faces       = viewFaceIndices().sub(m_written_indices);
+
+        m_writer->write(vertices, derivatives, faces);
+
+        m_written_vertices += vertices.size();
+        m_written_indices  += faces.size();
+    }
+
+    return finished;
+}
+
+bool StreamTracer::streamsurfacesFinished() const {
+    return m_surface->finished();
+}
+
+void StreamTracer::setCancellationToken(const std::atomic<bool>* token) {
+    m_cancel = token;
+    m_surface->setCancellationToken(token);
+}
+
+void StreamTracer::computeStreamsurfacesBatch(const std::vector<BatchItem>& items, BatchResult& result, int numThreads) const {
+    PROFILE_ZONE("computeStreamsurfacesBatch");
+
+    std::vector< std::unique_ptr<StreamSurface> > surfaces(items.size());
+    std::vector<SurfaceView> views(items.size());
+
+    if (numThreads <= 0)
+        numThreads = omp_get_max_threads();
+
+    // Surfaces differ wildly in cost, so hand them out one by one
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads)
+    for (int s = 0; s < (int)items.size(); s++){
+        PROFILE_ZONE("batch surface");
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        surfaces[s].reset(new StreamSurface(*this));
+        StreamSurface& surface = *surfaces[s];
+        surface.setParameters(items[s].parameters);
+
+        // An export is streamed out slice by slice while the surface grows, like setMeshWriter does
+        MeshWriter writer;
+        views[s].exported = false;
+        views[s].exportMilliseconds = 0.0;
+        if (!items[s].exportFilename.empty() && openExport(items[s].exportFilename, writer)){
+            surface.begin(items[s].addition, items[s].remove, items[s].ripping);
+
+            bool finished = false;
+            while (!finished){
+                finished = surface.advance(0, EXPORT_SLICE_MILLISECONDS);
+
+                std::chrono::steady_clock::time_point write = std::chrono::steady_clock::now();
+                writeAdded(writer, surface);
+                if (finished)
+                    views[s].exported = writer.close();
+                views[s].exportMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - write).count();
+            }
+            surface.updateNormals();
         }
-        
+        else
+            surface.compute(items[s].addition, items[s].remove, items[s].ripping);
+
+        views[s].milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
-    
-    int nSeedingPoints = 20; //m_advancing_front.size();
-    for (size_t i = 0; i < nSeedingPoints * m_surface_parameters.traceMaxSeeds; i++){
-        if (traceRibbon(i % (m_advancing_front.size() - 1), addition, remove, ripping))
-            ;//i++;
+
+    packBatch(surfaces, views, result, numThreads);
+}
+
+void StreamTracer::computePathsurfacesBatch(const std::vector<BatchItem>& items, double startTime, BatchResult& result, int numThreads) const {
+    PROFILE_ZONE("computePathsurfacesBatch");
+
+    std::vector< std::unique_ptr<PathSurface> > surfaces(items.size());
+    std::vector<SurfaceView> views(items.size());
+
+    if (numThreads <= 0)
+        numThreads = omp_get_max_threads();
+
+    // The particles of a surface share one time; surfaces running through the same steps share them too
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads)
+    for (int s = 0; s < (int)items.size(); s++){
+        PROFILE_ZONE("batch path surface");
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        surfaces[s].reset(new PathSurface(*this));
+        surfaces[s]->setParameters(items[s].parameters);
+        surfaces[s]->setStartTime(startTime);
+        surfaces[s]->compute(items[s].addition);
+
+        // Written from the traced surface, before it is reordered into the pool
+        MeshWriter writer;
+        views[s].exported = false;
+        views[s].exportMilliseconds = 0.0;
+        if (!items[s].exportFilename.empty()){
+            std::chrono::steady_clock::time_point write = std::chrono::steady_clock::now();
+            if (openExport(items[s].exportFilename, writer)){
+                writeAdded(writer, *surfaces[s]);
+                views[s].exported = writer.close();
+            }
+            views[s].exportMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - write).count();
+        }
+
+        views[s].milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     }
 
-    float computationTime = ((float)(clock() - streamComputation_start) / CLOCKS_PER_SEC) * 1000.0f;
-    std::cout << "Computation Time: " << computationTime << std::endl;
+    packBatch(surfaces, views, result, numThreads);
+}
 
-    // compute normals
-    /*for (size_t i = 0; i < m_streamLines.size(); i++){
+template <class Surface>
+void StreamTracer::packBatch(std::vector< std::unique_ptr<Surface> >& surfaces, std::vector<SurfaceView>& views, BatchResult& result, int numThreads) {
+    // Lay the surfaces out back to back; the views come with their timings
+    result.surfaces.swap(views);
+
+    SurfaceView offset = { 0, 0, 0, 0, 0, 0, 0.0, false, 0.0 };
+    for (size_t s = 0; s < surfaces.size(); s++){
+        SurfaceView& view = result.surfaces[s];
+        view.firstVertex = offset.firstVertex;  view.vertexCount = surfaces[s]->getVertices().size();
+        view.firstIndex  = offset.firstIndex;   view.indexCount  = surfaces[s]->getFaceIndices().size();
+        view.firstSeed   = offset.firstSeed;    view.seedCount   = surfaces[s]->getSeedingPoints().size();
+
+        offset.firstVertex += view.vertexCount;
+        offset.firstIndex  += view.indexCount;
+        offset.firstSeed   += view.seedCount;
+    }
 
-    }*/
+    result.vertices.resize(offset.firstVertex);
+    result.derivatives.resize(offset.firstVertex);
+    result.normals.resize(offset.firstVertex);
+    result.texCoords.resize(offset.firstVertex);
+    result.faces.resize(offset.firstIndex);
+    result.seedingPoints.resize(offset.firstSeed);
+
+    // Reorder every surface and copy it into the pool, releasing it right away to keep the peak low
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads)
+    for (int s = 0; s < (int)surfaces.size(); s++){
+        const SurfaceView& view = result.surfaces[s];
+
+        SurfaceResult surface;
+        surfaces[s]->takeResult(surface);
+        surfaces[s].reset();
+
+        std::copy(surface.vertices.begin(),      surface.vertices.end(),      result.vertices.begin() + view.firstVertex);
+        std::copy(surface.derivatives.begin(),   surface.derivatives.end(),   result.derivatives.begin() + view.firstVertex);
+        std::copy(surface.normals.begin(),       surface.normals.end(),       result.normals.begin() + view.firstVertex);
+        std::copy(surface.texCoords.begin(),     surface.texCoords.end(),     result.texCoords.begin() + view.firstVertex);
+        std::copy(surface.faces.begin(),         surface.faces.end(),         result.faces.begin() + view.firstIndex);
+        std::copy(surface.seedingPoints.begin(), surface.seedingPoints.end(), result.seedingPoints.begin() + view.firstSeed);
+    }
 }
 
-bool StreamTracer::seedIsValid(glm::vec3 seed) {
+bool StreamTracer::seedIsValid(glm::vec3 seed) const {
+    if (isOutOfCore()){
+        glm::vec3 velocity;
+        return !outsideRegion(seed) && m_bricks.sample(seed, velocity);
+    }
+
     size_t i, j, k;
     return seedIsValid(seed, i, j, k);
 }
 
-bool StreamTracer::seedIsValid(glm::vec3 seed, size_t &i, size_t &j, size_t &k)
+bool StreamTracer::seedIsValid(glm::vec3 seed, size_t &i, size_t &j, size_t &k) const
 {
     float *point = (float*)(&seed);
 
-    if (!m_sceneBox.contains( point ))
+    // The cells of a region reach beyond it, traces do not
+    const MeshGeometry& geometry = *m_geometry;
+    if (!geometry.getSceneBox().contains( point ) || outsideRegion( seed ))
         return false;
 
-    m_sceneAccel.locateCell( i, j, k, point );
-    return !( m_sceneAccel.emptyCell( i, j, k ) );
+    geometry.getSceneAccel().locateCell( i, j, k, point );
+    return !( geometry.getSceneAccel().emptyCell( i, j, k ) );
 }
 
-void StreamTracer::getParameters( SurfaceParameters &parameters )
+void StreamTracer::seedsAreValid(const std::vector<glm::vec3>& seeds, std::vector<char>& valid) const
+{
+    if (isOutOfCore()){
+        std::vector<glm::vec3> velocities;
+        m_bricks.sample(seeds, velocities, &valid);
+        for (size_t s = 0; s < seeds.size(); s++)
+            valid[s] = valid[s] && !outsideRegion(seeds[s]);
+        return;
+    }
+
+    valid.resize(seeds.size());
+
+    #pragma omp parallel for schedule(static)
+    for (int s = 0; s < (int)seeds.size(); s++)
+        valid[s] = seedIsValid(seeds[s]) ? 1 : 0;
+}
+
+void StreamTracer::getParameters( SurfaceParameters &parameters ) const
 {
     parameters = m_surface_parameters;
 }
@@ -366,30 +706,90 @@ void StreamTracer::setParameters( const SurfaceParameters &paramters )
 }
 
 std::vector<glm::vec3> StreamTracer::getVertices(){
-    return m_vertices;
+    return m_surface->getVertices();
 }
 
 std::vector<glm::vec3> StreamTracer::getDerivatives(){
-    return m_derivaties;
+    return m_surface->getDerivatives();
+}
+
+std::vector<glm::vec3> StreamTracer::getNormals(){
+    return m_surface->getNormals();
+}
+
+size_t StreamTracer::updateNormals(){
+    return m_surface->updateNormals();
 }
 
 std::vector<float> StreamTracer::getTexCoords(){
-    return m_texCoords;
+    return m_surface->getTexCoords();
 }
 
 std::vector<unsigned int> StreamTracer::getFaceIndices(){
-    return m_faces;
+    return m_surface->getFaceIndices();
+}
+
+size_t StreamTracer::getVertexCount() const {
+    return m_surface->getVertices().size();
+}
+
+size_t StreamTracer::getFaceIndexCount() const {
+    return m_surface->getFaceIndices().size();
+}
+
+ArrayView<glm::vec3> StreamTracer::viewVertices() const {
+    return ArrayView<glm::vec3>(m_surface->getVertices());
+}
+
+ArrayView<glm::vec3> StreamTracer::viewDerivatives() const {
+    return ArrayView<glm::vec3>(m_surface->getDerivatives());
+}
+
+ArrayView<glm::vec3> StreamTracer::viewNormals() const {
+    return ArrayView<glm::vec3>(m_surface->getNormals());
+}
+
+ArrayView<float> StreamTracer::viewTexCoords() const {
+    return ArrayView<float>(m_surface->getTexCoords());
+}
+
+ArrayView<unsigned int> StreamTracer::viewFaceIndices() const {
+    return ArrayView<unsigned int>(m_surface->getFaceIndices());
+}
+
+ArrayView<glm::vec3> StreamTracer::viewSeedingPoints() const {
+    return ArrayView<glm::vec3>(m_surface->getSeedingPoints());
+}
+
+void StreamTracer::takeResult(SurfaceResult& result){
+    m_surface->takeResult(result);
+}
+
+std::string StreamTracer::getDatasetIdentity(){
+    std::ostringstream identity;
+    identity << m_filename << "|" << getCellCount() << "|" << m_cellVectors.size();
+    if (m_region.valid())
+        identity << "|" << m_region.min[0] << "," << m_region.min[1] << "," << m_region.min[2]
+                 << "," << m_region.max[0] << "," << m_region.max[1] << "," << m_region.max[2];
+
+    boost::system::error_code error;
+    std::time_t modified = boost::filesystem::last_write_time(m_filename + ".bin", error);
+    if (!error)
+        identity << "|" << modified;
+
+    return identity.str();
 }
 
 std::vector<glm::vec3> StreamTracer::getSeedingPoints(){
-    return m_surface_parameters.seedingPoints;
+    return m_surface->getSeedingPoints();
 }
 
 std::vector<glm::vec3> StreamTracer::getAABB(){
     std::vector<glm::vec3> points;
 
-    glm::vec3 min_point(m_sceneBox.min[0], m_sceneBox.min[1], m_sceneBox.min[2]);
-    glm::vec3 max_point(m_sceneBox.max[0], m_sceneBox.max[1], m_sceneBox.max[2]);
+    const AABB& sceneBox = getSceneBox();
+    glm::vec3 min_point(sceneBox.min[0], sceneBox.min[1], sceneBox.min[2]);
+    glm::vec3 max_point(sceneBox.max[0], sceneBox.max[1], sceneBox.max[2]);
 
     // 1
     points.push_back(glm::vec3(min_point.x, min_point.y, min_point.z));
@@ -443,8 +843,25 @@ std::vector<glm::vec3> StreamTracer::getAABB(){
     return points;
 }
 
-bool StreamTracer::loadBinary( std::string filename )
+bool StreamTracer::loadBinary( std::string filename, const AABB& region )
 {
+    // A region is read from the bricks of the binary, which index where its cells are stored
+    if (region.valid())
+    {
+        std::string bricksFile = BrickedField::bricksPath(m_filename);
+
+        BrickedField bricks;
+        std::vector<AABB> cellBoxes;
+        std::vector<glm::vec3> cellPoints;
+        if (!updateBricks(filename, bricksFile) || !bricks.open(bricksFile) || !bricks.readRegion(region, cellBoxes, m_cellVectors))
+            return false;
+
+        // The bricks hold no mesh points
+        std::cout << "loadBinary: loaded the region of interest from " << bricksFile << std::endl;
+        m_geometry = MeshGeometry::share(cellBoxes, cellPoints);
+        return true;
+    }
+
     std::ifstream in(filename.c_str(), std::ios_base::binary);
 
     if (in)
@@ -455,17 +872,19 @@ bool StreamTracer::loadBinary( std::string filename )
         size_t cellPointsNumber;
         size_t cellVectorsNumber;
 
-        in >> cellBoxesNumber >> std::ws;
-        in >> cellPointsNumber >> std::ws;
-        in >> cellVectorsNumber >> std::ws;
+        if (!BinaryIO::readCount(in, cellBoxesNumber) || !BinaryIO::readCount(in, cellPointsNumber) || !BinaryIO::readCount(in, cellVectorsNumber))
+            return false;
 
-        m_cellBoxes.resize(cellBoxesNumber);
-        m_cellPoints.resize(cellPointsNumber);
+        std::vector<AABB> cellBoxes(cellBoxesNumber);
+        std::vector<glm::vec3> cellPoints(cellPointsNumber);
         m_cellVectors.resize(cellVectorsNumber);
 
-        in.read((char*)(&m_cellBoxes[0]), sizeof(AABB)*cellBoxesNumber);
-        in.read((char*)(&m_cellPoints[0]), sizeof(glm::vec3)*cellPointsNumber);
+        in.read((char*)(&cellBoxes[0]), sizeof(AABB)*cellBoxesNumber);
+        in.read((char*)(&cellPoints[0]), sizeof(glm::vec3)*cellPointsNumber);
         in.read((char*)(&m_cellVectors[0]), sizeof(glm::vec3)*cellVectorsNumber);
+
+        if (in)
+            m_geometry = MeshGeometry::share(cellBoxes, cellPoints);
     }
 
     return !!in;
@@ -473,39 +892,34 @@ bool StreamTracer::loadBinary( std::string filename )
 
 bool StreamTracer::saveBinary( std::string filename )
 {
+    // A region of interest has its cells without the points; saving it would truncate the cache
+    if (!m_geometry || (m_geometry->getCellPoints().empty() && !m_geometry->getCellBoxes().empty()))
+    {
+        std::cout << "saveBinary: the dataset has cells but no points, not saving " << filename << std::endl;
+        return false;
+    }
+
     std::ofstream out(filename.c_str(), std::ios_base::binary);
 
     if (out)
     {
         std::cout << "saveBinary: saving " << filename << std::endl;
 
-        size_t cellBoxesNumber   = m_cellBoxes.size();
-        size_t cellPointsNumber  = m_cellPoints.size();
+        const std::vector<AABB>& cellBoxes = m_geometry->getCellBoxes();
+        const std::vector<glm::vec3>& cellPoints = m_geometry->getCellPoints();
+
+        size_t cellBoxesNumber   = cellBoxes.size();
+        size_t cellPointsNumber  = cellPoints.size();
         size_t cellVectorsNumber = m_cellVectors.size();
 
         out << cellBoxesNumber << std::endl;
         out << cellPointsNumber << std::endl;
         out << cellVectorsNumber << std::endl;
 
-        out.write((char*)(&m_cellBoxes[0]), sizeof(AABB)*cellBoxesNumber);
-        out.write((char*)(&m_cellPoints[0]), sizeof(glm::vec3)*cellPointsNumber);
+        out.write((char*)(&cellBoxes[0]), sizeof(AABB)*cellBoxesNumber);
+        out.write((char*)(&cellPoints[0]), sizeof(glm::vec3)*cellPointsNumber);
         out.write((char*)(&m_cellVectors[0]), sizeof(glm::vec3)*cellVectorsNumber);
     }
 
     return !!out;
 }
-
-void StreamTracer::generateSeedingPoints() {
-    glm::vec3 line_direction(0.0f, 0.0f, 1.0f);
-    boost::random::mt19937 rng;
-    boost::random::uniform_real_distribution<> dist(-0.5f, +0.5f);
-    float len = .4f;
-    for (size_t s = 0; s < m_surface_parameters.traceMaxSeeds; s++){
-        glm::vec3 seed;
-        //do
-        seed = m_surface_parameters.seedingLineCenter + (s * len / m_surface_parameters.traceMaxSeeds - .2f) * m_surface_parameters.seedingLineDirection;
-        //while (!seedIsValid(seed));
-        if (seedIsValid(seed))
-            m_surface_parameters.seedingPoints.push_back(seed);
-    }
-}
\ No newline at end of file
@@ -11,6 +11,9 @@
 #define __STREAM_TRACER__
 
 // STD
+#include <atomic>
+#include <memory>
+#include <string>
 #include <vector>
 
 // VTK
@@ -23,7 +26,15 @@
 
 // RPE
 #include "AABB.h"
+#include "ArrayView.h"
+#include "BrickedField.h"
+#include "FieldTimeSeries.h"
 #include "Grid.h"
+#include "MeshGeometry.h"
+
+class MemoryReport;
+class MeshWriter;
+class StreamSurface;
 
 class StreamTracer
 {
@@ -32,13 +43,51 @@ public:
     StreamTracer();
     virtual ~StreamTracer();
 
+    /// Load a dataset. The steady field is the last time step of the case; the time steps of an
+    /// unsteady case are listed in <file>.times and loaded on demand (see getTimeSeries()).
+    /// Tracers of datasets on the same mesh share its geometry and grid (see MeshGeometry).
     void loadOpenFOAM(std::string filename);
 
+    /// Load only the cells that intersect a region of interest (an invalid box: all of them). They
+    /// are read from the bricks of the binary cache (see BrickedField, split on the first use), so
+    /// the bricks outside the region are skipped. computeAccel then builds the grid over these cells
+    /// only, and traces end where they leave the region. Only the steady field is loaded, and the
+    /// bricks hold no mesh points, so the geometry of a region has none (and is not saved).
+    void loadOpenFOAM(std::string filename, const AABB& regionOfInterest);
+    const AABB& getRegionOfInterest() const { return m_region; }
+
+    /// Trace the datasets loaded from now on out of core, with at most maxResidentBytes of bricks
+    /// in memory (see BrickedField); 0 loads them whole. The bricks are split from the binary cache
+    /// on the first load. Out of core, only the steady field is traced and there is no global grid.
+    void setOutOfCore(size_t maxResidentBytes);
+    bool isOutOfCore() const { return m_bricks.isOpen(); }
+
+    /// The bricks of an out-of-core dataset, e.g. for their statistics.
+    const BrickedField& getBricks() const { return m_bricks; }
+
+    /// Build the grid over the cells, unless the geometry is shared and already has one.
     void computeAccel();
     void computeStreamsurfaces(bool addition, bool remove, bool ripping);
 
+    /// Progressive surface generation: begin a new surface, then grow it in bounded slices.
+    /// advanceStreamsurfaces stops after maxAdvances front advances or maxMilliseconds of wall time
+    /// (0 disables the respective limit) and returns true once the surface is complete.
+    /// Vertices and faces are only ever appended, so callers can consume the new ranges per slice.
+    void beginStreamsurfaces(bool addition, bool remove, bool ripping);
+    bool advanceStreamsurfaces(size_t maxAdvances, double maxMilliseconds);
+    bool streamsurfacesFinished() const;
+
+    /// Surface generation stops between two ribbon steps once the token is set. NULL disables cancellation.
+    void setCancellationToken(const std::atomic<bool>* token);
+
+    /// Stream every slice of the surface into an open writer as it is generated. NULL stops streaming.
+    /// The file gets the triangles in the order they are traced, before takeResult() reorders them.
+    void setMeshWriter(MeshWriter* writer) { m_writer = writer; }
+
     struct SurfaceParameters
     {
+        SurfaceParameters();
+
         // Tracing parameters
         enum TraceDirection { TD_FORWARD, TD_BACKWARD, TD_BOTH };
 
@@ -47,6 +96,24 @@ public:
         unsigned int    traceMaxSteps;
         unsigned int    traceMaxSeeds;
 
+        // Seed curve
+        //   SC_LINE:     segment of length seedingLineLength through the center along the direction
+        //   SC_CIRCLE:   closed circle of radius seedingLineLength around the center, normal to the direction
+        //   SC_POLYLINE: the control points connected by straight segments
+        //   SC_SPLINE:   a Catmull-Rom spline through the control points
+        enum SeedCurveType { SC_LINE, SC_CIRCLE, SC_POLYLINE, SC_SPLINE };
+
+        SeedCurveType               seedCurveType;
+        std::vector< glm::vec3 >    seedCurvePoints;
+        float                       seedingLineLength;
+
+        /// A closed curve has no end points: its last sample is followed by the first.
+        bool isSeedCurveClosed() const { return seedCurveType == SC_CIRCLE; }
+
+        // Place seeds by local flow divergence and velocity gradient instead of by arc length.
+        // traceMaxSeeds is then an upper bound, reached only where the whole curve is turbulent.
+        bool                        adaptiveSeeding;
+
         // Seeding plane
         std::vector< glm::vec3 >    seedingPoints;
         glm::vec3                   seedingLineCenter;
@@ -57,6 +124,10 @@ public:
                 traceStepSize == rval.traceStepSize     &&
                 traceMaxSteps == rval.traceMaxSteps     &&
                 traceMaxSeeds == rval.traceMaxSeeds     &&
+                seedCurveType == rval.seedCurveType     &&
+                seedCurvePoints == rval.seedCurvePoints &&
+                seedingLineLength == rval.seedingLineLength &&
+                adaptiveSeeding == rval.adaptiveSeeding &&
                 seedingLineCenter == rval.seedingLineCenter &&
                 seedingLineDirection == rval.seedingLineDirection){
                 return true;
@@ -66,29 +137,166 @@ public:
         }
     };
 
-    void getParameters(SurfaceParameters &parameters);
+    void getParameters(SurfaceParameters &parameters) const;
     void setParameters(const SurfaceParameters &parameters);
 
+    /// One surface of a batch: its seed curve and tracing parameters.
+    struct BatchItem
+    {
+        SurfaceParameters parameters;
+        bool addition, remove, ripping;
+
+        // When set, the surface is written to this file (.ply, .vtu or .obj) while it is traced,
+        // in traced order, before it is reordered into the pool (see setMeshWriter)
+        std::string exportFilename;
+    };
+
+    /// Range of one surface inside the pooled batch buffers. Face indices are relative
+    /// to firstVertex (draw with a base vertex or add it when reading).
+    struct SurfaceView
+    {
+        size_t firstVertex, vertexCount;
+        size_t firstIndex,  indexCount;
+        size_t firstSeed,   seedCount;
+
+        // Wall-clock time spent tracing this surface
+        double milliseconds;
+
+        // Whether the export file of the item was written completely, and the time spent on it
+        // (part of milliseconds)
+        bool   exported;
+        double exportMilliseconds;
+    };
+
+    /// All surfaces of a batch, stored back to back.
+    struct BatchResult
+    {
+        std::vector< glm::vec3 >    vertices;
+        std::vector< glm::vec3 >    derivatives;
+        std::vector< glm::vec3 >    normals;
+        std::vector< float >        texCoords;
+        std::vector< unsigned int > faces;
+        std::vector< glm::vec3 >    seedingPoints;
+
+        std::vector< SurfaceView >  surfaces;
+    };
+
+    /// Generate many surfaces in one pass. The field and acceleration structure are shared
+    /// read-only while the surfaces are traced in parallel (numThreads <= 0: OpenMP default).
+    void computeStreamsurfacesBatch(const std::vector<BatchItem>& items, BatchResult& result, int numThreads = 0) const;
+
+    /// Path surfaces released at startTime through the time steps of the field (see PathSurface);
+    /// only addition of the items applies. Surfaces end early where a time step cannot be loaded. A path
+    /// surface is traced in one piece, so its export is written as soon as it is finished.
+    void computePathsurfacesBatch(const std::vector<BatchItem>& items, double startTime, BatchResult& result, int numThreads = 0) const;
+
+    /// Sample the field at a point. Returns zero outside of the domain. Thread-safe.
+    glm::vec3 derivate(const glm::vec3& point) const;
+
+    /// Sample the field at many points at once (in parallel). Out of core, the points are
+    /// grouped by brick, so that every brick is looked up once for all of them.
+    void derivate(const std::vector<glm::vec3>& points, std::vector<glm::vec3>& derivatives) const;
+
+    /// Sample the unsteady field at a point and time, interpolated linearly between the two
+    /// steps of the interval, which must contain the time. Thread-safe and lock-free.
+    glm::vec3 derivate(const glm::vec3& point, const FieldTimeSeries::Interval& interval, double time) const;
+
+    /// The same, looking the interval up first; the steady field if there are no time steps.
+    glm::vec3 derivate(const glm::vec3& point, double time) const;
+
+    /// The time steps of the dataset; empty for a steady dataset.
+    const FieldTimeSeries& getTimeSeries() const { return m_timeSeries; }
+    FieldTimeSeries& getTimeSeries() { return m_timeSeries; }
+    bool isUnsteady() const { return m_timeSeries.getStepCount() > 1; }
+
+    bool seedIsValid(glm::vec3 seed) const;
+
+    /// The same, with the cell of the global grid. Always false out of core.
+    bool seedIsValid(glm::vec3 seed, size_t &i, size_t &j, size_t &k) const;
+
+    /// Test many seeds at once (in parallel); valid[i] is set to 1 for seeds inside the domain.
+    void seedsAreValid(const std::vector<glm::vec3>& seeds, std::vector<char>& valid) const;
+
+    /// Generated geometry of one surface.
+    struct SurfaceResult
+    {
+        std::vector< glm::vec3 >    seedingPoints;
+        std::vector< glm::vec3 >    vertices;
+        std::vector< glm::vec3 >    derivatives;
+        std::vector< glm::vec3 >    normals;
+        std::vector< float >        texCoords;
+        std::vector< unsigned int > faces;
+    };
+
+    /// Read-only views of the current surface. No copies are made; a view stays valid
+    /// until the surface grows, restarts or is taken. Use view.sub(first, count) for ranges,
+    /// e.g. the part appended by the last slice, and view.copyTo() to fill mapped memory.
+    ArrayView<glm::vec3>    viewVertices() const;
+    ArrayView<glm::vec3>    viewDerivatives() const;
+    ArrayView<glm::vec3>    viewNormals() const;
+    ArrayView<float>        viewTexCoords() const;
+    ArrayView<unsigned int> viewFaceIndices() const;
+    ArrayView<glm::vec3>    viewSeedingPoints() const;
+
+    /// Move the surface out of the tracer without copying it, reordered for the GPU (see
+    /// StreamSurface::optimize). The tracer is left with an empty surface.
+    void takeResult(SurfaceResult& result);
+
+    /// Copies of the current surface; prefer the views or takeResult for large surfaces.
     std::vector<glm::vec3> getVertices();
     std::vector<glm::vec3> getDerivatives();
+    std::vector<glm::vec3> getNormals();
     std::vector<float> getTexCoords();
 
+    /// Bring the vertex normals up to date with the triangles generated so far (incremental, parallel).
+    /// Returns the first vertex whose normal changed since the previous call.
+    size_t updateNormals();
+
     std::vector<unsigned int> getFaceIndices();
 
+    size_t getVertexCount() const;
+    size_t getFaceIndexCount() const;
+
+    /// Identifies the loaded field (file, sizes and cache modification time), e.g. for surface caches.
+    std::string getDatasetIdentity();
+
+    size_t getCellCount() const { return isOutOfCore() ? m_bricks.getCellCount() : m_geometry->getCellBoxes().size(); }
+
     std::vector<glm::vec3> getSeedingPoints();
     std::vector<glm::vec3> getAABB();
+    const AABB& getSceneBox() const { return isOutOfCore() ? m_bricks.getSceneBox() : m_geometry->getSceneBox(); }
+
+    /// The cell bounds and the grid built over them by computeAccel, e.g. for benchmarks. Empty out of core.
+    const std::vector<AABB>& getCellBoxes() const { return m_geometry->getCellBoxes(); }
+    const Grid& getSceneAccel() const { return m_geometry->getSceneAccel(); }
+
+    /// The mesh of the dataset, possibly shared with other tracers.
+    const std::shared_ptr<MeshGeometry>& getGeometry() const { return m_geometry; }
+
+    /// Add the bytes of the field, the grid and the surface being generated. Not while a SurfaceWorker traces with this tracer.
+    /// The geometry counts with every tracer that shares it; MeshGeometry::sharedBytes() counts it once.
+    void reportMemory(MemoryReport& report) const;
 
 private:
-    bool loadBinary(std::string filename);
+    bool loadBinary(std::string filename, const AABB& region);
     bool saveBinary(std::string filename);
 
-    void generateSeedingPoints();
-    bool traceRibbon(const unsigned int& ribbon_id, bool addition, bool remove, bool ripping);
+    /// Split the binary cache into bricks if they are missing or older than it.
+    static bool updateBricks(const std::string& binaryPath, const std::string& bricksPath);
+
+    /// Open the bricks of the dataset for out-of-core tracing.
+    bool openBricks();
+
+    bool outsideRegion(const glm::vec3& point) const { return m_region.valid() && !m_region.contains((const float*)&point); }
 
-    glm::vec3 derivate(const glm::vec3& point);
+    void loadTimeSeries();
+    bool loadTimeStep(size_t step, FieldTimeSeries::Velocities& velocities);
 
-    bool seedIsValid(glm::vec3 seed);
-    bool seedIsValid(glm::vec3 seed, size_t &i, size_t &j, size_t &k);
+    /// The cell containing a point, counted in the tracer statistics.
+    bool findCell(const glm::vec3& point, unsigned int& cell) const;
+
+    template <class Surface>
+    static void packBatch(std::vector< std::unique_ptr<Surface> >& surfaces, std::vector<SurfaceView>& views, BatchResult& result, int numThreads);
 
     SurfaceParameters m_surface_parameters;
 
@@ -96,22 +304,28 @@ private:
 
     std::string m_filename;
 
-    std::vector<AABB>      m_cellBoxes;
-    std::vector<glm::vec3> m_cellPoints;
+    // Cells outside are not loaded and traces end at its boundary; invalid for the whole dataset
+    AABB m_region;
+
+    // Cell bounds, points and grid, shared by the datasets of one mesh
+    std::shared_ptr<MeshGeometry> m_geometry;
     std::vector<glm::vec3> m_cellVectors;
 
-    AABB m_sceneBox;
-    Grid m_sceneAccel;
+    // Velocities of all time steps, sharing the geometry
+    FieldTimeSeries m_timeSeries;
+
+    // Out of core: the bricks replace the geometry and the cell vectors
+    BrickedField m_bricks;
+    size_t m_out_of_core_bytes;
 
-    std::vector< glm::vec3 >    m_vertices;
-    std::vector< glm::vec3 >    m_derivaties;
-    std::vector< glm::vec3 >    m_normals;
-    std::vector< glm::uint32 >  m_normal_counts;
+    // The surface of the single-surface API
+    std::unique_ptr<StreamSurface> m_surface;
 
-    std::vector< float >        m_texCoords;
-    std::vector< unsigned int>  m_faces;
+    const std::atomic<bool>* m_cancel;
 
-    std::vector< int >  m_advancing_front;
+    // Export while generating, and the amount of the surface already handed to the writer
+    MeshWriter* m_writer;
+    size_t m_written_vertices, m_written_indices;
     /*std::vector< std::vector< glm::vec3 > >  m_streamDerivs_forward;
     std::vector< std::vector< glm::vec3 > >  m_streamTexCoords_forward;
 
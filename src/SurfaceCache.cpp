@@ -0,0 +1,240 @@
+#include "SurfaceCache.h"
+
+// STD
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// Boost
+#include <boost/filesystem.hpp>
+
+namespace
+{
+    // Bump whenever the tracer output or the file layout changes
+    const unsigned int CACHE_VERSION = 4;
+    const char CACHE_MAGIC[4] = { 'S', 'S', 'G', 'C' };
+
+    // 64 bit FNV-1a
+    struct Hasher
+    {
+        Hasher() : hash(14695981039346656037ULL) {}
+
+        void add(const void* data, size_t size)
+        {
+            const unsigned char* bytes = (const unsigned char*)data;
+            for (size_t i = 0; i < size; i++){
+                hash ^= bytes[i];
+                hash *= 1099511628211ULL;
+            }
+        }
+
+        template<typename T> void add(const T& value) { add(&value, sizeof(T)); }
+
+        unsigned long long hash;
+    };
+
+    template<typename T> void writeArray(std::ofstream& out, const std::vector<T>& values)
+    {
+        unsigned long long count = values.size();
+        out.write((const char*)&count, sizeof(count));
+        if (count > 0)
+            out.write((const char*)&values[0], sizeof(T) * values.size());
+    }
+
+    // The count comes from the file: a corrupt one must not get past the bytes that are left
+    template<typename T> bool readArray(std::ifstream& in, std::streamoff end, std::vector<T>& values)
+    {
+        unsigned long long count = 0;
+        if (!in.read((char*)&count, sizeof(count)))
+            return false;
+
+        std::streamoff left = end - in.tellg();
+        if (left < 0 || count > (unsigned long long)left / sizeof(T))
+            return false;
+
+        values.resize((size_t)count);
+        if (count > 0)
+            in.read((char*)&values[0], sizeof(T) * values.size());
+        return !!in;
+    }
+}
+
+size_t SurfaceCache::Surface::bytes() const
+{
+    return sizeof(glm::vec3) * (seedingPoints.size() + vertices.size() + derivatives.size() + normals.size())
+         + sizeof(float) * texCoords.size()
+         + sizeof(unsigned int) * faces.size();
+}
+
+SurfaceCache::SurfaceCache(size_t maxMemoryBytes)
+{
+    m_max_memory_bytes = maxMemoryBytes;
+    m_memory_bytes = 0;
+}
+
+SurfaceCache::Key SurfaceCache::computeKey(const std::string& datasetIdentity, const StreamTracer::SurfaceParameters& parameters, bool addition, bool remove, bool ripping)
+{
+    Hasher hasher;
+    hasher.add(CACHE_VERSION);
+    hasher.add(datasetIdentity.data(), datasetIdentity.size());
+
+    hasher.add((int)parameters.traceDirection);
+    hasher.add(parameters.traceStepSize);
+    hasher.add(parameters.traceMaxSteps);
+    hasher.add(parameters.traceMaxSeeds);
+    hasher.add(parameters.seedingLineCenter);
+    hasher.add(parameters.seedingLineDirection);
+
+    hasher.add((int)parameters.seedCurveType);
+    hasher.add(parameters.seedingLineLength);
+    hasher.add(parameters.adaptiveSeeding);
+    if (!parameters.seedCurvePoints.empty())
+        hasher.add(&parameters.seedCurvePoints[0], sizeof(glm::vec3) * parameters.seedCurvePoints.size());
+
+    hasher.add(addition);
+    hasher.add(remove);
+    hasher.add(ripping);
+
+    return hasher.hash;
+}
+
+void SurfaceCache::setDiskDirectory(const std::string& directory)
+{
+    m_directory = directory;
+}
+
+void SurfaceCache::setMaxMemoryBytes(size_t bytes)
+{
+    m_max_memory_bytes = bytes;
+    evict();
+}
+
+std::shared_ptr<const SurfaceCache::Surface> SurfaceCache::find(Key key)
+{
+    std::unordered_map< Key, LRUList::iterator >::iterator it = m_entries.find(key);
+    if (it != m_entries.end()){
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->second;
+    }
+
+    if (m_directory.empty())
+        return std::shared_ptr<const Surface>();
+
+    std::shared_ptr<Surface> surface(new Surface);
+    if (!loadDisk(key, *surface))
+        return std::shared_ptr<const Surface>();
+
+    insertMemory(key, surface);
+    return surface;
+}
+
+void SurfaceCache::insert(Key key, const std::shared_ptr<const Surface>& surface)
+{
+    insertMemory(key, surface);
+
+    if (!m_directory.empty())
+        saveDisk(key, *surface);
+}
+
+void SurfaceCache::clear()
+{
+    m_lru.clear();
+    m_entries.clear();
+    m_memory_bytes = 0;
+}
+
+void SurfaceCache::insertMemory(Key key, const std::shared_ptr<const Surface>& surface)
+{
+    std::unordered_map< Key, LRUList::iterator >::iterator it = m_entries.find(key);
+    if (it != m_entries.end()){
+        m_memory_bytes -= it->second->second->bytes();
+        m_lru.erase(it->second);
+        m_entries.erase(it);
+    }
+
+    m_lru.push_front(std::make_pair(key, surface));
+    m_entries[key] = m_lru.begin();
+    m_memory_bytes += surface->bytes();
+
+    evict();
+}
+
+void SurfaceCache::evict()
+{
+    // The most recent entry stays, even if it alone exceeds the budget
+    while (m_memory_bytes > m_max_memory_bytes && m_lru.size() > 1){
+        m_memory_bytes -= m_lru.back().second->bytes();
+        m_entries.erase(m_lru.back().first);
+        m_lru.pop_back();
+    }
+}
+
+std::string SurfaceCache::diskPath(Key key) const
+{
+    char name[32];
+    sprintf(name, "%016llx.surf", key);
+    return (boost::filesystem::path(m_directory) / name).string();
+}
+
+bool SurfaceCache::loadDisk(Key key, Surface& surface) const
+{
+    std::ifstream in(diskPath(key).c_str(), std::ios_base::binary);
+    if (!in)
+        return false;
+
+    in.seekg(0, std::ios_base::end);
+    std::streamoff end = in.tellg();
+    in.seekg(0, std::ios_base::beg);
+
+    char magic[4];
+    unsigned int version = 0;
+    Key fileKey = 0;
+    in.read(magic, sizeof(magic));
+    in.read((char*)&version, sizeof(version));
+    in.read((char*)&fileKey, sizeof(fileKey));
+
+    if (!in || !std::equal(magic, magic + 4, CACHE_MAGIC) || version != CACHE_VERSION || fileKey != key)
+        return false;
+
+    return readArray(in, end, surface.seedingPoints)
+        && readArray(in, end, surface.vertices)
+        && readArray(in, end, surface.derivatives)
+        && readArray(in, end, surface.normals)
+        && readArray(in, end, surface.texCoords)
+        && readArray(in, end, surface.faces);
+}
+
+bool SurfaceCache::saveDisk(Key key, const Surface& surface) const
+{
+    boost::system::error_code error;
+    boost::filesystem::create_directories(m_directory, error);
+
+    // Write to a temporary file first, so an interrupted write never leaves a truncated entry
+    std::string path = diskPath(key);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary.c_str(), std::ios_base::binary);
+        if (!out){
+            std::cout << "SurfaceCache: cannot write " << temporary << std::endl;
+            return false;
+        }
+
+        out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        out.write((const char*)&CACHE_VERSION, sizeof(CACHE_VERSION));
+        out.write((const char*)&key, sizeof(key));
+
+        writeArray(out, surface.seedingPoints);
+        writeArray(out, surface.vertices);
+        writeArray(out, surface.derivatives);
+        writeArray(out, surface.normals);
+        writeArray(out, surface.texCoords);
+        writeArray(out, surface.faces);
+
+        if (!out)
+            return false;
+    }
+
+    boost::filesystem::rename(temporary, path, error);
+    return !error;
+}
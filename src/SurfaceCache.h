@@ -0,0 +1,78 @@
+
+/**
+ *
+ * Stream surface cache
+ *
+ * This class keeps generated surfaces keyed by a hash of the dataset identity,
+ * the surface parameters and the tracing flags. Recently used surfaces are held
+ * in a memory-bounded LRU; optionally every surface is also written to a disk
+ * directory in a compact binary format, so later sessions can reuse it.
+ *
+ * The cache is not thread-safe; it is meant to be owned by one thread (the surface worker).
+ *
+ */
+
+#ifndef __SURFACE_CACHE__
+#define __SURFACE_CACHE__
+
+// STD
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "StreamTracer.h"
+
+class SurfaceCache
+{
+public:
+
+    typedef unsigned long long Key;
+
+    struct Surface : public StreamTracer::SurfaceResult
+    {
+        size_t bytes() const;
+    };
+
+    SurfaceCache(size_t maxMemoryBytes = 512 * 1024 * 1024);
+
+    /// Hash everything a surface depends on.
+    static Key computeKey(const std::string& datasetIdentity, const StreamTracer::SurfaceParameters& parameters, bool addition, bool remove, bool ripping);
+
+    /// Enable the disk tier in the given directory (created on demand). An empty path disables it.
+    void setDiskDirectory(const std::string& directory);
+    void setMaxMemoryBytes(size_t bytes);
+
+    /// Look a surface up in memory, then on disk. Returns NULL on a miss.
+    std::shared_ptr<const Surface> find(Key key);
+    void insert(Key key, const std::shared_ptr<const Surface>& surface);
+
+    void clear();
+
+    size_t getMemoryBytes() const { return m_memory_bytes; }
+
+private:
+    typedef std::list< std::pair< Key, std::shared_ptr<const Surface> > > LRUList;
+
+    void insertMemory(Key key, const std::shared_ptr<const Surface>& surface);
+    void evict();
+
+    std::string diskPath(Key key) const;
+    bool loadDisk(Key key, Surface& surface) const;
+    bool saveDisk(Key key, const Surface& surface) const;
+
+    size_t  m_max_memory_bytes;
+    size_t  m_memory_bytes;
+
+    LRUList m_lru;      // most recently used first
+    std::unordered_map< Key, LRUList::iterator > m_entries;
+
+    std::string m_directory;
+};
+
+#endif
@@ -0,0 +1,342 @@
+#include "SurfaceWorker.h"
+
+// STD
+#include <algorithm>
+#include <iostream>
+
+// Stream Tracer
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshWriter.h"
+#include "Profiler.h"
+#include "TracerStats.h"
+
+SurfaceWorker::Result::Result()
+{
+    clear();
+}
+
+void SurfaceWorker::Result::clear()
+{
+    request_id = 0;
+    restart  = false;
+    finished = false;
+
+    seedingPoints.clear();
+    vertices.clear();
+    derivatives.clear();
+    faces.clear();
+
+    normalsFirst = 0;
+    normals.clear();
+
+    levels.clear();
+}
+
+void SurfaceWorker::Result::append(const Result& delta)
+{
+    vertices.insert(vertices.end(), delta.vertices.begin(), delta.vertices.end());
+    derivatives.insert(derivatives.end(), delta.derivatives.begin(), delta.derivatives.end());
+    faces.insert(faces.end(), delta.faces.begin(), delta.faces.end());
+
+    appendNormals(delta.normalsFirst, delta.normals);
+
+    request_id = delta.request_id;
+    finished   = delta.finished;
+    if (!delta.levels.empty())
+        levels = delta.levels;
+}
+
+void SurfaceWorker::Result::appendNormals(size_t first, ArrayView<glm::vec3> values)
+{
+    // Both normal ranges end at the vertex count of their delta, so the union starts at the
+    // smaller first index and the newer values win where they overlap
+    if (normals.empty())
+        normalsFirst = first;
+
+    size_t unionFirst = std::min(normalsFirst, first);
+    size_t unionEnd   = std::max(normalsFirst + normals.size(), first + values.size());
+
+    if (unionFirst < normalsFirst)
+        normals.insert(normals.begin(), normalsFirst - unionFirst, glm::vec3(0.0f, 0.0f, 0.0f));
+    normals.resize(unionEnd - unionFirst, glm::vec3(0.0f, 0.0f, 0.0f));
+    normalsFirst = unionFirst;
+
+    if (!values.empty())
+        values.copyTo(&normals[first - unionFirst]);
+}
+
+SurfaceWorker::SurfaceWorker(StreamTracer& tracer)
+    : m_tracer(tracer)
+{
+    m_request_id = 0;
+    m_request_pending = false;
+    m_running = false;
+    m_cancel = false;
+    m_back_dirty = false;
+
+    m_published_vertices = m_published_indices = 0;
+    m_slice_milliseconds = 8.0;
+
+    m_lod_levels = 3;
+    m_lod_ratio  = 4.0f;
+
+    m_cache = NULL;
+}
+
+SurfaceWorker::~SurfaceWorker()
+{
+    stop();
+}
+
+void SurfaceWorker::start()
+{
+    if (m_running)
+        return;
+
+    m_running = true;
+    m_tracer.setCancellationToken(&m_cancel);
+    m_thread = std::thread(&SurfaceWorker::run, this);
+}
+
+void SurfaceWorker::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running)
+            return;
+
+        m_running = false;
+        m_cancel = true;
+    }
+    m_condition.notify_one();
+
+    m_thread.join();
+    m_tracer.setCancellationToken(NULL);
+}
+
+void SurfaceWorker::setCache(SurfaceCache* cache, const std::string& datasetIdentity)
+{
+    m_cache = cache;
+    m_dataset_identity = datasetIdentity;
+}
+
+unsigned int SurfaceWorker::submit(const Request& request)
+{
+    unsigned int id;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_request = request;
+        m_request_pending = true;
+        m_cancel = true;
+        id = ++m_request_id;
+    }
+    m_condition.notify_one();
+
+    return id;
+}
+
+bool SurfaceWorker::fetch(Result& result)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_back_dirty)
+        return false;
+
+    std::swap(result, m_back);
+    m_back.clear();
+    m_back_dirty = false;
+
+    return true;
+}
+
+void SurfaceWorker::run()
+{
+    Profiler::setThreadName("Surface worker");
+
+    while (true){
+        Request request;
+        unsigned int request_id;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_running && !m_request_pending)
+                m_condition.wait(lock);
+
+            if (!m_running)
+                return;
+
+            request = m_request;
+            request_id = m_request_id;
+            m_request_pending = false;
+            m_cancel = false;
+        }
+
+        MeshWriter writer;
+        if (!request.exportFilename.empty()){
+            MeshWriter::Format format;
+            if (!MeshWriter::formatFromFilename(request.exportFilename, format))
+                std::cout << "Unknown export format: " << request.exportFilename << std::endl;
+            else
+                writer.open(request.exportFilename, format);
+        }
+
+        SurfaceCache::Key key = 0;
+        if (m_cache){
+            key = SurfaceCache::computeKey(m_dataset_identity, request.parameters, request.addition, request.remove, request.ripping);
+
+            std::shared_ptr<const SurfaceCache::Surface> cached = m_cache->find(key);
+            if (cached){
+                if (writer.isOpen()){
+                    writer.write(cached->vertices, cached->derivatives, cached->faces);
+                    writer.close();
+                }
+
+                publishCached(request_id, *cached);
+                publishLevels(request_id, *cached, request.lodMaxError);
+                continue;
+            }
+        }
+
+        m_tracer.setParameters(request.parameters);
+        m_tracer.setMeshWriter(writer.isOpen() ? &writer : NULL);
+        // The counters describe the surface in progress
+        TracerStats::reset();
+        m_tracer.beginStreamsurfaces(request.addition, request.remove, request.ripping);
+
+        m_published_vertices = m_published_indices = 0;
+        publish(request_id, true, false);
+
+        bool finished = false;
+        while (!finished && !m_cancel){
+            finished = m_tracer.advanceStreamsurfaces(0, m_slice_milliseconds);
+            if (!m_cancel)
+                publish(request_id, false, finished);
+        }
+
+        // The export was streamed slice by slice; a cancelled surface leaves no file
+        m_tracer.setMeshWriter(NULL);
+        if (writer.isOpen()){
+            if (finished)
+                writer.close();
+            else
+                writer.discard();
+        }
+
+        if (finished){
+            // The surface at its largest, before it leaves the tracer
+            MemoryReport memory;
+            m_tracer.reportMemory(memory);
+
+            // Everything has been published already, so the tracer's copy can be moved out
+            std::shared_ptr<SurfaceCache::Surface> surface(new SurfaceCache::Surface);
+            m_tracer.takeResult(*surface);
+
+            if (m_cache){
+                m_cache->insert(key, surface);
+                memory.add("cache/surfaces", (unsigned long long)m_cache->getMemoryBytes());
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_memory_items = memory.getItems();
+            }
+
+            publishLevels(request_id, *surface, request.lodMaxError);
+        }
+    }
+}
+
+void SurfaceWorker::reportMemory(MemoryReport& report)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    report.add(m_memory_items);
+    report.add("worker/pending vertices", (unsigned long long)(m_back.vertices.capacity() + m_back.derivatives.capacity() + m_back.normals.capacity()) * sizeof(glm::vec3));
+    report.add("worker/pending faces", m_back.faces);
+}
+
+void SurfaceWorker::publish(unsigned int request_id, bool restart, bool finished)
+{
+    size_t firstNormal = m_tracer.updateNormals();
+
+    // The tracer is only touched by this thread, so its views can be copied straight into the
+    // back buffer: the geometry is copied exactly once on its way to the consumer
+    ArrayView<glm::vec3>    vertices    = m_tracer.viewVertices().sub(m_published_vertices);
+    ArrayView<glm::vec3>    derivatives = m_tracer.viewDerivatives().sub(m_published_vertices);
+    ArrayView<glm::vec3>    normals     = m_tracer.viewNormals().sub(firstNormal);
+    ArrayView<unsigned int> faces       = m_tracer.viewFaceIndices().sub(m_published_indices);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // A restart makes everything that was not fetched yet stale
+    if (restart){
+        m_back.clear();
+        m_back.restart = true;
+        m_back.seedingPoints = m_tracer.viewSeedingPoints().toVector();
+    }
+
+    m_back.vertices.insert(m_back.vertices.end(), vertices.begin(), vertices.end());
+    m_back.derivatives.insert(m_back.derivatives.end(), derivatives.begin(), derivatives.end());
+    m_back.faces.insert(m_back.faces.end(), faces.begin(), faces.end());
+    m_back.appendNormals(firstNormal, normals);
+    m_back.request_id = request_id;
+    m_back.finished = finished;
+    m_back_dirty = true;
+
+    m_published_vertices += vertices.size();
+    m_published_indices  += faces.size();
+}
+
+void SurfaceWorker::publishCached(unsigned int request_id, const SurfaceCache::Surface& surface)
+{
+    // Copy before taking the lock, which fetch() on the render thread waits for
+    Result result;
+    result.request_id    = request_id;
+    result.restart       = true;
+    result.finished      = true;
+    result.seedingPoints = surface.seedingPoints;
+    result.vertices      = surface.vertices;
+    result.derivatives   = surface.derivatives;
+    result.faces         = surface.faces;
+    result.normalsFirst  = 0;
+    result.normals       = surface.normals;
+
+    // The stale back buffer is swapped out and freed after the lock is released
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::swap(m_back, result);
+    m_back_dirty = true;
+}
+
+void SurfaceWorker::publishLevels(unsigned int request_id, const StreamTracer::SurfaceResult& surface, float maxError)
+{
+    PROFILE_ZONE("publishLevels");
+
+    // The full surface keeps its vertices; the seed curve is the first vertices and stays in every level
+    std::vector<MeshSimplifier::Level> simplified;
+    MeshSimplifier::buildLevels(surface.vertices, surface.faces, surface.seedingPoints.size(),
+                                m_lod_levels, m_lod_ratio, maxError, simplified, &m_cancel);
+
+    std::vector<Result::Level> levels(simplified.size() + 1);
+    for (size_t l = 0; l < levels.size() && !m_cancel; l++){
+        // The simplifier keeps the triangle order of the optimized surface, and the compact
+        // mesh lays the vertices out by first use, so the levels need no pass of their own
+        const std::vector<unsigned int>& faces = l == 0 ? surface.faces : simplified[l - 1].faces;
+
+        std::shared_ptr<CompactMesh> mesh(new CompactMesh);
+        mesh->build(surface.vertices, surface.derivatives, surface.normals, faces);
+
+        levels[l].mesh  = mesh;
+        levels[l].error = l == 0 ? 0.0f : simplified[l - 1].error;
+        levels[l].acmr  = MeshOptimizer::computeACMR(faces, surface.vertices.size());
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // A newer request makes the levels stale
+    if (m_cancel)
+        return;
+
+    m_back.request_id = request_id;
+    m_back.finished   = true;
+    m_back.levels     = levels;
+    m_back_dirty = true;
+}
@@ -0,0 +1,158 @@
+
+/**
+ *
+ * Background stream surface computation
+ *
+ * This class runs the surface generation of a StreamTracer on a worker thread.
+ * Every submitted request cancels the surface that is still being traced, and
+ * the generated geometry is handed back through a double-buffered result.
+ *
+ */
+
+#ifndef __SURFACE_WORKER__
+#define __SURFACE_WORKER__
+
+// STD
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "CompactMesh.h"
+#include "MemoryReport.h"
+#include "StreamTracer.h"
+#include "SurfaceCache.h"
+
+class SurfaceWorker
+{
+public:
+
+    /// A snapshot of everything a surface depends on.
+    struct Request
+    {
+        StreamTracer::SurfaceParameters parameters;
+        bool addition, remove, ripping;
+
+        // Largest estimated error of the levels of detail, in surface coordinates (0: no limit)
+        float lodMaxError;
+
+        // When set, the surface is also written to this file (.ply, .vtu or .obj) while it is traced,
+        // in traced order. A surface found in the cache is written from the cached copy, which holds
+        // the same triangles reordered for the GPU.
+        std::string exportFilename;
+    };
+
+    /// Geometry produced since the last fetch. Vertices and face indices continue
+    /// the ones fetched before, unless restart is set, in which case they start a
+    /// new surface and everything received earlier is stale.
+    ///
+    /// Normals change for earlier vertices too, as new triangles attach to the front:
+    /// normals holds the normals of the surface vertices [normalsFirst, normalsFirst + normals.size()).
+    ///
+    /// Once the last slice of a surface is out, its compact levels of detail follow, possibly
+    /// in a result of their own that carries no geometry.
+    struct Result
+    {
+        Result();
+        void clear();
+
+        /// Merge a later delta of the same surface into this one.
+        void append(const Result& delta);
+
+        /// Merge the normals of the vertices [first, first + values.size()), replacing older values.
+        void appendNormals(size_t first, ArrayView<glm::vec3> values);
+
+        unsigned int request_id;
+        bool restart;
+        bool finished;
+
+        std::vector< glm::vec3 >    seedingPoints;
+        std::vector< glm::vec3 >    vertices;
+        std::vector< glm::vec3 >    derivatives;
+        std::vector< unsigned int > faces;
+
+        size_t                      normalsFirst;
+        std::vector< glm::vec3 >    normals;
+
+        /// The finished surface in compact form, then coarser versions of it. The error is the
+        /// estimated distance to the full surface, in surface coordinates; acmr is the vertex
+        /// cache miss ratio of the triangle order.
+        struct Level
+        {
+            std::shared_ptr<const CompactMesh> mesh;
+            float error;
+            float acmr;
+        };
+        std::vector< Level >        levels;
+    };
+
+    SurfaceWorker(StreamTracer& tracer);
+    ~SurfaceWorker();
+
+    /// Start the worker thread. The tracer must not be used by anyone else afterwards.
+    void start();
+    void stop();
+
+    /// Queue a new surface and cancel the one in flight. Never blocks on tracing.
+    /// Returns the id that the results of this request will carry.
+    unsigned int submit(const Request& request);
+
+    /// Move the pending geometry into result. Returns false if nothing new arrived.
+    bool fetch(Result& result);
+
+    /// Serve requests from the cache and store every completed surface in it.
+    /// Must be called while the worker is stopped. NULL disables caching.
+    void setCache(SurfaceCache* cache, const std::string& datasetIdentity);
+
+    /// Add the bytes of the tracer and its surface as they were before the last finished surface
+    /// was handed over, of the cache and of the pending geometry.
+    void reportMemory(MemoryReport& report);
+
+    /// Wall-clock time traced between two hand-overs.
+    void setSliceMilliseconds(double milliseconds) { m_slice_milliseconds = milliseconds; }
+
+private:
+    void run();
+    void publish(unsigned int request_id, bool restart, bool finished);
+    void publishCached(unsigned int request_id, const SurfaceCache::Surface& surface);
+    void publishLevels(unsigned int request_id, const StreamTracer::SurfaceResult& surface, float maxError);
+
+    StreamTracer& m_tracer;
+    std::thread   m_thread;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+
+    Request             m_request;
+    unsigned int        m_request_id;
+    bool                m_request_pending;
+    bool                m_running;
+    std::atomic<bool>   m_cancel;
+
+    // Back buffer filled by the worker, swapped out by fetch()
+    Result  m_back;
+    bool    m_back_dirty;
+
+    // Amount of the current surface already handed over
+    size_t  m_published_vertices, m_published_indices;
+    double  m_slice_milliseconds;
+
+    // Levels of detail built for every finished surface
+    unsigned int m_lod_levels;
+    float        m_lod_ratio;
+
+    SurfaceCache* m_cache;
+    std::string   m_dataset_identity;
+
+    // Taken by the worker thread, which owns the tracer while it runs
+    std::vector<MemoryReport::Item> m_memory_items;
+};
+
+#endif
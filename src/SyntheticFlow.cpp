@@ -0,0 +1,569 @@
+#include "SyntheticFlow.h"
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Boost
+#include <boost/filesystem.hpp>
+
+// Stream Tracer
+#include "FieldTimeSeries.h"
+
+namespace
+{
+    const float PI = 3.14159265358979f;
+
+    // Cells generated and written per block
+    const size_t BLOCK_CELLS = 1 << 16;
+
+    // Steepness of the graded lattice; the cell size varies by cosh^2(GRADING / 2) per axis
+    const float GRADING = 4.0f;
+
+    // Six tetrahedra around the main diagonal of a box, corners indexed by x | y << 1 | z << 2
+    const int TETRAHEDRA[6][4] = {
+        { 0, 1, 3, 7 }, { 0, 1, 5, 7 }, { 0, 2, 3, 7 },
+        { 0, 2, 6, 7 }, { 0, 4, 5, 7 }, { 0, 4, 6, 7 }
+    };
+
+    // Swirling jet: axial peak velocity, core radius, swirl ratio and co-flow
+    const float JET_VELOCITY = 1.0f;
+    const float JET_RADIUS   = 0.25f;
+    const float JET_SWIRL    = 1.0f;
+    const float JET_COFLOW   = 0.1f;
+
+    float jetAngularVelocity(float rho2)
+    {
+        if (rho2 < 1e-8f)
+            return JET_SWIRL * JET_VELOCITY / JET_RADIUS;
+        return JET_SWIRL * JET_VELOCITY * JET_RADIUS * (1.0f - std::exp(-rho2 / (JET_RADIUS * JET_RADIUS))) / rho2;
+    }
+
+    float jetAxialVelocity(float rho2)
+    {
+        return JET_VELOCITY * std::exp(-rho2 / (JET_RADIUS * JET_RADIUS)) + JET_COFLOW;
+    }
+
+    void foamHeader(std::ostream& out, const char* className, const char* location, const char* object)
+    {
+        out << "FoamFile\n{\n"
+            << "    version     2.0;\n"
+            << "    format      ascii;\n"
+            << "    class       " << className << ";\n"
+            << "    location    \"" << location << "\";\n"
+            << "    object      " << object << ";\n"
+            << "}\n\n";
+    }
+
+    /// Visit all faces of an nx * ny * nz box lattice in OpenFOAM order: internal faces sorted
+    /// by owner and neighbour, then the boundary. Points are ordered so the normal leaves the owner.
+    template<typename Visitor>
+    void forEachFace(const size_t dims[3], Visitor visit)
+    {
+        const size_t nx = dims[0], ny = dims[1], nz = dims[2];
+        const size_t px = nx + 1, py = ny + 1;
+
+        struct Index
+        {
+            size_t px, py;
+            size_t operator()(size_t i, size_t j, size_t k) const { return i + px * (j + py * k); }
+        } P = { px, py };
+
+        size_t face[4];
+
+        for (size_t k = 0; k < nz; k++)
+        for (size_t j = 0; j < ny; j++)
+        for (size_t i = 0; i < nx; i++){
+            size_t c = i + nx * (j + ny * k);
+            if (i + 1 < nx){
+                face[0] = P(i+1, j, k); face[1] = P(i+1, j+1, k); face[2] = P(i+1, j+1, k+1); face[3] = P(i+1, j, k+1);
+                visit(face, c, (long long)(c + 1));
+            }
+            if (j + 1 < ny){
+                face[0] = P(i, j+1, k); face[1] = P(i, j+1, k+1); face[2] = P(i+1, j+1, k+1); face[3] = P(i+1, j+1, k);
+                visit(face, c, (long long)(c + nx));
+            }
+            if (k + 1 < nz){
+                face[0] = P(i, j, k+1); face[1] = P(i+1, j, k+1); face[2] = P(i+1, j+1, k+1); face[3] = P(i, j+1, k+1);
+                visit(face, c, (long long)(c + nx * ny));
+            }
+        }
+
+        // Boundary: -x, +x, -y, +y, -z, +z
+        for (size_t k = 0; k < nz; k++)
+        for (size_t j = 0; j < ny; j++){
+            face[0] = P(0, j, k); face[1] = P(0, j, k+1); face[2] = P(0, j+1, k+1); face[3] = P(0, j+1, k);
+            visit(face, nx * (j + ny * k), -1LL);
+        }
+        for (size_t k = 0; k < nz; k++)
+        for (size_t j = 0; j < ny; j++){
+            face[0] = P(nx, j, k); face[1] = P(nx, j+1, k); face[2] = P(nx, j+1, k+1); face[3] = P(nx, j, k+1);
+            visit(face, nx - 1 + nx * (j + ny * k), -1LL);
+        }
+        for (size_t k = 0; k < nz; k++)
+        for (size_t i = 0; i < nx; i++){
+            face[0] = P(i, 0, k); face[1] = P(i+1, 0, k); face[2] = P(i+1, 0, k+1); face[3] = P(i, 0, k+1);
+            visit(face, i + nx * ny * k, -1LL);
+        }
+        for (size_t k = 0; k < nz; k++)
+        for (size_t i = 0; i < nx; i++){
+            face[0] = P(i, ny, k); face[1] = P(i, ny, k+1); face[2] = P(i+1, ny, k+1); face[3] = P(i+1, ny, k);
+            visit(face, i + nx * (ny - 1 + ny * k), -1LL);
+        }
+        for (size_t j = 0; j < ny; j++)
+        for (size_t i = 0; i < nx; i++){
+            face[0] = P(i, j, 0); face[1] = P(i, j+1, 0); face[2] = P(i+1, j+1, 0); face[3] = P(i+1, j, 0);
+            visit(face, i + nx * j, -1LL);
+        }
+        for (size_t j = 0; j < ny; j++)
+        for (size_t i = 0; i < nx; i++){
+            face[0] = P(i, j, nz); face[1] = P(i+1, j, nz); face[2] = P(i+1, j+1, nz); face[3] = P(i, j+1, nz);
+            visit(face, i + nx * (j + ny * (nz - 1)), -1LL);
+        }
+    }
+}
+
+SyntheticFlow::SyntheticFlow(Flow flow, Mesh mesh, size_t targetCells, float size, float time)
+    : m_flow(flow)
+    , m_mesh(mesh)
+    , m_time(time)
+{
+    float min[3], max[3];
+    switch (flow){
+    default:
+    case FLOW_ABC:
+        min[0] = min[1] = min[2] = 0.0f;
+        max[0] = max[1] = max[2] = 2.0f * PI;
+        break;
+    case FLOW_HILL_VORTEX:
+        min[0] = min[1] = min[2] = -2.0f;
+        max[0] = max[1] = max[2] = 2.0f;
+        break;
+    case FLOW_DOUBLE_GYRE:
+        min[0] = min[1] = min[2] = 0.0f;
+        max[0] = 2.0f; max[1] = 1.0f; max[2] = 1.0f;
+        break;
+    case FLOW_SWIRLING_JET:
+        min[0] = min[1] = -1.0f; min[2] = 0.0f;
+        max[0] = max[1] = 1.0f;  max[2] = 4.0f;
+        break;
+    }
+
+    // Scale the longest side to the requested size
+    m_scale = size / std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
+    for (int a = 0; a < 3; a++){
+        min[a] *= m_scale;
+        max[a] *= m_scale;
+    }
+    m_domain = AABB(min, max);
+
+    // Lattice resolution proportional to the domain extents
+    double boxes = (double)targetCells / (mesh == MESH_TETRAHEDRAL ? 6.0 : 1.0);
+    double volume = (double)(max[0] - min[0]) * (max[1] - min[1]) * (max[2] - min[2]);
+    double density = std::cbrt(boxes / volume);
+    for (int a = 0; a < 3; a++)
+        m_dims[a] = std::max((size_t)1, (size_t)(density * (max[a] - min[a]) + 0.5));
+}
+
+bool SyntheticFlow::flowFromName(const std::string& name, Flow& flow)
+{
+    if (name == "abc")          flow = FLOW_ABC;
+    else if (name == "hill")    flow = FLOW_HILL_VORTEX;
+    else if (name == "gyre")    flow = FLOW_DOUBLE_GYRE;
+    else if (name == "jet")     flow = FLOW_SWIRLING_JET;
+    else                        return false;
+    return true;
+}
+
+bool SyntheticFlow::meshFromName(const std::string& name, Mesh& mesh)
+{
+    if (name == "hex")          mesh = MESH_HEXAHEDRAL;
+    else if (name == "tet")     mesh = MESH_TETRAHEDRAL;
+    else if (name == "graded")  mesh = MESH_GRADED;
+    else                        return false;
+    return true;
+}
+
+glm::vec3 SyntheticFlow::velocity(const glm::vec3& point) const
+{
+    return velocity(point, m_time);
+}
+
+glm::vec3 SyntheticFlow::velocity(const glm::vec3& point, float time) const
+{
+    // Scaling positions and velocities alike keeps the streamlines and their timing
+    return m_scale * naturalVelocity(point / m_scale, time);
+}
+
+glm::vec3 SyntheticFlow::naturalVelocity(const glm::vec3& p, float time) const
+{
+    switch (m_flow){
+    case FLOW_ABC: {
+        const float A = std::sqrt(3.0f), B = std::sqrt(2.0f), C = 1.0f;
+        return glm::vec3(A * std::sin(p.z) + C * std::cos(p.y),
+                         B * std::sin(p.x) + A * std::cos(p.z),
+                         C * std::sin(p.y) + B * std::cos(p.x));
+    }
+    case FLOW_HILL_VORTEX: {
+        // Unit radius and stream velocity, in the frame of the vortex
+        float rho2 = p.x * p.x + p.y * p.y;
+        float r2   = rho2 + p.z * p.z;
+        if (r2 < 1.0f)
+            return 1.5f * glm::vec3(p.x * p.z, p.y * p.z, 1.0f - 2.0f * rho2 - p.z * p.z);
+
+        float r3 = r2 * std::sqrt(r2);
+        float r5 = r3 * r2;
+        return glm::vec3(1.5f * p.x * p.z / r5,
+                         1.5f * p.y * p.z / r5,
+                         -(1.0f - 1.0f / r3) - 1.5f * rho2 / r5);
+    }
+    case FLOW_DOUBLE_GYRE: {
+        const float A = 0.1f, EPSILON = 0.25f, OMEGA = 2.0f * PI / 10.0f;
+        float a = EPSILON * std::sin(OMEGA * time);
+        float b = 1.0f - 2.0f * a;
+        float f = a * p.x * p.x + b * p.x;
+        float dfdx = 2.0f * a * p.x + b;
+        return glm::vec3(-PI * A * std::sin(PI * f) * std::cos(PI * p.y),
+                          PI * A * std::cos(PI * f) * std::sin(PI * p.y) * dfdx,
+                          0.0f);
+    }
+    case FLOW_SWIRLING_JET: {
+        float rho2 = p.x * p.x + p.y * p.y;
+        float omega = jetAngularVelocity(rho2);
+        return glm::vec3(-omega * p.y, omega * p.x, jetAxialVelocity(rho2));
+    }
+    }
+    return glm::vec3(0.0f);
+}
+
+bool SyntheticFlow::advect(const glm::vec3& point, float duration, glm::vec3& result) const
+{
+    // Helices around the jet axis
+    if (m_flow == FLOW_SWIRLING_JET){
+        glm::vec3 q = point / m_scale;
+        float rho2  = q.x * q.x + q.y * q.y;
+        float angle = jetAngularVelocity(rho2) * duration;
+        float c = std::cos(angle), s = std::sin(angle);
+        result = m_scale * glm::vec3(c * q.x - s * q.y, s * q.x + c * q.y, q.z + jetAxialVelocity(rho2) * duration);
+        return m_domain.contains(&result.x);
+    }
+
+    return integrate(point, m_time, duration, false, result);
+}
+
+bool SyntheticFlow::advectPath(const glm::vec3& point, float startTime, float duration, glm::vec3& result) const
+{
+    if (!isUnsteady())
+        return advect(point, duration, result);
+
+    return integrate(point, startTime, duration, true, result);
+}
+
+bool SyntheticFlow::integrate(const glm::vec3& point, float startTime, float duration, bool unsteady, glm::vec3& result) const
+{
+    glm::vec3 extent(m_domain.max[0] - m_domain.min[0], m_domain.max[1] - m_domain.min[1], m_domain.max[2] - m_domain.min[2]);
+    float step = 1e-4f * glm::length(extent);
+    size_t steps = std::max((size_t)1, (size_t)std::ceil(std::fabs(duration) / step));
+    float h = duration / steps;
+
+    glm::vec3 p = point;
+    for (size_t s = 0; s < steps; s++){
+        float t = unsteady ? startTime + s * h : startTime;
+        float dt = unsteady ? h : 0.0f;
+        glm::vec3 k1 = velocity(p, t);
+        glm::vec3 k2 = velocity(p + 0.5f * h * k1, t + 0.5f * dt);
+        glm::vec3 k3 = velocity(p + 0.5f * h * k2, t + 0.5f * dt);
+        glm::vec3 k4 = velocity(p + h * k3, t + dt);
+        p += (h / 6.0f) * (k1 + 2.0f * k2 + 2.0f * k3 + k4);
+
+        if (!m_domain.contains(&p.x))
+            return false;
+    }
+
+    result = p;
+    return true;
+}
+
+size_t SyntheticFlow::getCellCount() const
+{
+    return m_dims[0] * m_dims[1] * m_dims[2] * (m_mesh == MESH_TETRAHEDRAL ? 6 : 1);
+}
+
+size_t SyntheticFlow::getPointCount() const
+{
+    return (m_dims[0] + 1) * (m_dims[1] + 1) * (m_dims[2] + 1);
+}
+
+float SyntheticFlow::lattice(int axis, size_t i) const
+{
+    float u = (float)i / (float)m_dims[axis];
+    if (m_mesh == MESH_GRADED)
+        u = 0.5f + std::tanh(GRADING * (u - 0.5f)) / (2.0f * std::tanh(0.5f * GRADING));
+
+    // Snap the last plane onto the domain boundary
+    return i == m_dims[axis] ? m_domain.max[axis] : m_domain.min[axis] + u * (m_domain.max[axis] - m_domain.min[axis]);
+}
+
+glm::vec3 SyntheticFlow::latticePoint(size_t i, size_t j, size_t k) const
+{
+    return glm::vec3(lattice(0, i), lattice(1, j), lattice(2, k));
+}
+
+void SyntheticFlow::cell(size_t c, AABB& box, glm::vec3& centroid) const
+{
+    size_t cube = m_mesh == MESH_TETRAHEDRAL ? c / 6 : c;
+    size_t i = cube % m_dims[0];
+    size_t j = (cube / m_dims[0]) % m_dims[1];
+    size_t k = cube / (m_dims[0] * m_dims[1]);
+
+    glm::vec3 corners[8];
+    for (int b = 0; b < 8; b++)
+        corners[b] = latticePoint(i + (b & 1), j + ((b >> 1) & 1), k + ((b >> 2) & 1));
+
+    box = AABB();
+    centroid = glm::vec3(0.0f);
+
+    if (m_mesh == MESH_TETRAHEDRAL){
+        const int* tetrahedron = TETRAHEDRA[c % 6];
+        for (int v = 0; v < 4; v++){
+            box.extend(&corners[tetrahedron[v]].x);
+            centroid += corners[tetrahedron[v]];
+        }
+        centroid *= 0.25f;
+    }
+    else {
+        for (int b = 0; b < 8; b++){
+            box.extend(&corners[b].x);
+            centroid += corners[b];
+        }
+        centroid *= 0.125f;
+    }
+}
+
+bool SyntheticFlow::writeBinary(const std::string& filename) const
+{
+    std::string path = filename + ".bin";
+    std::ofstream out(path.c_str(), std::ios_base::binary);
+    if (!out){
+        std::cout << "SyntheticFlow: cannot write " << path << std::endl;
+        return false;
+    }
+
+    const size_t nCells  = getCellCount();
+    const size_t nPoints = getPointCount();
+
+    std::cout << "SyntheticFlow: writing " << nCells << " cells to " << path << std::endl;
+
+    // Same layout as StreamTracer::saveBinary: counts, then boxes, points and cell vectors
+    out << nCells << std::endl;
+    out << nPoints << std::endl;
+    out << nCells << std::endl;
+
+    std::vector<AABB> boxes;
+    for (size_t first = 0; first < nCells && out; first += BLOCK_CELLS){
+        size_t count = std::min(BLOCK_CELLS, nCells - first);
+        boxes.resize(count);
+
+        #pragma omp parallel for schedule(static)
+        for (int c = 0; c < (int)count; c++){
+            glm::vec3 centroid;
+            cell(first + c, boxes[c], centroid);
+        }
+        out.write((const char*)&boxes[0], sizeof(AABB) * count);
+    }
+
+    std::vector<glm::vec3> points;
+    const size_t px = m_dims[0] + 1, py = m_dims[1] + 1;
+    for (size_t first = 0; first < nPoints && out; first += BLOCK_CELLS){
+        size_t count = std::min(BLOCK_CELLS, nPoints - first);
+        points.resize(count);
+
+        for (size_t p = 0; p < count; p++){
+            size_t index = first + p;
+            points[p] = latticePoint(index % px, (index / px) % py, index / (px * py));
+        }
+        out.write((const char*)&points[0], sizeof(glm::vec3) * count);
+    }
+
+    std::vector<glm::vec3> vectors;
+    for (size_t first = 0; first < nCells && out; first += BLOCK_CELLS){
+        size_t count = std::min(BLOCK_CELLS, nCells - first);
+        vectors.resize(count);
+
+        #pragma omp parallel for schedule(static)
+        for (int c = 0; c < (int)count; c++){
+            AABB box;
+            glm::vec3 centroid;
+            cell(first + c, box, centroid);
+            vectors[c] = velocity(centroid);
+        }
+        out.write((const char*)&vectors[0], sizeof(glm::vec3) * count);
+    }
+
+    if (!out)
+        std::cout << "SyntheticFlow: writing " << path << " failed" << std::endl;
+    return !!out;
+}
+
+bool SyntheticFlow::writeTimeStep(const std::string& filename, size_t step) const
+{
+    std::string path = FieldTimeSeries::stepPath(filename, step);
+    std::ofstream out(path.c_str(), std::ios_base::binary);
+    if (!out){
+        std::cout << "SyntheticFlow: cannot write " << path << std::endl;
+        return false;
+    }
+
+    const size_t nCells = getCellCount();
+
+    // Same layout as FieldTimeSeries::saveVelocities: the count, then the cell vectors
+    out << nCells << std::endl;
+
+    std::vector<glm::vec3> vectors;
+    for (size_t first = 0; first < nCells && out; first += BLOCK_CELLS){
+        size_t count = std::min(BLOCK_CELLS, nCells - first);
+        vectors.resize(count);
+
+        #pragma omp parallel for schedule(static)
+        for (int c = 0; c < (int)count; c++){
+            AABB box;
+            glm::vec3 centroid;
+            cell(first + c, box, centroid);
+            vectors[c] = velocity(centroid);
+        }
+        out.write((const char*)&vectors[0], sizeof(glm::vec3) * count);
+    }
+
+    if (!out)
+        std::cout << "SyntheticFlow: writing " << path << " failed" << std::endl;
+    return !!out;
+}
+
+bool SyntheticFlow::writeOpenFOAM(const std::string& filename) const
+{
+    if (m_mesh == MESH_TETRAHEDRAL){
+        std::cout << "SyntheticFlow: OpenFOAM cases are only written for hexahedral and graded meshes" << std::endl;
+        return false;
+    }
+
+    boost::filesystem::path root = boost::filesystem::path(filename).parent_path();
+    if (root.empty())
+        root = ".";
+
+    boost::system::error_code error;
+    boost::filesystem::create_directories(root / "constant" / "polyMesh", error);
+    boost::filesystem::create_directories(root / "system", error);
+    boost::filesystem::create_directories(root / "0", error);
+    if (error){
+        std::cout << "SyntheticFlow: cannot create the case in " << root.string() << std::endl;
+        return false;
+    }
+
+    const size_t nx = m_dims[0], ny = m_dims[1], nz = m_dims[2];
+    const size_t nCells    = getCellCount();
+    const size_t nPoints   = getPointCount();
+    const size_t nInternal = (nx - 1) * ny * nz + nx * (ny - 1) * nz + nx * ny * (nz - 1);
+    const size_t nBoundary = 2 * (ny * nz + nx * nz + nx * ny);
+
+    boost::filesystem::path mesh = root / "constant" / "polyMesh";
+    bool ok = true;
+
+    {
+        std::ofstream out((mesh / "points").string().c_str());
+        foamHeader(out, "vectorField", "constant/polyMesh", "points");
+        out << nPoints << "\n(\n";
+        const size_t px = nx + 1, py = ny + 1;
+        for (size_t p = 0; p < nPoints; p++){
+            glm::vec3 point = latticePoint(p % px, (p / px) % py, p / (px * py));
+            out << '(' << point.x << ' ' << point.y << ' ' << point.z << ")\n";
+        }
+        out << ")\n";
+        ok = ok && !!out;
+    }
+
+    {
+        std::ofstream out((mesh / "faces").string().c_str());
+        foamHeader(out, "faceList", "constant/polyMesh", "faces");
+        out << nInternal + nBoundary << "\n(\n";
+        forEachFace(m_dims, [&out](const size_t face[4], size_t, long long){
+            out << "4(" << face[0] << ' ' << face[1] << ' ' << face[2] << ' ' << face[3] << ")\n";
+        });
+        out << ")\n";
+        ok = ok && !!out;
+    }
+
+    {
+        std::ofstream out((mesh / "owner").string().c_str());
+        foamHeader(out, "labelList", "constant/polyMesh", "owner");
+        out << nInternal + nBoundary << "\n(\n";
+        forEachFace(m_dims, [&out](const size_t*, size_t owner, long long){
+            out << owner << '\n';
+        });
+        out << ")\n";
+        ok = ok && !!out;
+    }
+
+    {
+        std::ofstream out((mesh / "neighbour").string().c_str());
+        foamHeader(out, "labelList", "constant/polyMesh", "neighbour");
+        out << nInternal << "\n(\n";
+        forEachFace(m_dims, [&out](const size_t*, size_t, long long neighbour){
+            if (neighbour >= 0)
+                out << neighbour << '\n';
+        });
+        out << ")\n";
+        ok = ok && !!out;
+    }
+
+    {
+        std::ofstream out((mesh / "boundary").string().c_str());
+        foamHeader(out, "polyBoundaryMesh", "constant/polyMesh", "boundary");
+        out << "1\n(\n    walls\n    {\n"
+            << "        type            wall;\n"
+            << "        nFaces          " << nBoundary << ";\n"
+            << "        startFace       " << nInternal << ";\n"
+            << "    }\n)\n";
+        ok = ok && !!out;
+    }
+
+    {
+        std::ofstream out((root / "0" / "U").string().c_str());
+        foamHeader(out, "volVectorField", "0", "U");
+        out << "dimensions      [0 1 -1 0 0 0 0];\n\n"
+            << "internalField   nonuniform List<vector>\n" << nCells << "\n(\n";
+        for (size_t c = 0; c < nCells; c++){
+            AABB box;
+            glm::vec3 centroid;
+            cell(c, box, centroid);
+            glm::vec3 u = velocity(centroid);
+            out << '(' << u.x << ' ' << u.y << ' ' << u.z << ")\n";
+        }
+        out << ");\n\nboundaryField\n{\n    walls\n    {\n        type            zeroGradient;\n    }\n}\n";
+        ok = ok && !!out;
+    }
+
+    {
+        std::ofstream out((root / "system" / "controlDict").string().c_str());
+        foamHeader(out, "dictionary", "system", "controlDict");
+        out << "application     none;\n"
+            << "startFrom       startTime;\n"
+            << "startTime       0;\n"
+            << "stopAt          endTime;\n"
+            << "endTime         0;\n"
+            << "deltaT          1;\n"
+            << "writeControl    timeStep;\n"
+            << "writeInterval   1;\n";
+        ok = ok && !!out;
+    }
+
+    // The reader opens the case through an empty marker file
+    std::ofstream marker(filename.c_str());
+    ok = ok && !!marker;
+
+    if (!ok)
+        std::cout << "SyntheticFlow: writing the OpenFOAM case " << root.string() << " failed" << std::endl;
+    return ok;
+}
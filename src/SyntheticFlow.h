@@ -0,0 +1,113 @@
+
+/**
+ *
+ * Synthetic analytic flows
+ *
+ * This class samples closed-form velocity fields on generated meshes and writes
+ * them as datasets, so that scaling tests do not depend on proprietary data and
+ * traced surfaces can be compared against the exact flow.
+ *
+ * Flows:
+ *   ABC            Arnold-Beltrami-Childress flow on [0, 2pi]^3 (A = sqrt 3, B = sqrt 2, C = 1)
+ *   Hill's vortex  spherical vortex of radius 1 in a uniform stream along -z, on [-2, 2]^3
+ *   double gyre    the Shadden double gyre on [0, 2] x [0, 1], extruded along z
+ *   swirling jet   a Batchelor q-vortex along z: Gaussian axial jet with a Lamb-Oseen swirl
+ *
+ * Meshes:
+ *   hexahedral     a uniform lattice of boxes
+ *   tetrahedral    the same lattice with every box split into six tetrahedra
+ *   graded         a lattice refined towards the domain boundary, cells vary ~14x per axis
+ *
+ * Domains are scaled so that their longest side has the requested size (0.1 by
+ * default, which suits the tracer's default step size and acceleration grid);
+ * velocities are scaled alike, so streamlines keep their shape and timing.
+ * Velocities are stored per cell at its centroid, like the cell data read from
+ * OpenFOAM. The tetrahedra of a box all span the whole box, so their bounds
+ * overlap six-fold. The lattice resolution follows the domain aspect ratio; the
+ * cell count is approximate. Datasets are written block by block and
+ * regenerated on the fly, so the memory needed does not grow with the mesh.
+ *
+ */
+
+#ifndef __SYNTHETIC_FLOW__
+#define __SYNTHETIC_FLOW__
+
+// STD
+#include <string>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "AABB.h"
+
+class SyntheticFlow
+{
+public:
+
+    enum Flow { FLOW_ABC, FLOW_HILL_VORTEX, FLOW_DOUBLE_GYRE, FLOW_SWIRLING_JET };
+    enum Mesh { MESH_HEXAHEDRAL, MESH_TETRAHEDRAL, MESH_GRADED };
+
+    /// The size is the longest side of the domain. The time selects the phase of the
+    /// (unsteady) double gyre; the other flows are steady.
+    SyntheticFlow(Flow flow, Mesh mesh, size_t targetCells, float size = 0.1f, float time = 0.0f);
+
+    /// abc, hill, gyre, jet / hex, tet, graded
+    static bool flowFromName(const std::string& name, Flow& flow);
+    static bool meshFromName(const std::string& name, Mesh& mesh);
+
+    /// The time of the field that is sampled and written.
+    void setTime(float time) { m_time = time; }
+    float getTime() const { return m_time; }
+    bool isUnsteady() const { return m_flow == FLOW_DOUBLE_GYRE; }
+
+    /// The analytic velocity at a point, at the time of the field or at the given time.
+    glm::vec3 velocity(const glm::vec3& point) const;
+    glm::vec3 velocity(const glm::vec3& point, float time) const;
+
+    /// Where a particle released at the point is after the given time, in the field frozen at its
+    /// time: closed form for the swirling jet, fine fourth-order Runge-Kutta otherwise. Returns
+    /// false if it leaves the domain.
+    bool advect(const glm::vec3& point, float duration, glm::vec3& result) const;
+
+    /// The same along the pathline of a particle released at startTime, for the unsteady flows.
+    bool advectPath(const glm::vec3& point, float startTime, float duration, glm::vec3& result) const;
+
+    const AABB& getDomain() const { return m_domain; }
+    size_t getCellCount() const;
+    size_t getPointCount() const;
+
+    /// Write the binary cache that StreamTracer::loadOpenFOAM(filename) reads, i.e. <filename>.bin.
+    bool writeBinary(const std::string& filename) const;
+
+    /// Write the velocities at the time of the field as a time step of the dataset
+    /// (FieldTimeSeries::stepPath). The step times go to FieldTimeSeries::saveTimes.
+    bool writeTimeStep(const std::string& filename, size_t step) const;
+
+    /// Write an ASCII OpenFOAM case into the directory of the (empty) .foam file: constant/polyMesh,
+    /// 0/U and system/controlDict. Hexahedral and graded meshes only.
+    bool writeOpenFOAM(const std::string& filename) const;
+
+private:
+    /// Velocity in the unscaled domain of the flow.
+    glm::vec3 naturalVelocity(const glm::vec3& point, float time) const;
+
+    /// Runge-Kutta integration from startTime; the field stays at startTime unless unsteady.
+    bool integrate(const glm::vec3& point, float startTime, float duration, bool unsteady, glm::vec3& result) const;
+
+    /// Coordinate of lattice plane i along an axis.
+    float lattice(int axis, size_t i) const;
+    glm::vec3 latticePoint(size_t i, size_t j, size_t k) const;
+
+    /// Bounds and centroid of a cell.
+    void cell(size_t c, AABB& box, glm::vec3& centroid) const;
+
+    Flow   m_flow;
+    Mesh   m_mesh;
+    float  m_time;
+    float  m_scale;
+    AABB   m_domain;
+    size_t m_dims[3];
+};
+
+#endif
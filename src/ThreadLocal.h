@@ -0,0 +1,23 @@
+
+/**
+ *
+ * Thread-local storage
+ *
+ * thread_local is not available on all supported compilers, but the compiler
+ * extensions work for POD variables, e.g. a pointer to a block its thread
+ * allocates on first use:
+ *
+ *   THREAD_LOCAL Counters* t_counters = NULL;
+ *
+ */
+
+#ifndef __THREAD_LOCAL__
+#define __THREAD_LOCAL__
+
+#ifdef _MSC_VER
+#    define THREAD_LOCAL __declspec(thread)
+#else
+#    define THREAD_LOCAL __thread
+#endif
+
+#endif
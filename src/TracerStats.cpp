@@ -0,0 +1,196 @@
+#include "TracerStats.h"
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+// Stream Tracer
+#include "JsonWriter.h"
+#include "ThreadLocal.h"
+
+namespace
+{
+    // Longest front size series; when full, every other sample is dropped
+    const size_t MAX_FRONT_SAMPLES = 4096;
+
+    // One block per thread that ever counted; snapshot() sums them, reset() clears them
+    std::mutex                  g_locals_mutex;
+    std::vector<TracerStats::Local*> g_locals;
+
+    THREAD_LOCAL TracerStats::Local* t_local = NULL;
+
+    std::mutex                               g_series_mutex;
+    std::vector<TracerStats::FrontSample>    g_series;
+    std::chrono::steady_clock::time_point    g_series_start = std::chrono::steady_clock::now();
+    unsigned long long                       g_series_calls = 0;
+    unsigned long long                       g_series_stride = 1;
+}
+
+TracerStats::Local::Local()
+{
+    clear();
+}
+
+void TracerStats::Local::clear()
+{
+    for (int c = 0; c < COUNTER_COUNT; c++)
+        m_counters[c].store(0, std::memory_order_relaxed);
+    for (int m = 0; m < MAXIMUM_COUNT; m++)
+        m_maxima[m].store(0, std::memory_order_relaxed);
+    for (int h = 0; h < HISTOGRAM_COUNT; h++){
+        for (unsigned int b = 0; b < BINS; b++)
+            m_histograms[h][b].store(0, std::memory_order_relaxed);
+        m_sums[h].store(0, std::memory_order_relaxed);
+    }
+}
+
+TracerStats::Local& TracerStats::local()
+{
+    if (!t_local){
+        std::lock_guard<std::mutex> lock(g_locals_mutex);
+        t_local = new Local();
+        g_locals.push_back(t_local);
+    }
+    return *t_local;
+}
+
+void TracerStats::sampleFrontSize(unsigned int ribbons)
+{
+    std::lock_guard<std::mutex> lock(g_series_mutex);
+
+    if (g_series_calls++ % g_series_stride != 0)
+        return;
+
+    if (g_series.size() == MAX_FRONT_SAMPLES){
+        for (size_t s = 0; s < g_series.size() / 2; s++)
+            g_series[s] = g_series[2 * s];
+        g_series.resize(g_series.size() / 2);
+        g_series_stride *= 2;
+    }
+
+    FrontSample sample;
+    sample.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - g_series_start).count();
+    sample.ribbons = ribbons;
+    g_series.push_back(sample);
+}
+
+void TracerStats::snapshot(Snapshot& snapshot, bool withSeries)
+{
+    std::fill(&snapshot.counters[0], &snapshot.counters[0] + COUNTER_COUNT, 0ULL);
+    std::fill(&snapshot.maxima[0], &snapshot.maxima[0] + MAXIMUM_COUNT, 0ULL);
+    std::fill(&snapshot.histograms[0][0], &snapshot.histograms[0][0] + HISTOGRAM_COUNT * BINS, 0ULL);
+    std::fill(&snapshot.sums[0], &snapshot.sums[0] + HISTOGRAM_COUNT, 0ULL);
+
+    {
+        std::lock_guard<std::mutex> lock(g_locals_mutex);
+        for (size_t l = 0; l < g_locals.size(); l++){
+            const Local& local = *g_locals[l];
+
+            for (int c = 0; c < COUNTER_COUNT; c++)
+                snapshot.counters[c] += local.m_counters[c].load(std::memory_order_relaxed);
+            for (int m = 0; m < MAXIMUM_COUNT; m++)
+                snapshot.maxima[m] = std::max(snapshot.maxima[m], local.m_maxima[m].load(std::memory_order_relaxed));
+            for (int h = 0; h < HISTOGRAM_COUNT; h++){
+                for (unsigned int b = 0; b < BINS; b++)
+                    snapshot.histograms[h][b] += local.m_histograms[h][b].load(std::memory_order_relaxed);
+                snapshot.sums[h] += local.m_sums[h].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    snapshot.frontSizes.clear();
+    if (withSeries){
+        std::lock_guard<std::mutex> lock(g_series_mutex);
+        snapshot.frontSizes = g_series;
+    }
+}
+
+void TracerStats::reset()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_locals_mutex);
+        for (size_t l = 0; l < g_locals.size(); l++)
+            g_locals[l]->clear();
+    }
+
+    std::lock_guard<std::mutex> lock(g_series_mutex);
+    g_series.clear();
+    g_series_start  = std::chrono::steady_clock::now();
+    g_series_calls  = 0;
+    g_series_stride = 1;
+}
+
+unsigned long long TracerStats::Snapshot::samples(Histogram histogram) const
+{
+    unsigned long long count = 0;
+    for (unsigned int b = 0; b < BINS; b++)
+        count += histograms[histogram][b];
+    return count;
+}
+
+double TracerStats::Snapshot::mean(Histogram histogram) const
+{
+    unsigned long long count = samples(histogram);
+    return count > 0 ? (double)sums[histogram] / (double)count : 0.0;
+}
+
+const char* TracerStats::name(Counter counter)
+{
+    static const char* names[COUNTER_COUNT] = {
+        "derivate_calls", "derivate_outside", "ribbon_calls", "zero_velocity_exits",
+        "additions", "rips", "vertices_emitted", "triangles_emitted"
+    };
+    return names[counter];
+}
+
+const char* TracerStats::name(Maximum maximum)
+{
+    static const char* names[MAXIMUM_COUNT] = { "max_candidates", "max_recursion_depth", "max_front_size" };
+    return names[maximum];
+}
+
+const char* TracerStats::name(Histogram histogram)
+{
+    static const char* names[HISTOGRAM_COUNT] = { "candidates", "recursion_depth", "front_size" };
+    return names[histogram];
+}
+
+void TracerStats::writeJson(JsonWriter& json, const Snapshot& snapshot)
+{
+    json.beginObject();
+
+    for (int c = 0; c < COUNTER_COUNT; c++)
+        json.key(name((Counter)c)).value(snapshot.counters[c]);
+    for (int m = 0; m < MAXIMUM_COUNT; m++)
+        json.key(name((Maximum)m)).value(snapshot.maxima[m]);
+
+    // Bins up to the last non-empty one; bin b > 0 starts at 2^(b-1)
+    json.key("histograms").beginObject();
+    for (int h = 0; h < HISTOGRAM_COUNT; h++){
+        unsigned int used = BINS;
+        while (used > 0 && snapshot.histograms[h][used - 1] == 0)
+            used--;
+
+        json.key(name((Histogram)h)).beginObject();
+        json.key("samples").value(snapshot.samples((Histogram)h));
+        json.key("mean").value(snapshot.mean((Histogram)h));
+        json.key("bins").beginArray();
+        for (unsigned int b = 0; b < used; b++)
+            json.value(snapshot.histograms[h][b]);
+        json.endArray();
+        json.endObject();
+    }
+    json.endObject();
+
+    json.key("front_size_series").beginArray();
+    for (size_t s = 0; s < snapshot.frontSizes.size(); s++){
+        json.beginArray();
+        json.value(snapshot.frontSizes[s].milliseconds);
+        json.value(snapshot.frontSizes[s].ribbons);
+        json.endArray();
+    }
+    json.endArray();
+
+    json.endObject();
+}
@@ -0,0 +1,147 @@
+
+/**
+ *
+ * Tracer statistics
+ *
+ * This class counts what the tracer does: field lookups, the candidate lists
+ * of the acceleration grid, zero-velocity exits, ribbon additions and rips,
+ * the recursion depth of traceRibbon, the size of the advancing front and the
+ * geometry emitted. These are the numbers to look at when tuning the grid
+ * resolution and the step size.
+ *
+ * Every thread counts into its own block, so counting costs one thread-local
+ * lookup and a few plain stores; snapshot() sums the blocks of all threads on
+ * demand. Histograms use power-of-two bins: bin 0 counts zeros, bin b > 0 the
+ * values in [2^(b-1), 2^b). The front size is also kept as a short series over
+ * time, sampled by the surfaces while they advance.
+ *
+ * reset() clears everything and should only be called while no surface is traced.
+ *
+ */
+
+#ifndef __TRACER_STATS__
+#define __TRACER_STATS__
+
+// STD
+#include <atomic>
+#include <vector>
+
+class JsonWriter;
+
+class TracerStats
+{
+public:
+
+    enum Counter {
+        DERIVATE_CALLS,         // field lookups
+        DERIVATE_OUTSIDE,       // lookups outside the domain or in empty grid cells
+        RIBBON_CALLS,           // traceRibbon calls, including the recursive ones
+        ZERO_VELOCITY_EXITS,    // ribbons stopped by a vanishing velocity or step
+        ADDITIONS,              // ribbons split by addition
+        RIPS,                   // ribbons stopped by ripping
+        VERTICES_EMITTED,
+        TRIANGLES_EMITTED,
+        COUNTER_COUNT
+    };
+
+    enum Maximum {
+        MAX_CANDIDATES,         // longest grid cell list seen by a lookup
+        MAX_RECURSION_DEPTH,    // deepest traceRibbon recursion
+        MAX_FRONT_SIZE,         // most ribbons in a front
+        MAXIMUM_COUNT
+    };
+
+    enum Histogram {
+        CANDIDATES,             // grid cell list length per lookup
+        RECURSION_DEPTH,        // traceRibbon depth per call
+        FRONT_SIZE,             // ribbons in the front per advance
+        HISTOGRAM_COUNT
+    };
+
+    static const unsigned int BINS = 24;
+
+    struct FrontSample
+    {
+        double       milliseconds;  // since the last reset
+        unsigned int ribbons;
+    };
+
+    struct Snapshot
+    {
+        unsigned long long counters[COUNTER_COUNT];
+        unsigned long long maxima[MAXIMUM_COUNT];
+        unsigned long long histograms[HISTOGRAM_COUNT][BINS];
+        unsigned long long sums[HISTOGRAM_COUNT];
+
+        std::vector<FrontSample> frontSizes;
+
+        /// Number of samples and their mean.
+        unsigned long long samples(Histogram histogram) const;
+        double mean(Histogram histogram) const;
+    };
+
+    /// Counters of one thread. Only that thread writes them, others read them in snapshot().
+    class Local
+    {
+    public:
+        Local();
+
+        void add(Counter counter, unsigned long long n = 1)
+        {
+            m_counters[counter].store(m_counters[counter].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        void maximum(Maximum maximum, unsigned long long value)
+        {
+            if (value > m_maxima[maximum].load(std::memory_order_relaxed))
+                m_maxima[maximum].store(value, std::memory_order_relaxed);
+        }
+
+        void sample(Histogram histogram, unsigned long long value)
+        {
+            std::atomic<unsigned long long>& bin = m_histograms[histogram][binOf(value)];
+            bin.store(bin.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            m_sums[histogram].store(m_sums[histogram].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+    private:
+        friend class TracerStats;
+
+        static unsigned int binOf(unsigned long long value)
+        {
+            unsigned int bin = 0;
+            while (value > 0 && bin < BINS - 1){
+                value >>= 1;
+                bin++;
+            }
+            return bin;
+        }
+
+        void clear();
+
+        std::atomic<unsigned long long> m_counters[COUNTER_COUNT];
+        std::atomic<unsigned long long> m_maxima[MAXIMUM_COUNT];
+        std::atomic<unsigned long long> m_histograms[HISTOGRAM_COUNT][BINS];
+        std::atomic<unsigned long long> m_sums[HISTOGRAM_COUNT];
+    };
+
+    /// The block of the calling thread; fetch it once per hot function.
+    static Local& local();
+
+    /// Append to the front size series (thinned out when it grows long).
+    static void sampleFrontSize(unsigned int ribbons);
+
+    /// Sum the blocks of all threads; the series is only copied if asked for.
+    static void snapshot(Snapshot& snapshot, bool withSeries = true);
+
+    static void reset();
+
+    static const char* name(Counter counter);
+    static const char* name(Maximum maximum);
+    static const char* name(Histogram histogram);
+
+    /// Counters, maxima, histograms (mean and bins) and the front size series as one object.
+    static void writeJson(JsonWriter& json, const Snapshot& snapshot);
+};
+
+#endif
@@ -3,6 +3,7 @@
 // STD
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <time.h>
 
 // GL
@@ -10,6 +11,10 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <GL/glew.h>
 
+// Stream Tracer
+#include "Profiler.h"
+#include "TracerStats.h"
+
 // Static Members
 GLFWwindow*     Application::m_window           = 0;
 AntTweakBarGUI  Application::m_gui;
@@ -29,6 +34,7 @@ Application::Application() {
     m_addition = true;
     m_remove = true;
     m_ripping = true;
+    m_export_count = 0;
 }
 
 void Application::init(const unsigned int& width, const unsigned int& height) {
@@ -83,6 +89,8 @@ void Application::init() {
 }
 
 void Application::create() {
+    Profiler::setThreadName("Main");
+
     compileShaders();
 
     m_streamtracer_renderer.loadOpenFOAM("../../data/Fraunhofer/othmer.foam");
@@ -107,6 +115,11 @@ void Application::update(float time, float timeSinceLastFrame) {
     glUniformMatrix4fv(2, 1, GL_FALSE, (float*)&m_worldmat);
     glUniform3fv      (3, 1, (float*)m_gui.general_light_dir);
 
+    m_streamtracer_renderer.setPreviewEnabled(m_gui.general_preview);
+    m_streamtracer_renderer.setMaxPixelError(m_gui.general_lod_error);
+    m_streamtracer_renderer.setLodMaxError(m_gui.general_lod_max_error);
+    m_streamtracer_renderer.setView(m_viewmat * m_worldmat, m_projmat, m_height);
+
     if (m_gui.general_streamlines)
         m_streamtracer_renderer.setMode(StreamSurfaceRenderer::Mode::STREAM_LINES);
     else
@@ -121,7 +134,23 @@ void Application::update(float time, float timeSinceLastFrame) {
     }
 
     m_streamtracer_renderer.setParameters(m_gui.seedingline_maxSeeds, m_gui.seedingline_maxSteps, m_gui.seedingline_stepSize, m_gui.seedingline_center, m_gui.seedingline_dir);
+    m_streamtracer_renderer.setSeedCurve(m_gui.seedingline_curve == AntTweakBarGUI::SEED_CIRCLE ? StreamTracer::SurfaceParameters::SC_CIRCLE : StreamTracer::SurfaceParameters::SC_LINE,
+                                         m_gui.seedingline_extent, m_gui.seedingline_adaptive);
+    if (m_gui.export_requested){
+        const char* extensions[] = { "ply", "vtu", "obj" };
+        std::ostringstream filename;
+        filename << "surface_" << m_export_count++ << "." << extensions[m_gui.export_format];
+
+        m_streamtracer_renderer.exportSurface(filename.str());
+        m_gui.export_requested = false;
+    }
+
     m_streamtracer_renderer.update(time, timeSinceLastFrame, m_gui.tracing_addition, m_gui.tracing_remove, m_gui.tracing_ripping);
+
+    // The bar shows the counters only; the front size series is left to the batch report
+    TracerStats::Snapshot stats;
+    TracerStats::snapshot(stats, false);
+    m_gui.updateStats(stats);
 }
 
 void Application::draw() {
@@ -147,8 +176,10 @@ void Application::draw() {
 
 void Application::run() {
     create();
-    clock_t start_time = clock();
-    clock_t start_frame = clock();
+
+    // Wall-clock time: clock() counts the CPU time of the surface worker as well
+    double start_time = glfwGetTime();
+    double start_frame = start_time;
 
     while (!glfwWindowShouldClose(m_window))
     {
@@ -159,10 +190,10 @@ void Application::run() {
         glfwSwapBuffers(m_window);
         glfwPollEvents();
 
-        clock_t current_time = clock();
-        float elapsed_since_start       = float(current_time - start_time)  / CLOCKS_PER_SEC;
-        float elapsed_since_last_frame  = float(current_time - start_frame) / CLOCKS_PER_SEC;
-        start_frame = clock();
+        double current_time = glfwGetTime();
+        float elapsed_since_start       = float(current_time - start_time);
+        float elapsed_since_last_frame  = float(current_time - start_frame);
+        start_frame = current_time;
 
         update(elapsed_since_start, elapsed_since_last_frame);
     }
@@ -170,6 +201,11 @@ void Application::run() {
 
 void Application::shutdown() {
     m_streamtracer_renderer.shutdown();
+
+    // The worker has stopped, so all zones are complete
+    if (Profiler::enabled())
+        Profiler::writeChromeTrace("stream_surface_trace.json");
+
     m_gui.shutdown();
     glfwDestroyWindow(m_window);
     glfwTerminate();
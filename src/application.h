@@ -65,6 +65,7 @@ private:
     unsigned int m_nVertices;
     
     bool m_addition, m_ripping, m_remove;
+    unsigned int m_export_count;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,453 @@
+
+/**
+ *
+ * Headless batch surface generation
+ *
+ *   StreamSurfaceBatch <dataset.foam> <surfaces.txt> [options]
+ *
+ * Loads the dataset, traces every surface of the parameter file in parallel,
+ * writes one mesh per surface and a JSON report with timings and statistics.
+ * The meshes are streamed out while their surfaces are traced, in traced order,
+ * so their write times are part of the trace times.
+ * With --time the surfaces are path surfaces released at that time through the
+ * time steps of an unsteady dataset. With --out-of-core the dataset is split
+ * into bricks that are read on demand, for datasets larger than memory; with
+ * --roi only the cells in a box are loaded and the surfaces end at its
+ * boundary. With --lod the meshes are simplified levels of detail of the surfaces
+ * instead of the traced surfaces, written after tracing. Needs neither a display nor OpenGL.
+ *
+ */
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Boost
+#include <boost/filesystem.hpp>
+
+// OpenMP
+#include <omp.h>
+
+// Stream Tracer
+#include "JsonWriter.h"
+#include "MemoryReport.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshWriter.h"
+#include "ParameterFile.h"
+#include "Profiler.h"
+#include "StreamTracer.h"
+#include "TracerStats.h"
+
+namespace
+{
+    struct Options
+    {
+        Options() : output("."), format("ply"), threads(0), writeMeshes(true), pathSurfaces(false), time(0.0), stepMemory(1024), prefetch(2), outOfCore(0), lod(0), lodRatio(4.0f), lodMaxError(0.0f) {}
+
+        std::string dataset, parameters;
+        std::string output, format, report, trace;
+        int threads;
+        bool writeMeshes;
+        bool pathSurfaces;
+        double time;
+        size_t stepMemory;
+        size_t prefetch;
+        size_t outOfCore;
+        AABB region;
+        unsigned int lod;
+        float lodRatio, lodMaxError;
+    };
+
+    void usage()
+    {
+        std::cout << "Usage: StreamSurfaceBatch <dataset.foam> <surfaces.txt> [options]\n"
+                  << "  --threads N      threads for tracing (default: all cores)\n"
+                  << "  --output DIR     directory for meshes and report (default: .)\n"
+                  << "  --format F       mesh format: ply, vtu or obj (default: ply)\n"
+                  << "  --report FILE    JSON report (default: DIR/report.json)\n"
+                  << "  --no-meshes      only trace and report\n"
+                  << "  --trace FILE     Chrome trace of the run (profiler builds only)\n"
+                  << "  --time T         path surfaces released at time T (unsteady datasets)\n"
+                  << "  --step-memory MB memory for resident time steps (default: 1024)\n"
+                  << "  --prefetch N     time steps read ahead in the background (default: 2, 0: off)\n"
+                  << "  --out-of-core MB trace from bricks read on demand, at most MB of them in memory\n"
+                  << "  --roi X0 Y0 Z0 X1 Y1 Z1  only load and trace the cells in this box\n"
+                  << "  --lod N          write level of detail N, about RATIO^N times fewer triangles (default: 0, the traced surface)\n"
+                  << "  --lod-ratio R    triangle ratio between two levels (default: 4)\n"
+                  << "  --lod-error E    largest estimated error of a level, in dataset units (default: 0, no limit)\n";
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options)
+    {
+        std::vector<std::string> positional;
+
+        for (int a = 1; a < argc; a++){
+            std::string argument = argv[a];
+            bool hasValue = a + 1 < argc;
+
+            if (argument == "--threads" && hasValue)        options.threads = std::atoi(argv[++a]);
+            else if (argument == "--output" && hasValue)    options.output = argv[++a];
+            else if (argument == "--format" && hasValue)    options.format = argv[++a];
+            else if (argument == "--report" && hasValue)    options.report = argv[++a];
+            else if (argument == "--trace" && hasValue)     options.trace = argv[++a];
+            else if (argument == "--no-meshes")             options.writeMeshes = false;
+            else if (argument == "--time" && hasValue){     options.time = std::atof(argv[++a]); options.pathSurfaces = true; }
+            else if (argument == "--step-memory" && hasValue) options.stepMemory = (size_t)std::atof(argv[++a]);
+            else if (argument == "--prefetch" && hasValue)  options.prefetch = (size_t)std::atoi(argv[++a]);
+            else if (argument == "--out-of-core" && hasValue) options.outOfCore = (size_t)std::atof(argv[++a]);
+            else if (argument == "--lod" && hasValue)       options.lod = (unsigned int)std::atoi(argv[++a]);
+            else if (argument == "--lod-ratio" && hasValue) options.lodRatio = (float)std::atof(argv[++a]);
+            else if (argument == "--lod-error" && hasValue) options.lodMaxError = (float)std::atof(argv[++a]);
+            else if (argument == "--roi" && a + 6 < argc){
+                float corners[6];
+                for (int c = 0; c < 6; c++)
+                    corners[c] = (float)std::atof(argv[++a]);
+                options.region = AABB(corners, corners + 3);
+                if (!options.region.valid())
+                    return false;
+            }
+            else if (argument.compare(0, 2, "--") == 0)     return false;
+            else                                            positional.push_back(argument);
+        }
+
+        if (positional.size() != 2 || options.lodRatio <= 1.0f || options.lodMaxError < 0.0f)
+            return false;
+
+        options.dataset    = positional[0];
+        options.parameters = positional[1];
+        if (options.report.empty())
+            options.report = (boost::filesystem::path(options.output) / "report.json").string();
+
+        return true;
+    }
+
+    double millisecondsSince(const std::chrono::steady_clock::time_point& start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double surfaceArea(const StreamTracer::BatchResult& result, const StreamTracer::SurfaceView& view)
+    {
+        double area = 0.0;
+        for (size_t i = 0; i + 2 < view.indexCount; i += 3){
+            const glm::vec3& a = result.vertices[view.firstVertex + result.faces[view.firstIndex + i]];
+            const glm::vec3& b = result.vertices[view.firstVertex + result.faces[view.firstIndex + i + 1]];
+            const glm::vec3& c = result.vertices[view.firstVertex + result.faces[view.firstIndex + i + 2]];
+            area += 0.5 * glm::length(glm::cross(b - a, c - a));
+        }
+        return area;
+    }
+
+    struct SurfaceReport
+    {
+        // Level written: the traced surface is level 0; a chain ends early where the error limit is reached
+        unsigned int lod;
+        size_t lodTriangles;
+        float lodError;
+
+        std::string file;
+        unsigned long long bytes;
+        double writeMilliseconds;
+        double area;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    Options options;
+    if (!parseArguments(argc, argv, options)){
+        usage();
+        return 1;
+    }
+
+    MeshWriter::Format format;
+    if (!MeshWriter::formatFromFilename("mesh." + options.format, format)){
+        std::cout << "Unknown mesh format: " << options.format << std::endl;
+        return 1;
+    }
+
+    boost::system::error_code error;
+    if (!boost::filesystem::exists(options.dataset, error) && !boost::filesystem::exists(options.dataset + ".bin", error)){
+        std::cout << "Dataset not found: " << options.dataset << std::endl;
+        return 2;
+    }
+
+    std::vector<ParameterFile::Surface> surfaces;
+    if (!ParameterFile::load(options.parameters, surfaces))
+        return 2;
+
+    boost::filesystem::create_directories(options.output, error);
+
+    if (options.threads > 0)
+        omp_set_num_threads(options.threads);
+    int threads = options.threads > 0 ? options.threads : omp_get_max_threads();
+
+    Profiler::setThreadName("Main");
+
+    // Field and acceleration structure
+    StreamTracer tracer;
+
+    // Peaks count from here, so that the load phase does not include the parameter file
+    MemoryReport memory;
+    MemoryReport::resetPeaks();
+
+    tracer.setOutOfCore(options.outOfCore * 1024 * 1024);
+
+    std::chrono::steady_clock::time_point phase = std::chrono::steady_clock::now();
+    tracer.loadOpenFOAM(options.dataset, options.region);
+    double loadMilliseconds = millisecondsSince(phase);
+
+    tracer.reportMemory(memory);
+    memory.endPhase("load");
+
+    if (tracer.getCellCount() == 0){
+        std::cout << "No cells in " << options.dataset << std::endl;
+        return 2;
+    }
+
+    phase = std::chrono::steady_clock::now();
+    tracer.computeAccel();
+    double accelMilliseconds = millisecondsSince(phase);
+
+    tracer.reportMemory(memory);
+    memory.endPhase("accel");
+
+    if (options.pathSurfaces && !tracer.isUnsteady()){
+        std::cout << options.dataset << " has no time steps for path surfaces" << std::endl;
+        return 2;
+    }
+    tracer.getTimeSeries().setMaxResidentBytes(options.stepMemory * 1024 * 1024);
+    tracer.getTimeSeries().setPrefetchSteps(options.prefetch);
+
+    // All surfaces in one parallel pass
+    std::vector<StreamTracer::BatchItem> items(surfaces.size());
+    std::vector<std::string> files(surfaces.size());
+    for (size_t s = 0; s < surfaces.size(); s++){
+        items[s] = surfaces[s].item;
+        if (options.writeMeshes)
+            files[s] = (boost::filesystem::path(options.output) / (surfaces[s].name + "." + options.format)).string();
+
+        // Full surfaces are streamed out while they are traced; a level needs the whole surface first
+        if (options.lod == 0)
+            items[s].exportFilename = files[s];
+    }
+
+    StreamTracer::BatchResult result;
+
+    TracerStats::reset();
+
+    phase = std::chrono::steady_clock::now();
+    if (options.pathSurfaces)
+        tracer.computePathsurfacesBatch(items, options.time, result, threads);
+    else
+        tracer.computeStreamsurfacesBatch(items, result, threads);
+    double traceMilliseconds = millisecondsSince(phase);
+
+    TracerStats::Snapshot stats;
+    TracerStats::snapshot(stats);
+
+    tracer.reportMemory(memory);
+    memory.add("result/vertices", result.vertices);
+    memory.add("result/derivatives", result.derivatives);
+    memory.add("result/normals", result.normals);
+    memory.add("result/tex coords", result.texCoords);
+    memory.add("result/faces", result.faces);
+    memory.endPhase("generation");
+    memory.print(std::cout);
+
+    // One mesh per surface
+    std::vector<SurfaceReport> reports(surfaces.size());
+    bool writeFailed = false;
+
+    phase = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < surfaces.size(); s++){
+        const StreamTracer::SurfaceView& view = result.surfaces[s];
+        SurfaceReport& report = reports[s];
+
+        report.area = surfaceArea(result, view);
+        report.lod = 0;
+        report.lodTriangles = view.indexCount / 3;
+        report.lodError = 0.0f;
+        report.bytes = 0;
+        report.writeMilliseconds = 0.0;
+        if (!options.writeMeshes)
+            continue;
+
+        report.file = files[s];
+        if (!items[s].exportFilename.empty()){
+            if (view.exported)
+                report.bytes = (unsigned long long)boost::filesystem::file_size(report.file, error);
+            else
+                writeFailed = true;
+
+            report.writeMilliseconds = view.exportMilliseconds;
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point writeStart = std::chrono::steady_clock::now();
+
+        // Face indices of a view count from its first vertex, just as the writer and the simplifier expect
+        ArrayView<glm::vec3>    vertices    = ArrayView<glm::vec3>(result.vertices).sub(view.firstVertex, view.vertexCount);
+        ArrayView<glm::vec3>    derivatives = ArrayView<glm::vec3>(result.derivatives).sub(view.firstVertex, view.vertexCount);
+        ArrayView<unsigned int> faces       = ArrayView<unsigned int>(result.faces).sub(view.firstIndex, view.indexCount);
+
+        // A level indexes the surface vertices, which keep the seed curve at the front. Only the
+        // vertices it still uses are written: renumbered by first use, the others move to the end.
+        std::vector<MeshSimplifier::Level> levels;
+        std::vector<glm::vec3> levelVertices, levelDerivatives;
+        if (options.lod > 0){
+            MeshSimplifier::buildLevels(vertices, faces, view.seedCount, options.lod, options.lodRatio, options.lodMaxError, levels);
+            if (!levels.empty()){
+                MeshSimplifier::Level& level = levels.back();
+                report.lod = (unsigned int)levels.size();
+                report.lodTriangles = level.faces.size() / 3;
+                report.lodError = level.error;
+
+                std::vector<unsigned int> remap;
+                MeshOptimizer::optimizeVertexFetch(level.faces, view.vertexCount, view.seedCount, remap);
+
+                levelVertices.assign(vertices.begin(), vertices.end());
+                levelDerivatives.assign(derivatives.begin(), derivatives.end());
+                MeshOptimizer::remapVertices(levelVertices, remap);
+                MeshOptimizer::remapVertices(levelDerivatives, remap);
+
+                size_t used = view.seedCount;
+                for (size_t i = 0; i < level.faces.size(); i++)
+                    used = std::max(used, (size_t)level.faces[i] + 1);
+
+                vertices    = ArrayView<glm::vec3>(levelVertices).sub(0, used);
+                derivatives = ArrayView<glm::vec3>(levelDerivatives).sub(0, used);
+                faces       = level.faces;
+            }
+        }
+
+        MeshWriter writer;
+        bool written = writer.open(report.file, format);
+        if (written){
+            writer.write(vertices, derivatives, faces);
+            written = writer.close();
+        }
+
+        if (written)
+            report.bytes = (unsigned long long)boost::filesystem::file_size(report.file, error);
+        else
+            writeFailed = true;
+
+        report.writeMilliseconds = millisecondsSince(writeStart);
+    }
+    double writeMilliseconds = millisecondsSince(phase);
+
+    // Report
+    size_t totalVertices = result.vertices.size();
+    size_t totalTriangles = result.faces.size() / 3;
+
+    std::ofstream out(options.report.c_str());
+    if (!out){
+        std::cout << "Cannot write report " << options.report << std::endl;
+        return 3;
+    }
+
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("dataset").value(options.dataset);
+    json.key("parameters").value(options.parameters);
+    json.key("threads").value(threads);
+    json.key("cells").value(tracer.getCellCount());
+    if (options.region.valid()){
+        json.key("region_of_interest").beginArray();
+        for (int a = 0; a < 3; a++)
+            json.value(options.region.min[a]);
+        for (int a = 0; a < 3; a++)
+            json.value(options.region.max[a]);
+        json.endArray();
+    }
+    if (options.pathSurfaces){
+        const FieldTimeSeries& series = tracer.getTimeSeries();
+        json.key("time").value(options.time);
+        json.key("time_steps").beginObject();
+        json.key("count").value(series.getStepCount());
+        json.key("loads").value(series.getLoads());
+        json.key("prefetches").value(series.getPrefetches());
+        json.key("stalls").value(series.getStalls());
+        json.key("stall_ms").value(series.getStallMilliseconds());
+        json.key("resident").value(series.getResidentSteps());
+        json.key("resident_bytes").value(series.getResidentBytes());
+        json.endObject();
+    }
+    if (tracer.isOutOfCore()){
+        const BrickedField& bricks = tracer.getBricks();
+        json.key("bricks").beginObject();
+        json.key("count").value(bricks.getIndex().size());
+        json.key("loads").value(bricks.getLoads());
+        json.key("evictions").value(bricks.getEvictions());
+        json.key("resident").value(bricks.getResidentBricks());
+        json.key("resident_bytes").value(bricks.getResidentBytes());
+        json.endObject();
+    }
+
+    json.key("timings_ms").beginObject();
+    json.key("load").value(loadMilliseconds);
+    json.key("accel").value(accelMilliseconds);
+    json.key("trace").value(traceMilliseconds);
+    json.key("write").value(writeMilliseconds);
+    json.key("total").value(millisecondsSince(start));
+    json.endObject();
+
+    json.key("totals").beginObject();
+    json.key("surfaces").value(surfaces.size());
+    json.key("vertices").value(totalVertices);
+    json.key("triangles").value(totalTriangles);
+    json.key("triangles_per_second").value(traceMilliseconds > 0.0 ? totalTriangles / (traceMilliseconds / 1000.0) : 0.0);
+    json.endObject();
+
+    json.key("surfaces").beginArray();
+    for (size_t s = 0; s < surfaces.size(); s++){
+        const StreamTracer::SurfaceView& view = result.surfaces[s];
+        const SurfaceReport& report = reports[s];
+
+        json.beginObject();
+        json.key("name").value(surfaces[s].name);
+        json.key("seeds").value(view.seedCount);
+        json.key("vertices").value(view.vertexCount);
+        json.key("triangles").value(view.indexCount / 3);
+        json.key("area").value(report.area);
+        json.key("trace_ms").value(view.milliseconds);
+        if (options.writeMeshes){
+            if (options.lod > 0){
+                json.key("lod").value(report.lod);
+                json.key("lod_triangles").value(report.lodTriangles);
+                json.key("lod_error").value(report.lodError);
+            }
+            json.key("file").value(report.file);
+            json.key("bytes").value(report.bytes);
+            json.key("write_ms").value(report.writeMilliseconds);
+        }
+        json.endObject();
+    }
+    json.endArray();
+
+    // Tracer counters of the batch pass, summed over all surfaces
+    json.key("stats");
+    TracerStats::writeJson(json, stats);
+
+    json.key("memory");
+    memory.writeJson(json);
+    json.endObject();
+
+    if (!options.trace.empty())
+        Profiler::writeChromeTrace(options.trace);
+
+    std::cout << surfaces.size() << " surfaces, " << totalTriangles << " triangles in " << traceMilliseconds
+              << " ms on " << threads << " threads; report: " << options.report << std::endl;
+
+    return writeFailed ? 3 : 0;
+}
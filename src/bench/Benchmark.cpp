@@ -0,0 +1,238 @@
+#include "Benchmark.h"
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <streambuf>
+
+// Stream Tracer
+#include "JsonWriter.h"
+
+namespace
+{
+    // Swallows the progress output of the benchmarked code
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) { return c; }
+    };
+
+    volatile double g_sink = 0.0;
+}
+
+Benchmark::State::State(size_t iterations, PerfCounters* counters)
+    : m_iterations(iterations)
+    , m_items(0.0)
+    , m_counters(counters)
+    , m_paused(Clock::duration::zero())
+    , m_running(true)
+{
+    if (m_counters)
+        m_counters->start();
+    m_start = Clock::now();
+}
+
+void Benchmark::State::pause()
+{
+    if (!m_running)
+        return;
+    m_paused_at = Clock::now();
+    if (m_counters)
+        m_counters->stop();
+    m_running = false;
+}
+
+void Benchmark::State::resume()
+{
+    if (m_running)
+        return;
+    if (m_counters)
+        m_counters->resume();
+    m_paused += Clock::now() - m_paused_at;
+    m_running = true;
+}
+
+double Benchmark::State::elapsedNanoseconds() const
+{
+    Clock::time_point end = m_running ? Clock::now() : m_paused_at;
+    return std::chrono::duration<double, std::nano>(end - m_start - m_paused).count();
+}
+
+Benchmark::Benchmark(double minMilliseconds, unsigned int repetitions)
+    : m_min_milliseconds(minMilliseconds)
+    , m_repetitions(std::max(repetitions, 1u))
+    , m_verbose(false)
+    , m_counters(NULL)
+{
+}
+
+void Benchmark::add(const std::string& name, Function function)
+{
+    Entry entry = { name, function, false };
+    m_entries.push_back(entry);
+}
+
+void Benchmark::addFixed(const std::string& name, Function function)
+{
+    Entry entry = { name, function, true };
+    m_entries.push_back(entry);
+}
+
+void Benchmark::keep(double value)
+{
+    g_sink = g_sink + value;
+}
+
+size_t Benchmark::run(const std::string& filter)
+{
+    NullBuffer null;
+    size_t count = 0;
+
+    std::cout << std::left << std::setw(56) << "Benchmark" << std::right
+              << std::setw(14) << "median" << std::setw(14) << "min"
+              << std::setw(12) << "iterations" << std::setw(16) << "items/s" << std::endl;
+
+    for (size_t e = 0; e < m_entries.size(); e++){
+        if (m_entries[e].name.find(filter) == std::string::npos)
+            continue;
+
+        std::streambuf* console = std::cout.rdbuf();
+        if (!m_verbose)
+            std::cout.rdbuf(&null);
+
+        Result result = measure(m_entries[e]);
+
+        std::cout.rdbuf(console);
+
+        std::cout << std::left << std::setw(56) << result.name << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(11) << result.medianNanoseconds << " ns"
+                  << std::setw(11) << result.minNanoseconds << " ns"
+                  << std::setw(12) << result.iterations
+                  << std::setw(16) << std::scientific << std::setprecision(3) << result.itemsPerSecond << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+
+        if (result.counted){
+            const PerfCounters::Counts& counts = result.counters;
+            std::cout << "    per " << (result.itemsPerSecond > 0.0 ? "item" : "iteration") << ":" << std::fixed << std::setprecision(2);
+            for (int e = 0; e < PerfCounters::EVENT_COUNT; e++)
+                if (counts.valid[e])
+                    std::cout << " " << PerfCounters::name((PerfCounters::Event)e) << " " << counts.values[e];
+            if (counts.valid[PerfCounters::CYCLES] && counts.valid[PerfCounters::INSTRUCTIONS] && counts.values[PerfCounters::CYCLES] > 0.0)
+                std::cout << " ipc " << counts.values[PerfCounters::INSTRUCTIONS] / counts.values[PerfCounters::CYCLES];
+            std::cout << std::endl;
+            std::cout.unsetf(std::ios::floatfield);
+        }
+
+        m_results.push_back(result);
+        count++;
+    }
+
+    return count;
+}
+
+Benchmark::Result Benchmark::measure(const Entry& entry) const
+{
+    const double minNanoseconds = m_min_milliseconds * 1.0e6;
+
+    // Warm up and calibrate: grow the iteration count until a run is long enough to time
+    size_t iterations = 1;
+    double items = 0.0;
+    while (true){
+        State state(iterations);
+        entry.function(state);
+        double elapsed = state.elapsedNanoseconds();
+        items = state.itemsPerIteration();
+
+        if (entry.fixed || elapsed >= minNanoseconds || iterations >= 1000000000)
+            break;
+
+        double scale = elapsed > 0.0 ? 1.4 * minNanoseconds / elapsed : 10.0;
+        iterations = (size_t)(iterations * std::min(std::max(scale, 2.0), 10.0));
+    }
+
+    // Counted together with the timed runs; the counts are summed over all repetitions
+    PerfCounters* counters = (m_counters && m_counters->isOpen() && !entry.fixed) ? m_counters : NULL;
+    PerfCounters::Counts total;
+
+    std::vector<double> times(m_repetitions);
+    for (unsigned r = 0; r < m_repetitions; r++){
+        State state(iterations, counters);
+        entry.function(state);
+        times[r] = state.elapsedNanoseconds() / (double)iterations;
+
+        if (counters){
+            counters->stop();
+
+            PerfCounters::Counts counts;
+            counters->read(counts);
+            for (int e = 0; e < PerfCounters::EVENT_COUNT; e++){
+                total.values[e] += counts.values[e];
+                total.valid[e]   = counts.valid[e] && (r == 0 || total.valid[e]);
+            }
+        }
+    }
+
+    Result result;
+    result.name        = entry.name;
+    result.iterations  = iterations;
+    result.repetitions = m_repetitions;
+
+    result.counted = counters != NULL;
+    if (result.counted){
+        double operations = (double)iterations * m_repetitions * (items > 0.0 ? items : 1.0);
+        for (int e = 0; e < PerfCounters::EVENT_COUNT; e++){
+            result.counters.values[e] = total.values[e] / operations;
+            result.counters.valid[e]  = total.valid[e];
+        }
+    }
+
+    std::sort(times.begin(), times.end());
+    result.minNanoseconds    = times.front();
+    result.medianNanoseconds = times.size() % 2 ? times[times.size() / 2]
+                                                : 0.5 * (times[times.size() / 2 - 1] + times[times.size() / 2]);
+
+    double sum = 0.0, squares = 0.0;
+    for (size_t t = 0; t < times.size(); t++){
+        sum     += times[t];
+        squares += times[t] * times[t];
+    }
+    result.meanNanoseconds   = sum / times.size();
+    result.stddevNanoseconds = std::sqrt(std::max(squares / times.size() - result.meanNanoseconds * result.meanNanoseconds, 0.0));
+
+    result.itemsPerSecond = (items > 0.0 && result.medianNanoseconds > 0.0) ? items / (result.medianNanoseconds * 1.0e-9) : 0.0;
+
+    return result;
+}
+
+void Benchmark::writeJson(JsonWriter& json) const
+{
+    json.beginArray();
+    for (size_t r = 0; r < m_results.size(); r++){
+        const Result& result = m_results[r];
+
+        json.beginObject();
+        json.key("name").value(result.name);
+        json.key("iterations").value(result.iterations);
+        json.key("repetitions").value(result.repetitions);
+        json.key("min_ns").value(result.minNanoseconds);
+        json.key("median_ns").value(result.medianNanoseconds);
+        json.key("mean_ns").value(result.meanNanoseconds);
+        json.key("stddev_ns").value(result.stddevNanoseconds);
+        json.key("items_per_second").value(result.itemsPerSecond);
+        if (result.counted){
+            const PerfCounters::Counts& counts = result.counters;
+            json.key("counters").beginObject();
+            json.key("per").value(result.itemsPerSecond > 0.0 ? "item" : "iteration");
+            for (int e = 0; e < PerfCounters::EVENT_COUNT; e++)
+                if (counts.valid[e])
+                    json.key(PerfCounters::name((PerfCounters::Event)e)).value(counts.values[e]);
+            if (counts.valid[PerfCounters::CYCLES] && counts.valid[PerfCounters::INSTRUCTIONS] && counts.values[PerfCounters::CYCLES] > 0.0)
+                json.key("ipc").value(counts.values[PerfCounters::INSTRUCTIONS] / counts.values[PerfCounters::CYCLES]);
+            json.endObject();
+        }
+        json.endObject();
+    }
+    json.endArray();
+}
@@ -0,0 +1,128 @@
+
+/**
+ *
+ * Benchmark harness
+ *
+ * This class runs registered benchmarks and reports their timings. Every
+ * benchmark is a function that performs its work state.iterations() times.
+ * The number of iterations is grown until one run takes at least the minimum
+ * time, then the run is repeated and the per-iteration times are summarized
+ * (min, median, mean and standard deviation). Setup work inside a run can be
+ * excluded with pause()/resume(). Fixed benchmarks (whole pipeline stages)
+ * run exactly one iteration per repetition.
+ *
+ * With hardware counters attached, the timed runs of the other benchmarks are
+ * also counted and the events are reported per item (or per iteration, if the
+ * benchmark counts no items). The counters follow the calling thread only, so
+ * the multi-threaded fixed benchmarks are not counted.
+ *
+ */
+
+#ifndef __BENCHMARK__
+#define __BENCHMARK__
+
+// STD
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Stream Tracer
+#include "PerfCounters.h"
+
+class JsonWriter;
+
+class Benchmark
+{
+public:
+
+    class State
+    {
+    public:
+        State(size_t iterations, PerfCounters* counters = NULL);
+
+        size_t iterations() const { return m_iterations; }
+
+        /// Exclude the work between pause() and resume() from the measurement.
+        void pause();
+        void resume();
+
+        /// Items (points, cells, triangles) processed per iteration, reported as a rate.
+        void setItemsPerIteration(double items) { m_items = items; }
+
+        double elapsedNanoseconds() const;
+        double itemsPerIteration() const { return m_items; }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        size_t m_iterations;
+        double m_items;
+        PerfCounters* m_counters;
+
+        Clock::time_point m_start, m_paused_at;
+        Clock::duration   m_paused;
+        bool              m_running;
+    };
+
+    typedef std::function<void(State&)> Function;
+
+    struct Result
+    {
+        std::string name;
+        size_t      iterations;     // per repetition
+        unsigned    repetitions;
+
+        // Per iteration
+        double minNanoseconds, medianNanoseconds, meanNanoseconds, stddevNanoseconds;
+
+        double itemsPerSecond;      // from the median, 0 if the benchmark counts no items
+
+        // Hardware events per item (per iteration if the benchmark counts no items), if counted
+        bool                 counted;
+        PerfCounters::Counts counters;
+    };
+
+    Benchmark(double minMilliseconds, unsigned int repetitions);
+
+    /// Let the benchmarked code print to std::cout (silenced by default).
+    void setVerbose(bool verbose) { m_verbose = verbose; }
+
+    /// Count hardware events during the timed runs of non-fixed benchmarks. NULL stops counting.
+    void setCounters(PerfCounters* counters) { m_counters = counters; }
+
+    void add(const std::string& name, Function function);
+
+    /// Add a benchmark that runs a single iteration per repetition.
+    void addFixed(const std::string& name, Function function);
+
+    /// Run all benchmarks whose name contains the filter. Returns the number of benchmarks run.
+    size_t run(const std::string& filter);
+
+    const std::vector<Result>& getResults() const { return m_results; }
+
+    void writeJson(JsonWriter& json) const;
+
+    /// Keep the compiler from optimizing away a computed value.
+    static void keep(double value);
+
+private:
+    struct Entry
+    {
+        std::string name;
+        Function    function;
+        bool        fixed;
+    };
+
+    Result measure(const Entry& entry) const;
+
+    double   m_min_milliseconds;
+    unsigned m_repetitions;
+    bool     m_verbose;
+    PerfCounters* m_counters;
+
+    std::vector<Entry>  m_entries;
+    std::vector<Result> m_results;
+};
+
+#endif
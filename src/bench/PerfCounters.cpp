@@ -0,0 +1,206 @@
+#include "PerfCounters.h"
+
+// STD
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#    include <linux/perf_event.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+PerfCounters::Counts::Counts()
+{
+    for (int e = 0; e < EVENT_COUNT; e++){
+        values[e] = 0.0;
+        valid[e]  = false;
+    }
+}
+
+PerfCounters::PerfCounters()
+{
+    for (int e = 0; e < EVENT_COUNT; e++)
+        m_fds[e] = -1;
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+bool PerfCounters::isOpen() const
+{
+    for (int e = 0; e < EVENT_COUNT; e++)
+        if (m_fds[e] >= 0)
+            return true;
+    return false;
+}
+
+const char* PerfCounters::name(Event event)
+{
+    static const char* names[EVENT_COUNT] = {
+        "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "branch_misses"
+    };
+    return names[event];
+}
+
+#ifdef __linux__
+
+namespace
+{
+    unsigned long long cacheConfig(unsigned long long cache)
+    {
+        return cache | ((unsigned long long)PERF_COUNT_HW_CACHE_OP_READ << 8) | ((unsigned long long)PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    int openEvent(unsigned int type, unsigned long long config)
+    {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = type;
+        attr.config         = config;
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;    // user space only, which needs no privileges
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    std::string paranoidLevel()
+    {
+        std::ifstream file("/proc/sys/kernel/perf_event_paranoid");
+        std::string level;
+        file >> level;
+        return level.empty() ? "unknown" : level;
+    }
+}
+
+bool PerfCounters::open(std::string& error)
+{
+    close();
+
+    struct Config { unsigned int type; unsigned long long config; };
+    const Config configs[EVENT_COUNT] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_L1D) },
+        { PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_LL) },
+        { PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_DTLB) },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+    };
+
+    int firstErrno = 0;
+    for (int e = 0; e < EVENT_COUNT; e++){
+        m_fds[e] = openEvent(configs[e].type, configs[e].config);
+
+        // Some CPUs only offer the generic last level cache event
+        if (m_fds[e] < 0 && e == LLC_MISSES)
+            m_fds[e] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+        if (m_fds[e] < 0 && firstErrno == 0)
+            firstErrno = errno;
+    }
+
+    if (isOpen())
+        return true;
+
+    std::ostringstream reason;
+    if (firstErrno == EACCES || firstErrno == EPERM)
+        reason << "not permitted (kernel.perf_event_paranoid is " << paranoidLevel() << ", counting without root needs 2 or less)";
+    else if (firstErrno == ENOENT || firstErrno == EOPNOTSUPP || firstErrno == ENODEV)
+        reason << "no hardware counters on this CPU or virtual machine";
+    else if (firstErrno == ENOSYS)
+        reason << "perf_event_open is not supported by this kernel";
+    else
+        reason << std::strerror(firstErrno);
+    error = reason.str();
+    return false;
+}
+
+void PerfCounters::close()
+{
+    for (int e = 0; e < EVENT_COUNT; e++){
+        if (m_fds[e] >= 0)
+            ::close(m_fds[e]);
+        m_fds[e] = -1;
+    }
+}
+
+void PerfCounters::start()
+{
+    for (int e = 0; e < EVENT_COUNT; e++){
+        if (m_fds[e] < 0)
+            continue;
+        ioctl(m_fds[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fds[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::stop()
+{
+    for (int e = 0; e < EVENT_COUNT; e++)
+        if (m_fds[e] >= 0)
+            ioctl(m_fds[e], PERF_EVENT_IOC_DISABLE, 0);
+}
+
+void PerfCounters::resume()
+{
+    for (int e = 0; e < EVENT_COUNT; e++)
+        if (m_fds[e] >= 0)
+            ioctl(m_fds[e], PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void PerfCounters::read(Counts& counts) const
+{
+    for (int e = 0; e < EVENT_COUNT; e++){
+        counts.values[e] = 0.0;
+        counts.valid[e]  = false;
+        if (m_fds[e] < 0)
+            continue;
+
+        // value, time enabled, time running
+        unsigned long long data[3];
+        if (::read(m_fds[e], data, sizeof(data)) != (ssize_t)sizeof(data) || data[2] == 0)
+            continue;
+
+        counts.values[e] = (double)data[0] * ((double)data[1] / (double)data[2]);
+        counts.valid[e]  = true;
+    }
+}
+
+#else
+
+bool PerfCounters::open(std::string& error)
+{
+    error = "hardware counters are only supported on Linux";
+    return false;
+}
+
+void PerfCounters::close()
+{
+}
+
+void PerfCounters::start()
+{
+}
+
+void PerfCounters::stop()
+{
+}
+
+void PerfCounters::resume()
+{
+}
+
+void PerfCounters::read(Counts& counts) const
+{
+    counts = Counts();
+}
+
+#endif
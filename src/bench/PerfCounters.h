@@ -0,0 +1,73 @@
+
+/**
+ *
+ * Hardware performance counters
+ *
+ * This class counts CPU events of the calling thread with Linux perf_event_open:
+ * cycles, instructions, L1 data cache and last level cache read misses, data
+ * TLB misses and branch misses. Only user-space events of the own process are
+ * counted, which perf_event_paranoid <= 2 (the default) allows without root.
+ *
+ * Events the CPU, the kernel or a virtual machine do not offer are left out,
+ * and open() fails only if none is available; on other systems it always
+ * fails. When more events are open than the CPU has counters, the kernel
+ * multiplexes them and the counts are scaled by the time they were running.
+ *
+ */
+
+#ifndef __PERF_COUNTERS__
+#define __PERF_COUNTERS__
+
+// STD
+#include <string>
+
+class PerfCounters
+{
+public:
+
+    enum Event {
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        DTLB_MISSES,
+        BRANCH_MISSES,
+        EVENT_COUNT
+    };
+
+    struct Counts
+    {
+        Counts();
+
+        double values[EVENT_COUNT];
+        bool   valid[EVENT_COUNT];
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    /// Open the counters of the calling thread. Returns false with a reason if none is available.
+    bool open(std::string& error);
+    void close();
+
+    bool isOpen() const;
+    bool available(Event event) const { return m_fds[event] >= 0; }
+
+    /// Zero and start counting; stop; start again without zeroing (after a pause).
+    void start();
+    void stop();
+    void resume();
+
+    /// Counts since start(), scaled for multiplexing.
+    void read(Counts& counts) const;
+
+    static const char* name(Event event);
+
+private:
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+
+    int m_fds[EVENT_COUNT];
+};
+
+#endif
@@ -0,0 +1,357 @@
+
+/**
+ *
+ * Benchmark suite
+ *
+ *   StreamSurfaceBenchmark <dataset.foam> [surfaces.txt] [options]
+ *
+ * Micro benchmarks time the inner loops of the tracer (grid lookups, field
+ * sampling, a single ribbon, building the grid); macro benchmarks time whole
+ * stages (loading the binary cache, the acceleration structure and complete
+ * surfaces for a sweep of seed counts). The seed curve is the first surface of
+ * the parameter file, or a line through the center of the dataset. Results are
+ * written as JSON to compare versions. With --counters the micro benchmarks
+ * also report hardware events (cache and TLB misses, branch misses, IPC) per
+ * lookup, where Linux allows it.
+ *
+ */
+
+// STD
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Boost
+#include <boost/filesystem.hpp>
+
+// OpenMP
+#include <omp.h>
+
+// Stream Tracer
+#include "Benchmark.h"
+#include "JsonWriter.h"
+#include "ParameterFile.h"
+#include "PerfCounters.h"
+#include "StreamSurface.h"
+#include "StreamTracer.h"
+
+namespace
+{
+    struct Options
+    {
+        Options() : output("benchmark.json"), minMilliseconds(200.0), repetitions(5), verbose(false), counters(false) {}
+
+        std::string dataset, parameters;
+        std::string output, filter;
+        double minMilliseconds;
+        unsigned int repetitions;
+        bool verbose, counters;
+    };
+
+    void usage()
+    {
+        std::cout << "Usage: StreamSurfaceBenchmark <dataset.foam> [surfaces.txt] [options]\n"
+                  << "  --filter TEXT      only run benchmarks whose name contains TEXT\n"
+                  << "  --min-time MS      minimum time of one timed run (default: 200)\n"
+                  << "  --repetitions N    timed runs per benchmark (default: 5)\n"
+                  << "  --output FILE      JSON results (default: benchmark.json)\n"
+                  << "  --counters         count hardware events of the micro benchmarks (Linux)\n"
+                  << "  --verbose          keep the output of the benchmarked code\n";
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options)
+    {
+        std::vector<std::string> positional;
+
+        for (int a = 1; a < argc; a++){
+            std::string argument = argv[a];
+            bool hasValue = a + 1 < argc;
+
+            if (argument == "--filter" && hasValue)             options.filter = argv[++a];
+            else if (argument == "--min-time" && hasValue)      options.minMilliseconds = std::atof(argv[++a]);
+            else if (argument == "--repetitions" && hasValue)   options.repetitions = (unsigned int)std::atoi(argv[++a]);
+            else if (argument == "--output" && hasValue)        options.output = argv[++a];
+            else if (argument == "--counters")                  options.counters = true;
+            else if (argument == "--verbose")                   options.verbose = true;
+            else if (argument.compare(0, 2, "--") == 0)         return false;
+            else                                                positional.push_back(argument);
+        }
+
+        if (positional.empty() || positional.size() > 2)
+            return false;
+
+        options.dataset = positional[0];
+        if (positional.size() > 1)
+            options.parameters = positional[1];
+
+        return true;
+    }
+
+    /// Uniformly distributed points inside the scene box; with insideOnly, only points inside cells.
+    std::vector<glm::vec3> samplePoints(const StreamTracer& tracer, size_t count, bool insideOnly)
+    {
+        const AABB& box = tracer.getSceneBox();
+
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<float> x(box.min[0], box.max[0]);
+        std::uniform_real_distribution<float> y(box.min[1], box.max[1]);
+        std::uniform_real_distribution<float> z(box.min[2], box.max[2]);
+
+        std::vector<glm::vec3> points;
+        std::vector<glm::vec3> candidates(count);
+        std::vector<char> valid;
+
+        // Give up on fields that fill only a sliver of their box
+        for (int round = 0; round < 100 && points.size() < count; round++){
+            for (size_t c = 0; c < count; c++)
+                candidates[c] = glm::vec3(x(generator), y(generator), z(generator));
+
+            if (insideOnly)
+                tracer.seedsAreValid(candidates, valid);
+
+            for (size_t c = 0; c < count && points.size() < count; c++)
+                if (!insideOnly || valid[c])
+                    points.push_back(candidates[c]);
+        }
+
+        return points;
+    }
+
+    std::string sweepName(const char* base, unsigned int seeds)
+    {
+        std::ostringstream name;
+        name << base << "/seeds:" << seeds;
+        return name.str();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseArguments(argc, argv, options)){
+        usage();
+        return 1;
+    }
+
+    boost::system::error_code error;
+    if (!boost::filesystem::exists(options.dataset, error) && !boost::filesystem::exists(options.dataset + ".bin", error)){
+        std::cout << "Dataset not found: " << options.dataset << std::endl;
+        return 2;
+    }
+
+    // The first load converts the dataset into the binary cache that the load benchmark reads
+    StreamTracer tracer;
+    tracer.loadOpenFOAM(options.dataset);
+    if (tracer.getCellCount() == 0){
+        std::cout << "No cells in " << options.dataset << std::endl;
+        return 2;
+    }
+    tracer.computeAccel();
+
+    // Seed curve of the surface benchmarks
+    StreamTracer::BatchItem surface;
+    tracer.getParameters(surface.parameters);
+    surface.addition = true;
+    surface.remove   = false;
+    surface.ripping  = true;
+
+    if (!options.parameters.empty()){
+        std::vector<ParameterFile::Surface> surfaces;
+        if (!ParameterFile::load(options.parameters, surfaces))
+            return 2;
+        surface = surfaces[0].item;
+    }
+
+    const std::vector<glm::vec3> boxPoints  = samplePoints(tracer, 4096, false);
+    const std::vector<glm::vec3> cellPoints = samplePoints(tracer, 4096, true);
+    if (cellPoints.empty()){
+        std::cout << "No sample points inside the cells of " << options.dataset << std::endl;
+        return 2;
+    }
+
+    Benchmark benchmark(options.minMilliseconds, options.repetitions);
+    benchmark.setVerbose(options.verbose);
+
+    // Without counters the timings are still worth having, so a refusal is only reported
+    PerfCounters counters;
+    std::string countersError;
+    if (options.counters){
+        if (counters.open(countersError)){
+            benchmark.setCounters(&counters);
+            for (int e = 0; e < PerfCounters::EVENT_COUNT; e++)
+                if (!counters.available((PerfCounters::Event)e))
+                    std::cout << "Hardware counter " << PerfCounters::name((PerfCounters::Event)e) << " is not available" << std::endl;
+        }
+        else
+            std::cout << "Hardware counters are not available: " << countersError << std::endl;
+    }
+
+    // Micro benchmarks
+
+    benchmark.add("Grid/locateCell", [&](Benchmark::State& state){
+        const Grid& grid = tracer.getSceneAccel();
+        size_t sum = 0;
+        for (size_t n = 0; n < state.iterations(); n++){
+            for (size_t p = 0; p < boxPoints.size(); p++){
+                size_t i, j, k;
+                grid.locateCell(i, j, k, &boxPoints[p].x);
+                sum += i + j + k;
+            }
+        }
+        Benchmark::keep((double)sum);
+        state.setItemsPerIteration((double)boxPoints.size());
+    });
+
+    benchmark.add("Grid/getPrimitives", [&](Benchmark::State& state){
+        const Grid& grid = tracer.getSceneAccel();
+        size_t sum = 0;
+        for (size_t n = 0; n < state.iterations(); n++){
+            for (size_t p = 0; p < boxPoints.size(); p++){
+                size_t i, j, k;
+                grid.locateCell(i, j, k, &boxPoints[p].x);
+                sum += grid.getPrimitives(i, j, k).size();
+            }
+        }
+        Benchmark::keep((double)sum);
+        state.setItemsPerIteration((double)boxPoints.size());
+    });
+
+    benchmark.add("StreamTracer/derivate", [&](Benchmark::State& state){
+        glm::vec3 sum(0.0f);
+        for (size_t n = 0; n < state.iterations(); n++)
+            for (size_t p = 0; p < cellPoints.size(); p++)
+                sum += tracer.derivate(cellPoints[p]);
+        Benchmark::keep(sum.x + sum.y + sum.z);
+        state.setItemsPerIteration((double)cellPoints.size());
+    });
+
+    // One ribbon, traced without addition or ripping. The last ribbon of a front is never
+    // advanced, so a surface of three neighbouring seeds inside the domain traces exactly one.
+    StreamTracer::SurfaceParameters ribbon = surface.parameters;
+    {
+        std::vector<glm::vec3> samples;
+        std::vector<char> valid;
+        StreamSurface::sampleSeedCurve(ribbon, 64, samples);
+        tracer.seedsAreValid(samples, valid);
+
+        size_t first = samples.size() / 2;
+        for (size_t s = 0; s + 2 < samples.size(); s++){
+            if (valid[s] && valid[s + 1] && valid[s + 2]){
+                first = s;
+                break;
+            }
+        }
+
+        ribbon.seedCurveType = StreamTracer::SurfaceParameters::SC_POLYLINE;
+        ribbon.seedCurvePoints.assign(samples.begin() + first, samples.begin() + first + 3);
+        ribbon.traceDirection  = StreamTracer::SurfaceParameters::TD_FORWARD;
+        ribbon.traceMaxSeeds   = 3;
+        ribbon.adaptiveSeeding = false;
+    }
+
+    benchmark.add("StreamSurface/traceRibbon", [&](Benchmark::State& state){
+        StreamSurface ribbonSurface(tracer);
+        ribbonSurface.setParameters(ribbon);
+        for (size_t n = 0; n < state.iterations(); n++)
+            ribbonSurface.compute(false, false, false);
+        state.setItemsPerIteration((double)(ribbonSurface.getFaceIndices().size() / 3));
+    });
+
+    benchmark.addFixed("Grid/insertPrimitiveList", [&](Benchmark::State& state){
+        const Grid& accel = tracer.getSceneAccel();
+        size_t x, y, z;
+        accel.getDimensions(x, y, z);
+
+        state.pause();
+        Grid grid(accel.getBounds(), x, y, z);
+        state.resume();
+
+        grid.insertPrimitiveList(tracer.getCellBoxes());
+
+        state.pause();
+        state.setItemsPerIteration((double)tracer.getCellCount());
+    });
+
+    // Macro benchmarks
+
+    benchmark.addFixed("StreamTracer/loadBinary", [&](Benchmark::State& state){
+        state.pause();
+        std::unique_ptr<StreamTracer> loaded(new StreamTracer());
+        state.resume();
+
+        loaded->loadOpenFOAM(options.dataset);
+
+        state.pause();
+        state.setItemsPerIteration((double)loaded->getCellCount());
+        loaded.reset();
+    });
+
+    benchmark.addFixed("StreamTracer/computeAccel", [&](Benchmark::State& state){
+        tracer.computeAccel();
+        state.setItemsPerIteration((double)tracer.getCellCount());
+    });
+
+    const unsigned int sweep[] = { 16, 64, 256 };
+    for (size_t s = 0; s < sizeof(sweep) / sizeof(sweep[0]); s++){
+        StreamTracer::SurfaceParameters parameters = surface.parameters;
+        parameters.traceMaxSeeds = sweep[s];
+
+        benchmark.addFixed(sweepName("StreamTracer/computeStreamsurfaces", sweep[s]), [&tracer, surface, parameters](Benchmark::State& state){
+            tracer.setParameters(parameters);
+            tracer.computeStreamsurfaces(surface.addition, surface.remove, surface.ripping);
+            state.setItemsPerIteration((double)(tracer.getFaceIndexCount() / 3));
+        });
+    }
+
+    if (benchmark.run(options.filter) == 0){
+        std::cout << "No benchmark matches '" << options.filter << "'" << std::endl;
+        return 1;
+    }
+
+    std::ofstream out(options.output.c_str());
+    if (!out){
+        std::cout << "Cannot write " << options.output << std::endl;
+        return 3;
+    }
+
+    std::time_t now = std::time(NULL);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    JsonWriter json(out);
+    json.beginObject();
+    json.key("context").beginObject();
+    json.key("date").value(date);
+    json.key("dataset").value(options.dataset);
+    json.key("parameters").value(options.parameters);
+    json.key("cells").value(tracer.getCellCount());
+    json.key("threads").value(omp_get_max_threads());
+    json.key("min_time_ms").value(options.minMilliseconds);
+    if (options.counters){
+        json.key("counters").beginObject();
+        json.key("available").value(counters.isOpen());
+        if (!counters.isOpen())
+            json.key("error").value(countersError);
+        json.endObject();
+    }
+#ifdef NDEBUG
+    json.key("build").value("release");
+#else
+    json.key("build").value("debug");
+#endif
+    json.endObject();
+    json.key("benchmarks");
+    benchmark.writeJson(json);
+    json.endObject();
+
+    std::cout << "Results: " << options.output << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,296 @@
+
+/**
+ *
+ * Synthetic dataset generator
+ *
+ *   StreamSurfaceDatagen <output.foam> [options]
+ *
+ * Writes an analytic flow on a generated mesh as the tracer's binary cache
+ * (<output.foam>.bin, loaded like any other dataset) and optionally as an ASCII
+ * OpenFOAM case. With --timesteps the flow is also written at a series of times
+ * (<output.foam>.times and one velocity file per step), which the tracer loads
+ * as an unsteady dataset. With --check the dataset is loaded back, particles are
+ * traced with the tracer's own field lookup and Euler steps (along pathlines
+ * through the time steps for a series), and their end points are compared with
+ * the exact flow.
+ *
+ */
+
+// STD
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Stream Tracer
+#include "FieldTimeSeries.h"
+#include "JsonWriter.h"
+#include "PathSurface.h"
+#include "StreamTracer.h"
+#include "SyntheticFlow.h"
+
+namespace
+{
+    struct Options
+    {
+        Options() : flow("abc"), mesh("hex"), cells(1000000), size(0.1f), time(0.0f), timeSteps(0), timeStepSize(0.5f),
+                    openFOAM(false), check(false), seeds(1000), steps(1000), stepSize(0.001f) {}
+
+        std::string output, flow, mesh, report;
+        size_t cells;
+        float size, time;
+        unsigned int timeSteps;
+        float timeStepSize;
+        bool openFOAM, check;
+        unsigned int seeds, steps;
+        float stepSize;
+    };
+
+    void usage()
+    {
+        std::cout << "Usage: StreamSurfaceDatagen <output.foam> [options]\n"
+                  << "  --flow F         abc, hill, gyre or jet (default: abc)\n"
+                  << "  --mesh M         hex, tet or graded (default: hex)\n"
+                  << "  --cells N        approximate number of cells, e.g. 1e6 (default: 1e6)\n"
+                  << "  --size L         longest side of the domain (default: 0.1)\n"
+                  << "  --time T         phase of the double gyre (default: 0)\n"
+                  << "  --timesteps N    also write N time steps from T on (unsteady flows)\n"
+                  << "  --dt D           time between the steps (default: 0.5)\n"
+                  << "  --openfoam       also write an ASCII OpenFOAM case (hex and graded)\n"
+                  << "  --check          trace particles and compare with the exact flow\n"
+                  << "  --seeds N        particles of the check (default: 1000)\n"
+                  << "  --steps N        Euler steps per particle (default: 1000)\n"
+                  << "  --step H         step size (default: 0.001)\n"
+                  << "  --report FILE    JSON report\n";
+    }
+
+    bool parseArguments(int argc, char** argv, Options& options)
+    {
+        std::vector<std::string> positional;
+
+        for (int a = 1; a < argc; a++){
+            std::string argument = argv[a];
+            bool hasValue = a + 1 < argc;
+
+            if (argument == "--flow" && hasValue)           options.flow = argv[++a];
+            else if (argument == "--mesh" && hasValue)      options.mesh = argv[++a];
+            else if (argument == "--cells" && hasValue)     options.cells = (size_t)std::atof(argv[++a]);
+            else if (argument == "--size" && hasValue)      options.size = (float)std::atof(argv[++a]);
+            else if (argument == "--time" && hasValue)      options.time = (float)std::atof(argv[++a]);
+            else if (argument == "--timesteps" && hasValue) options.timeSteps = (unsigned int)std::atoi(argv[++a]);
+            else if (argument == "--dt" && hasValue)        options.timeStepSize = (float)std::atof(argv[++a]);
+            else if (argument == "--openfoam")              options.openFOAM = true;
+            else if (argument == "--check")                 options.check = true;
+            else if (argument == "--seeds" && hasValue)     options.seeds = (unsigned int)std::atoi(argv[++a]);
+            else if (argument == "--steps" && hasValue)     options.steps = (unsigned int)std::atoi(argv[++a]);
+            else if (argument == "--step" && hasValue)      options.stepSize = (float)std::atof(argv[++a]);
+            else if (argument == "--report" && hasValue)    options.report = argv[++a];
+            else if (argument.compare(0, 2, "--") == 0)     return false;
+            else                                            positional.push_back(argument);
+        }
+
+        if (positional.size() != 1 || options.cells == 0 || options.size <= 0.0f || options.stepSize <= 0.0f || options.timeStepSize <= 0.0f)
+            return false;
+
+        options.output = positional[0];
+        return true;
+    }
+
+    double millisecondsSince(const std::chrono::steady_clock::time_point& start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    struct Accuracy
+    {
+        Accuracy() : compared(0), meanError(0.0), maxError(0.0), meanDistance(0.0) {}
+
+        size_t compared;
+        double meanError, maxError;
+        double meanDistance;
+    };
+
+    /// Trace particles through the loaded dataset the way StreamSurface advances its front
+    /// (explicit Euler on the cell velocity), or PathSurface through its time steps, and
+    /// compare them with the exact flow.
+    Accuracy checkAccuracy(const SyntheticFlow& flow, const StreamTracer& tracer, const Options& options)
+    {
+        const AABB& domain = flow.getDomain();
+
+        // Seeds away from the boundary, so that most particles stay inside
+        std::mt19937 generator(7);
+        std::vector<std::uniform_real_distribution<float> > axes;
+        for (int a = 0; a < 3; a++){
+            float margin = 0.1f * (domain.max[a] - domain.min[a]);
+            axes.push_back(std::uniform_real_distribution<float>(domain.min[a] + margin, domain.max[a] - margin));
+        }
+
+        std::vector<glm::vec3> seeds(options.seeds);
+        for (size_t s = 0; s < seeds.size(); s++)
+            seeds[s] = glm::vec3(axes[0](generator), axes[1](generator), axes[2](generator));
+
+        std::vector<double> errors(seeds.size(), -1.0), distances(seeds.size(), 0.0);
+        const float duration = options.steps * options.stepSize;
+
+        if (tracer.isUnsteady()){
+            std::vector< std::vector<glm::vec3> > lines;
+            PathSurface::tracePathlines(tracer, seeds, options.time, options.stepSize, options.steps, lines);
+
+            #pragma omp parallel for schedule(dynamic, 16)
+            for (int s = 0; s < (int)lines.size(); s++){
+                glm::vec3 exact;
+                if (lines[s].size() == options.steps + 1 && flow.advectPath(seeds[s], options.time, duration, exact)){
+                    errors[s]    = glm::length(lines[s].back() - exact);
+                    distances[s] = glm::length(exact - seeds[s]);
+                }
+            }
+        }
+        else {
+            #pragma omp parallel for schedule(dynamic, 16)
+            for (int s = 0; s < (int)seeds.size(); s++){
+                glm::vec3 p = seeds[s];
+                bool inside = tracer.seedIsValid(p);
+                for (unsigned int step = 0; inside && step < options.steps; step++){
+                    p += tracer.derivate(p) * options.stepSize;
+                    inside = tracer.seedIsValid(p);
+                }
+
+                glm::vec3 exact;
+                if (inside && flow.advect(seeds[s], duration, exact)){
+                    errors[s]    = glm::length(p - exact);
+                    distances[s] = glm::length(exact - seeds[s]);
+                }
+            }
+        }
+
+        Accuracy accuracy;
+        for (size_t s = 0; s < seeds.size(); s++){
+            if (errors[s] < 0.0)
+                continue;
+            accuracy.compared++;
+            accuracy.meanError    += errors[s];
+            accuracy.meanDistance += distances[s];
+            accuracy.maxError      = std::max(accuracy.maxError, errors[s]);
+        }
+        if (accuracy.compared > 0){
+            accuracy.meanError    /= accuracy.compared;
+            accuracy.meanDistance /= accuracy.compared;
+        }
+
+        return accuracy;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseArguments(argc, argv, options)){
+        usage();
+        return 1;
+    }
+
+    SyntheticFlow::Flow flowType;
+    SyntheticFlow::Mesh meshType;
+    if (!SyntheticFlow::flowFromName(options.flow, flowType) || !SyntheticFlow::meshFromName(options.mesh, meshType)){
+        usage();
+        return 1;
+    }
+
+    SyntheticFlow flow(flowType, meshType, options.cells, options.size, options.time);
+
+    std::chrono::steady_clock::time_point phase = std::chrono::steady_clock::now();
+    if (!flow.writeBinary(options.output))
+        return 3;
+    double binaryMilliseconds = millisecondsSince(phase);
+
+    // The binary keeps the field at --time, which is also the first step of the series
+    double timeStepsMilliseconds = 0.0;
+    if (options.timeSteps > 1){
+        phase = std::chrono::steady_clock::now();
+
+        std::vector<double> times;
+        for (unsigned int step = 0; step < options.timeSteps; step++){
+            times.push_back(options.time + step * options.timeStepSize);
+            flow.setTime((float)times.back());
+            if (!flow.writeTimeStep(options.output, step))
+                return 3;
+        }
+        flow.setTime(options.time);
+
+        if (!FieldTimeSeries::saveTimes(FieldTimeSeries::timesPath(options.output), times)){
+            std::cout << "Cannot write " << FieldTimeSeries::timesPath(options.output) << std::endl;
+            return 3;
+        }
+        timeStepsMilliseconds = millisecondsSince(phase);
+    }
+
+    double openFOAMMilliseconds = 0.0;
+    if (options.openFOAM){
+        phase = std::chrono::steady_clock::now();
+        if (!flow.writeOpenFOAM(options.output))
+            return 3;
+        openFOAMMilliseconds = millisecondsSince(phase);
+    }
+
+    std::cout << options.flow << " on " << flow.getCellCount() << " " << options.mesh << " cells: "
+              << options.output << ".bin (" << binaryMilliseconds << " ms)" << std::endl;
+
+    Accuracy accuracy;
+    if (options.check){
+        StreamTracer tracer;
+        tracer.loadOpenFOAM(options.output);
+        tracer.computeAccel();
+
+        accuracy = checkAccuracy(flow, tracer, options);
+
+        const AABB& domain = flow.getDomain();
+        double diagonal = glm::length(glm::vec3(domain.max[0] - domain.min[0], domain.max[1] - domain.min[1], domain.max[2] - domain.min[2]));
+
+        std::cout << "Check: " << accuracy.compared << " of " << options.seeds << " particles compared, "
+                  << "mean error " << accuracy.meanError << " (" << 100.0 * accuracy.meanError / diagonal << "% of the diagonal), "
+                  << "max error " << accuracy.maxError << ", mean distance travelled " << accuracy.meanDistance << std::endl;
+    }
+
+    if (!options.report.empty()){
+        std::ofstream out(options.report.c_str());
+        if (!out){
+            std::cout << "Cannot write report " << options.report << std::endl;
+            return 3;
+        }
+
+        JsonWriter json(out);
+        json.beginObject();
+        json.key("dataset").value(options.output);
+        json.key("flow").value(options.flow);
+        json.key("mesh").value(options.mesh);
+        json.key("cells").value(flow.getCellCount());
+        json.key("points").value(flow.getPointCount());
+        json.key("size").value(options.size);
+        json.key("time").value(options.time);
+        json.key("time_steps").value(options.timeSteps);
+        json.key("time_step_size").value(options.timeStepSize);
+        json.key("timings_ms").beginObject();
+        json.key("binary").value(binaryMilliseconds);
+        json.key("time_steps").value(timeStepsMilliseconds);
+        json.key("openfoam").value(openFOAMMilliseconds);
+        json.endObject();
+        if (options.check){
+            json.key("check").beginObject();
+            json.key("seeds").value(options.seeds);
+            json.key("compared").value(accuracy.compared);
+            json.key("steps").value(options.steps);
+            json.key("step_size").value(options.stepSize);
+            json.key("mean_error").value(accuracy.meanError);
+            json.key("max_error").value(accuracy.maxError);
+            json.key("mean_distance").value(accuracy.meanDistance);
+            json.endObject();
+        }
+        json.endObject();
+    }
+
+    return 0;
+}
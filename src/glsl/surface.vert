@@ -6,10 +6,22 @@ layout( location = 2 ) uniform mat4 world_mat;
 layout( location = 3 ) uniform vec3 light_dir;
 layout( location = 4 ) uniform vec3 light_pos;
 
+// Compact meshes store positions normalized to their bounds and octahedral normals
+layout( location = 5 ) uniform vec3 position_offset;
+layout( location = 6 ) uniform vec3 position_scale;
+layout( location = 7 ) uniform int  octahedral_normals;
+
 layout( location = 0 ) in vec3 position;
 layout( location = 1 ) in vec3 color;
 layout( location = 2 ) in vec3 normal;
 
+vec3 decodeOctahedral(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return n;
+}
+
 out VS_OUT {
 	vec4 pos;
 	vec4 color;
@@ -17,8 +29,10 @@ out VS_OUT {
 } vs_out;
 
 void main() {
-	vs_out.pos    = proj_mat * view_mat * world_mat * vec4(position, 1.0f);
+	vec3 world_pos = position_offset + position * position_scale;
+
+	vs_out.pos    = proj_mat * view_mat * world_mat * vec4(world_pos, 1.0f);
 	vs_out.color  = vec4(color, 1.0f);
-	vs_out.normal = normalize(normal);
+	vs_out.normal = normalize(octahedral_normals != 0 ? decodeOctahedral(normal.xy) : normal);
 	gl_Position   = vs_out.pos;
 }
\ No newline at end of file
@@ -0,0 +1,218 @@
+// STD
+#include <random>
+#include <string>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "BrickedField.h"
+#include "StreamTracer.h"
+#include "SyntheticFlow.h"
+#include "TestSuite.h"
+
+namespace
+{
+    // Hexahedral cells: their bounds do not overlap, so a point is in one cell at most
+    SyntheticFlow abcFlow()
+    {
+        return SyntheticFlow(SyntheticFlow::FLOW_ABC, SyntheticFlow::MESH_HEXAHEDRAL, 8000);
+    }
+
+    bool writeDataset(TestSuite& suite, std::string& dataset)
+    {
+        dataset = suite.scratchDirectory() + "/abc.foam";
+        return abcFlow().writeBinary(dataset);
+    }
+
+    // Many small bricks, split in passes of a few thousand cells
+    bool buildBricks(const std::string& dataset, BrickedField& field)
+    {
+        return BrickedField::build(dataset + ".bin", BrickedField::bricksPath(dataset), 256, 64 * 1024)
+            && field.open(BrickedField::bricksPath(dataset));
+    }
+
+    // Points in the domain and somewhat around it
+    std::vector<glm::vec3> randomPoints(const AABB& domain, size_t n)
+    {
+        glm::vec3 low(domain.min[0], domain.min[1], domain.min[2]), high(domain.max[0], domain.max[1], domain.max[2]);
+        glm::vec3 margin = 0.05f * (high - low);
+
+        std::mt19937 generator(11);
+        std::uniform_real_distribution<float> x(low.x - margin.x, high.x + margin.x), y(low.y - margin.y, high.y + margin.y), z(low.z - margin.z, high.z + margin.z);
+
+        std::vector<glm::vec3> points(n);
+        for (size_t p = 0; p < n; p++)
+            points[p] = glm::vec3(x(generator), y(generator), z(generator));
+        return points;
+    }
+
+    // The cell of the whole mesh that contains a point, tested one by one (the grid of
+    // StreamTracer takes the first cell of a grid cell instead, which is not always the one)
+    bool wholeMeshCell(const std::vector<AABB>& cellBoxes, const glm::vec3& point, size_t& cell)
+    {
+        for (cell = 0; cell < cellBoxes.size(); cell++)
+            if (cellBoxes[cell].contains((const float*)&point))
+                return true;
+        return false;
+    }
+
+    // Single and batched samples against the whole mesh; the synthetic cells hold the flow at their centers
+    void checkSamples(TestSuite& suite, const BrickedField& field, const StreamTracer& tracer, const std::vector<glm::vec3>& points)
+    {
+        SyntheticFlow flow = abcFlow();
+        const std::vector<AABB>& cellBoxes = tracer.getCellBoxes();
+
+        size_t inside = 0, agree = 0;
+        for (size_t p = 0; p < points.size(); p++){
+            glm::vec3 velocity;
+            bool found = field.sample(points[p], velocity);
+            inside += found ? 1 : 0;
+
+            size_t cell;
+            bool expected = wholeMeshCell(cellBoxes, points[p], cell);
+            if (found != expected || found != tracer.seedIsValid(points[p]))
+                continue;
+
+            if (found){
+                const AABB& box = cellBoxes[cell];
+                glm::vec3 center = 0.5f * (glm::vec3(box.min[0], box.min[1], box.min[2]) + glm::vec3(box.max[0], box.max[1], box.max[2]));
+                if (glm::length(velocity - flow.velocity(center)) > 1e-6f)
+                    continue;
+            }
+            agree++;
+        }
+        TEST_CHECK(suite, agree == points.size());
+        TEST_CHECK(suite, inside > 0 && inside < points.size());
+
+        std::vector<glm::vec3> velocities;
+        std::vector<char> flags;
+        field.sample(points, velocities, &flags);
+        TEST_CHECK(suite, velocities.size() == points.size() && flags.size() == points.size());
+
+        size_t same = 0;
+        for (size_t p = 0; p < points.size() && p < velocities.size() && p < flags.size(); p++){
+            glm::vec3 velocity;
+            bool found = field.sample(points[p], velocity);
+            same += (found == (flags[p] != 0) && velocities[p] == (found ? velocity : glm::vec3(0.0f))) ? 1 : 0;
+        }
+        TEST_CHECK(suite, same == points.size());
+    }
+
+    void samplesMatchWholeMesh(TestSuite& suite)
+    {
+        std::string dataset;
+        TEST_CHECK(suite, writeDataset(suite, dataset));
+
+        StreamTracer tracer;
+        tracer.loadOpenFOAM(dataset);
+        tracer.computeAccel();
+
+        BrickedField field;
+        TEST_CHECK(suite, buildBricks(dataset, field));
+        TEST_CHECK(suite, field.getCellCount() == tracer.getCellBoxes().size());
+        TEST_CHECK(suite, field.getIndex().size() > 8);
+
+        checkSamples(suite, field, tracer, randomPoints(field.getSceneBox(), 2000));
+    }
+
+    void samplesMatchUnderEviction(TestSuite& suite)
+    {
+        std::string dataset;
+        TEST_CHECK(suite, writeDataset(suite, dataset));
+
+        StreamTracer tracer;
+        tracer.loadOpenFOAM(dataset);
+        tracer.computeAccel();
+
+        // Room for a couple of bricks only
+        BrickedField field(32 * 1024);
+        TEST_CHECK(suite, buildBricks(dataset, field));
+
+        checkSamples(suite, field, tracer, randomPoints(field.getSceneBox(), 2000));
+        TEST_CHECK(suite, field.getEvictions() > 0);
+        TEST_CHECK(suite, field.getLoads() > field.getIndex().size());
+    }
+
+    void reopeningDropsKeptBricks(TestSuite& suite)
+    {
+        // The same bricks over other cells: a point has another velocity in the brick of the same index
+        std::string dataset, graded = suite.scratchDirectory() + "/graded.foam";
+        TEST_CHECK(suite, writeDataset(suite, dataset));
+        TEST_CHECK(suite, SyntheticFlow(SyntheticFlow::FLOW_ABC, SyntheticFlow::MESH_GRADED, 8000).writeBinary(graded));
+
+        BrickedField field;
+        TEST_CHECK(suite, buildBricks(graded, field));
+        size_t bricks = field.getIndex().size();
+
+        std::vector<glm::vec3> points = randomPoints(field.getSceneBox(), 200), expected(points.size());
+        std::vector<char> inside(points.size());
+        for (size_t p = 0; p < points.size(); p++)
+            inside[p] = field.sample(points[p], expected[p]) ? 1 : 0;
+
+        TEST_CHECK(suite, buildBricks(dataset, field));
+        TEST_CHECK(suite, field.getIndex().size() == bricks);
+
+        // The other file right after this thread kept a brick of the first one
+        size_t same = 0, differ = 0;
+        for (size_t p = 0; p < points.size(); p++){
+            glm::vec3 before, after;
+            field.sample(points[p], before);
+            TEST_CHECK(suite, field.open(BrickedField::bricksPath(graded)));
+
+            bool found = field.sample(points[p], after);
+            same += (found == (inside[p] != 0) && (!found || after == expected[p])) ? 1 : 0;
+            differ += (found && after != before) ? 1 : 0;
+
+            TEST_CHECK(suite, field.open(BrickedField::bricksPath(dataset)));
+        }
+        TEST_CHECK(suite, same == points.size());
+        TEST_CHECK(suite, differ > 0);
+    }
+
+    void regionsMatchWholeMesh(TestSuite& suite)
+    {
+        std::string dataset;
+        TEST_CHECK(suite, writeDataset(suite, dataset));
+
+        StreamTracer tracer;
+        tracer.loadOpenFOAM(dataset);
+
+        BrickedField field;
+        TEST_CHECK(suite, buildBricks(dataset, field));
+
+        // A corner of the domain, across several bricks
+        const AABB& domain = field.getSceneBox();
+        float low[3], high[3];
+        for (int a = 0; a < 3; a++){
+            low[a] = domain.min[a] + 0.1f * (domain.max[a] - domain.min[a]);
+            high[a] = domain.min[a] + 0.6f * (domain.max[a] - domain.min[a]);
+        }
+        AABB region(low, high);
+
+        std::vector<AABB> cellBoxes;
+        std::vector<glm::vec3> cellVectors;
+        TEST_CHECK(suite, field.readRegion(region, cellBoxes, cellVectors));
+        TEST_CHECK(suite, cellBoxes.size() == cellVectors.size());
+
+        size_t expected = 0;
+        const std::vector<AABB>& allBoxes = tracer.getCellBoxes();
+        for (size_t c = 0; c < allBoxes.size(); c++)
+            expected += allBoxes[c].intersects(region) ? 1 : 0;
+        TEST_CHECK(suite, cellBoxes.size() == expected);
+
+        size_t intersecting = 0;
+        for (size_t c = 0; c < cellBoxes.size(); c++)
+            intersecting += cellBoxes[c].intersects(region) ? 1 : 0;
+        TEST_CHECK(suite, intersecting == cellBoxes.size());
+    }
+}
+
+void addBrickedFieldTests(TestSuite& suite)
+{
+    suite.add("bricked field/samples match the whole mesh", samplesMatchWholeMesh);
+    suite.add("bricked field/samples match under eviction", samplesMatchUnderEviction);
+    suite.add("bricked field/reopening drops the bricks kept per thread", reopeningDropsKeptBricks);
+    suite.add("bricked field/regions match the whole mesh", regionsMatchWholeMesh);
+}
@@ -0,0 +1,135 @@
+// STD
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "MeshOptimizer.h"
+#include "TestSuite.h"
+
+namespace
+{
+    // A surface traced from a seed row of `seeds` vertices over `steps` rows: the vertices
+    // row by row, the triangles ribbon by ribbon, the way the tracer emits them
+    void ribbonMesh(unsigned int seeds, unsigned int steps, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& faces)
+    {
+        vertices.clear();
+        faces.clear();
+
+        for (unsigned int j = 0; j < steps; j++)
+            for (unsigned int i = 0; i < seeds; i++)
+                vertices.push_back(glm::vec3((float)i, (float)j, 0.0f));
+
+        for (unsigned int i = 0; i + 1 < seeds; i++){
+            for (unsigned int j = 0; j + 1 < steps; j++){
+                unsigned int l0 = j * seeds + i, r0 = l0 + 1;
+                unsigned int l1 = l0 + seeds,   r1 = r0 + seeds;
+
+                faces.push_back(l0); faces.push_back(r0); faces.push_back(l1);
+                faces.push_back(r0); faces.push_back(r1); faces.push_back(l1);
+            }
+        }
+    }
+
+    typedef std::array<unsigned int, 3> Triangle;
+
+    // The triangles as a sorted list, every one rotated to start at its smallest index (keeps the winding)
+    std::vector<Triangle> triangleSet(const std::vector<unsigned int>& faces)
+    {
+        std::vector<Triangle> triangles;
+        for (size_t f = 0; f + 2 < faces.size(); f += 3){
+            Triangle t = {{ faces[f], faces[f + 1], faces[f + 2] }};
+            std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+            triangles.push_back(t);
+        }
+
+        std::sort(triangles.begin(), triangles.end());
+        return triangles;
+    }
+
+    void vertexCacheKeepsTriangles(TestSuite& suite)
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned int> faces;
+        ribbonMesh(20, 50, vertices, faces);
+
+        std::vector<unsigned int> optimized = faces;
+        MeshOptimizer::optimizeVertexCache(optimized, vertices.size());
+
+        TEST_CHECK(suite, optimized.size() == faces.size());
+        TEST_CHECK(suite, triangleSet(optimized) == triangleSet(faces));
+    }
+
+    void vertexFetchKeepsFixedVertices(TestSuite& suite)
+    {
+        const unsigned int seeds = 20;
+
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned int> faces;
+        ribbonMesh(seeds, 50, vertices, faces);
+
+        // Triangles in random order, so that first use differs from the vertex order
+        std::vector<unsigned int> order(faces.size() / 3);
+        for (size_t t = 0; t < order.size(); t++)
+            order[t] = (unsigned int)t;
+        std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+        std::vector<unsigned int> shuffled;
+        for (size_t t = 0; t < order.size(); t++)
+            shuffled.insert(shuffled.end(), faces.begin() + order[t] * 3, faces.begin() + order[t] * 3 + 3);
+
+        std::vector<unsigned int> optimized = shuffled, remap;
+        MeshOptimizer::optimizeVertexFetch(optimized, vertices.size(), seeds, remap);
+
+        TEST_CHECK(suite, remap.size() == vertices.size());
+        for (unsigned int v = 0; v < seeds; v++)
+            TEST_CHECK(suite, remap[v] == v);
+
+        // A permutation that the indices follow
+        std::vector<unsigned int> sorted = remap;
+        std::sort(sorted.begin(), sorted.end());
+        for (size_t v = 0; v < sorted.size(); v++)
+            TEST_CHECK(suite, sorted[v] == v);
+
+        bool indicesFollow = optimized.size() == shuffled.size();
+        for (size_t i = 0; i < shuffled.size() && indicesFollow; i++)
+            indicesFollow = optimized[i] == remap[shuffled[i]];
+        TEST_CHECK(suite, indicesFollow);
+
+        // The triangles keep their corners once the positions move along
+        std::vector<glm::vec3> moved = vertices;
+        MeshOptimizer::remapVertices(moved, remap);
+
+        bool samePositions = true;
+        for (size_t i = 0; i < shuffled.size() && samePositions; i++)
+            samePositions = moved[optimized[i]] == vertices[shuffled[i]];
+        TEST_CHECK(suite, samePositions);
+    }
+
+    void vertexCacheLowersACMR(TestSuite& suite)
+    {
+        // Ribbons longer than the cache: a ribbon finds none of the vertices it shares with the previous one
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned int> faces;
+        ribbonMesh(10, 400, vertices, faces);
+
+        float before = MeshOptimizer::computeACMR(faces, vertices.size());
+
+        MeshOptimizer::optimizeVertexCache(faces, vertices.size());
+        float after = MeshOptimizer::computeACMR(faces, vertices.size());
+
+        TEST_CHECK(suite, after < before);
+        TEST_CHECK(suite, after < 0.8f);
+    }
+}
+
+void addMeshOptimizerTests(TestSuite& suite)
+{
+    suite.add("mesh optimizer/vertex cache keeps the triangles", vertexCacheKeepsTriangles);
+    suite.add("mesh optimizer/vertex fetch keeps the fixed vertices", vertexFetchKeepsFixedVertices);
+    suite.add("mesh optimizer/vertex cache lowers the ACMR of a ribbon mesh", vertexCacheLowersACMR);
+}
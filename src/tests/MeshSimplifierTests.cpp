@@ -0,0 +1,153 @@
+// STD
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Stream Tracer
+#include "MeshSimplifier.h"
+#include "TestSuite.h"
+
+namespace
+{
+    const unsigned int COLUMNS = 40, ROWS = 40;
+
+    // A regular grid over [0, 1]^2, bent by a bump of the given height; row 0 plays the seed curve
+    void gridMesh(float bump, std::vector<glm::vec3>& vertices, std::vector<unsigned int>& faces)
+    {
+        vertices.clear();
+        faces.clear();
+
+        for (unsigned int j = 0; j < ROWS; j++){
+            for (unsigned int i = 0; i < COLUMNS; i++){
+                float x = (float)i / (COLUMNS - 1), y = (float)j / (ROWS - 1);
+                vertices.push_back(glm::vec3(x, y, bump * std::sin(3.0f * x) * std::cos(2.0f * y)));
+            }
+        }
+
+        for (unsigned int j = 0; j + 1 < ROWS; j++){
+            for (unsigned int i = 0; i + 1 < COLUMNS; i++){
+                unsigned int v = j * COLUMNS + i;
+                faces.push_back(v); faces.push_back(v + 1);           faces.push_back(v + COLUMNS);
+                faces.push_back(v + 1); faces.push_back(v + COLUMNS + 1); faces.push_back(v + COLUMNS);
+            }
+        }
+    }
+
+    // The sides of the grid a vertex lies on, one bit each
+    unsigned int sides(unsigned int v)
+    {
+        unsigned int i = v % COLUMNS, j = v / COLUMNS;
+        return (i == 0 ? 1u : 0u) | (i == COLUMNS - 1 ? 2u : 0u) | (j == 0 ? 4u : 0u) | (j == ROWS - 1 ? 8u : 0u);
+    }
+
+    // Edges used by one triangle
+    std::vector< std::pair<unsigned int, unsigned int> > borderEdges(const std::vector<unsigned int>& faces)
+    {
+        std::map< std::pair<unsigned int, unsigned int>, int > uses;
+        for (size_t f = 0; f + 2 < faces.size(); f += 3){
+            for (int c = 0; c < 3; c++){
+                unsigned int a = faces[f + c], b = faces[f + (c + 1) % 3];
+                uses[std::make_pair(std::min(a, b), std::max(a, b))]++;
+            }
+        }
+
+        std::vector< std::pair<unsigned int, unsigned int> > edges;
+        for (std::map< std::pair<unsigned int, unsigned int>, int >::const_iterator e = uses.begin(); e != uses.end(); ++e)
+            if (e->second == 1)
+                edges.push_back(e->first);
+        return edges;
+    }
+
+    double area(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& faces)
+    {
+        double total = 0.0;
+        for (size_t f = 0; f + 2 < faces.size(); f += 3)
+            total += 0.5 * glm::length(glm::cross(vertices[faces[f + 1]] - vertices[faces[f]], vertices[faces[f + 2]] - vertices[faces[f]]));
+        return total;
+    }
+
+    void keepsSeedVertices(TestSuite& suite)
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned int> faces;
+        gridMesh(0.2f, vertices, faces);
+
+        MeshSimplifier simplifier;
+        simplifier.setMesh(vertices, faces, COLUMNS);
+        size_t triangles = simplifier.simplify(faces.size() / 3 / 20, 0.0f);
+
+        TEST_CHECK(suite, triangles < faces.size() / 3 / 4);
+
+        std::vector<char> used(vertices.size(), 0);
+        for (size_t i = 0; i < simplifier.getFaces().size(); i++)
+            used[simplifier.getFaces()[i]] = 1;
+
+        for (unsigned int v = 0; v < COLUMNS; v++)
+            TEST_CHECK(suite, used[v]);
+    }
+
+    void keepsBorder(TestSuite& suite)
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned int> faces;
+        gridMesh(0.0f, vertices, faces);
+
+        MeshSimplifier simplifier;
+        simplifier.setMesh(vertices, faces, COLUMNS);
+        simplifier.simplify(faces.size() / 3 / 20, 0.0f);
+
+        const std::vector<unsigned int>& simplified = simplifier.getFaces();
+        TEST_CHECK(suite, simplified.size() < faces.size() / 4);
+
+        // Border vertices only slide along their side, so every border edge runs along a side of the grid
+        std::vector< std::pair<unsigned int, unsigned int> > edges = borderEdges(simplified);
+        TEST_CHECK(suite, !edges.empty());
+
+        for (size_t e = 0; e < edges.size(); e++)
+            TEST_CHECK(suite, (sides(edges[e].first) & sides(edges[e].second)) != 0);
+
+        // Nothing cut off or folded over on a flat grid
+        TEST_CHECK(suite, std::fabs(area(vertices, simplified) - area(vertices, faces)) < 1e-4);
+
+        // All four corners stay
+        std::vector<char> used(vertices.size(), 0);
+        for (size_t i = 0; i < simplified.size(); i++)
+            used[simplified[i]] = 1;
+
+        TEST_CHECK(suite, used[0] && used[COLUMNS - 1] && used[(ROWS - 1) * COLUMNS] && used[ROWS * COLUMNS - 1]);
+    }
+
+    void levelsStayWithinError(TestSuite& suite)
+    {
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned int> faces;
+        gridMesh(0.2f, vertices, faces);
+
+        std::vector<MeshSimplifier::Level> unbounded, bounded;
+        MeshSimplifier::buildLevels(vertices, faces, COLUMNS, 4, 4.0f, 0.0f, unbounded);
+        TEST_CHECK(suite, unbounded.size() >= 2);
+
+        if (unbounded.size() >= 2){
+            // Below the error of the second level, the chain has to end before its last level
+            float limit = 0.5f * unbounded[1].error;
+            MeshSimplifier::buildLevels(vertices, faces, COLUMNS, 4, 4.0f, limit, bounded);
+
+            TEST_CHECK(suite, !bounded.empty());
+            for (size_t l = 0; l < bounded.size(); l++)
+                TEST_CHECK(suite, bounded[l].error <= limit);
+            TEST_CHECK(suite, bounded.empty() || bounded.back().faces.size() > unbounded.back().faces.size());
+        }
+    }
+}
+
+void addMeshSimplifierTests(TestSuite& suite)
+{
+    suite.add("mesh simplifier/keeps the seed vertices", keepsSeedVertices);
+    suite.add("mesh simplifier/keeps the border in place", keepsBorder);
+    suite.add("mesh simplifier/levels stay within the error limit", levelsStayWithinError);
+}
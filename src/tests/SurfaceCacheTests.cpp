@@ -0,0 +1,176 @@
+// STD
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Boost
+#include <boost/filesystem.hpp>
+
+// Stream Tracer
+#include "StreamTracer.h"
+#include "SurfaceCache.h"
+#include "TestSuite.h"
+
+namespace
+{
+    // A surface of random values, n vertices and as many triangles
+    std::shared_ptr<SurfaceCache::Surface> randomSurface(size_t n, unsigned int seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+        std::shared_ptr<SurfaceCache::Surface> surface(new SurfaceCache::Surface);
+        for (size_t v = 0; v < n; v++){
+            surface->vertices.push_back(glm::vec3(value(generator), value(generator), value(generator)));
+            surface->derivatives.push_back(glm::vec3(value(generator), value(generator), value(generator)));
+            surface->normals.push_back(glm::vec3(value(generator), value(generator), value(generator)));
+            surface->texCoords.push_back(value(generator));
+        }
+        for (size_t t = 0; t < n; t++){
+            surface->faces.push_back((unsigned int)t);
+            surface->faces.push_back((unsigned int)((t + 1) % n));
+            surface->faces.push_back((unsigned int)((t + 2) % n));
+        }
+        surface->seedingPoints.assign(surface->vertices.begin(), surface->vertices.begin() + n / 10);
+
+        return surface;
+    }
+
+    bool sameSurface(const SurfaceCache::Surface& a, const SurfaceCache::Surface& b)
+    {
+        return a.seedingPoints == b.seedingPoints && a.vertices == b.vertices && a.derivatives == b.derivatives
+            && a.normals == b.normals && a.texCoords == b.texCoords && a.faces == b.faces;
+    }
+
+    void evictsLeastRecentlyUsed(TestSuite& suite)
+    {
+        std::shared_ptr<SurfaceCache::Surface> first = randomSurface(1000, 1), second = randomSurface(1000, 2), third = randomSurface(1000, 3);
+        size_t bytes = first->bytes();
+
+        SurfaceCache cache(bytes * 5 / 2);
+        cache.insert(1, first);
+        cache.insert(2, second);
+        TEST_CHECK(suite, cache.getMemoryBytes() == 2 * bytes);
+
+        // Using the first surface makes the second one the oldest
+        TEST_CHECK(suite, cache.find(1) == first);
+        cache.insert(3, third);
+
+        TEST_CHECK(suite, cache.getMemoryBytes() == 2 * bytes);
+        TEST_CHECK(suite, cache.find(1) == first);
+        TEST_CHECK(suite, !cache.find(2));
+        TEST_CHECK(suite, cache.find(3) == third);
+
+        // A surface larger than the budget still stays, alone
+        std::shared_ptr<SurfaceCache::Surface> large = randomSurface(4000, 4);
+        cache.insert(4, large);
+
+        TEST_CHECK(suite, cache.getMemoryBytes() == large->bytes());
+        TEST_CHECK(suite, cache.find(4) == large);
+        TEST_CHECK(suite, !cache.find(1) && !cache.find(3));
+
+        cache.setMaxMemoryBytes(0);
+        TEST_CHECK(suite, cache.find(4) == large);
+    }
+
+    void roundTripsThroughDisk(TestSuite& suite)
+    {
+        const std::string& directory = suite.scratchDirectory();
+        std::shared_ptr<SurfaceCache::Surface> surface = randomSurface(1000, 5);
+
+        {
+            SurfaceCache cache;
+            cache.setDiskDirectory(directory);
+            cache.insert(42, surface);
+        }
+
+        // A later session finds it on disk only
+        SurfaceCache cache;
+        cache.setDiskDirectory(directory);
+        TEST_CHECK(suite, cache.getMemoryBytes() == 0);
+
+        std::shared_ptr<const SurfaceCache::Surface> loaded = cache.find(42);
+        TEST_CHECK(suite, loaded && sameSurface(*loaded, *surface));
+        TEST_CHECK(suite, cache.getMemoryBytes() == surface->bytes());
+
+        TEST_CHECK(suite, !cache.find(43));
+
+        // Without the directory the memory tier is all there is
+        SurfaceCache memoryOnly;
+        TEST_CHECK(suite, !memoryOnly.find(42));
+    }
+
+    void corruptEntryIsMiss(TestSuite& suite)
+    {
+        const std::string& directory = suite.scratchDirectory();
+        {
+            SurfaceCache cache;
+            cache.setDiskDirectory(directory);
+            cache.insert(42, randomSurface(1000, 6));
+        }
+
+        std::vector<std::string> files;
+        for (boost::filesystem::directory_iterator f(directory); f != boost::filesystem::directory_iterator(); ++f)
+            files.push_back(f->path().string());
+        TEST_CHECK(suite, files.size() == 1);
+        if (files.size() != 1)
+            return;
+
+        // A count far past the end of the file, in place of the one of the seeding points
+        {
+            std::fstream file(files[0].c_str(), std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+            unsigned long long count = 1ULL << 40;
+            file.seekp(4 + sizeof(unsigned int) + sizeof(SurfaceCache::Key));
+            file.write((const char*)&count, sizeof(count));
+        }
+
+        SurfaceCache cache;
+        cache.setDiskDirectory(directory);
+        TEST_CHECK(suite, !cache.find(42));
+        TEST_CHECK(suite, cache.getMemoryBytes() == 0);
+
+        // And so is a truncated one
+        boost::filesystem::resize_file(files[0], 100);
+        TEST_CHECK(suite, !cache.find(42));
+    }
+
+    void keysFollowParameters(TestSuite& suite)
+    {
+        StreamTracer::SurfaceParameters parameters;
+        parameters.traceDirection = StreamTracer::SurfaceParameters::TD_BOTH;
+        parameters.traceStepSize = 0.01f;
+        parameters.traceMaxSteps = 100;
+        parameters.traceMaxSeeds = 50;
+        parameters.seedingLineCenter = glm::vec3(0.0f, 0.0f, 0.0f);
+        parameters.seedingLineDirection = glm::vec3(1.0f, 0.0f, 0.0f);
+        parameters.seedCurveType = StreamTracer::SurfaceParameters::SC_LINE;
+        parameters.seedingLineLength = 1.0f;
+        parameters.adaptiveSeeding = false;
+
+        SurfaceCache::Key key = SurfaceCache::computeKey("dataset", parameters, true, false, false);
+        TEST_CHECK(suite, key == SurfaceCache::computeKey("dataset", parameters, true, false, false));
+
+        TEST_CHECK(suite, key != SurfaceCache::computeKey("other dataset", parameters, true, false, false));
+        TEST_CHECK(suite, key != SurfaceCache::computeKey("dataset", parameters, false, false, false));
+
+        StreamTracer::SurfaceParameters changed = parameters;
+        changed.traceStepSize = 0.02f;
+        TEST_CHECK(suite, key != SurfaceCache::computeKey("dataset", changed, true, false, false));
+
+        changed = parameters;
+        changed.seedCurveType = StreamTracer::SurfaceParameters::SC_CIRCLE;
+        TEST_CHECK(suite, key != SurfaceCache::computeKey("dataset", changed, true, false, false));
+    }
+}
+
+void addSurfaceCacheTests(TestSuite& suite)
+{
+    suite.add("surface cache/evicts the least recently used", evictsLeastRecentlyUsed);
+    suite.add("surface cache/round trips through disk", roundTripsThroughDisk);
+    suite.add("surface cache/a corrupt entry is a miss", corruptEntryIsMiss);
+    suite.add("surface cache/keys follow the parameters", keysFollowParameters);
+}
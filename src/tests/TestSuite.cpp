@@ -0,0 +1,85 @@
+#include "TestSuite.h"
+
+// STD
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+
+// Boost
+#include <boost/filesystem.hpp>
+
+namespace
+{
+    // Swallows the progress output of the tested code
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) { return c; }
+    };
+}
+
+TestSuite::TestSuite()
+    : m_verbose(false)
+{
+}
+
+void TestSuite::add(const std::string& name, Function function)
+{
+    Entry entry = { name, function };
+    m_entries.push_back(entry);
+}
+
+size_t TestSuite::run(const std::string& filter)
+{
+    NullBuffer null;
+    size_t count = 0, failed = 0;
+
+    for (size_t e = 0; e < m_entries.size(); e++){
+        if (m_entries[e].name.find(filter) == std::string::npos)
+            continue;
+
+        m_failures.clear();
+        m_scratch.clear();
+
+        std::streambuf* console = std::cout.rdbuf();
+        if (!m_verbose)
+            std::cout.rdbuf(&null);
+
+        m_entries[e].function(*this);
+
+        std::cout.rdbuf(console);
+
+        if (!m_scratch.empty()){
+            boost::system::error_code error;
+            boost::filesystem::remove_all(m_scratch, error);
+        }
+
+        std::cout << (m_failures.empty() ? "[  OK  ] " : "[FAILED] ") << m_entries[e].name << std::endl;
+        for (size_t f = 0; f < m_failures.size(); f++)
+            std::cout << "    " << m_failures[f] << std::endl;
+
+        count++;
+        if (!m_failures.empty())
+            failed++;
+    }
+
+    std::cout << count - failed << " of " << count << " tests passed" << std::endl;
+    return failed;
+}
+
+void TestSuite::fail(const char* condition, const char* file, int line)
+{
+    std::ostringstream message;
+    message << boost::filesystem::path(file).filename().string() << ":" << line << ": " << condition;
+    m_failures.push_back(message.str());
+}
+
+const std::string& TestSuite::scratchDirectory()
+{
+    if (m_scratch.empty()){
+        boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("stream-surface-test-%%%%-%%%%-%%%%");
+        boost::filesystem::create_directories(directory);
+        m_scratch = directory.string();
+    }
+    return m_scratch;
+}
@@ -0,0 +1,71 @@
+
+/**
+ *
+ * Test harness
+ *
+ * This class runs registered tests and reports the checks that failed. Every
+ * test is a function that checks its results with TEST_CHECK; a test passes
+ * when none of its checks fail. Tests that need files get a scratch directory
+ * of their own, which is removed after the test.
+ *
+ *   suite.add("mesh optimizer/keeps triangles", [](TestSuite& suite){
+ *       TEST_CHECK(suite, 1 + 1 == 2);
+ *   });
+ *
+ */
+
+#ifndef __TEST_SUITE__
+#define __TEST_SUITE__
+
+// STD
+#include <functional>
+#include <string>
+#include <vector>
+
+#define TEST_CHECK(suite, condition) \
+    do { if (!(condition)) (suite).fail(#condition, __FILE__, __LINE__); } while (0)
+
+class TestSuite
+{
+public:
+
+    typedef std::function<void(TestSuite&)> Function;
+
+    TestSuite();
+
+    /// Let the tested code print to std::cout (silenced by default).
+    void setVerbose(bool verbose) { m_verbose = verbose; }
+
+    void add(const std::string& name, Function function);
+
+    /// Run all tests whose name contains the filter. Returns the number of tests that failed.
+    size_t run(const std::string& filter);
+
+    /// Record a failed check of the running test.
+    void fail(const char* condition, const char* file, int line);
+
+    /// A directory for the files of the running test, created on first use.
+    const std::string& scratchDirectory();
+
+private:
+    struct Entry
+    {
+        std::string name;
+        Function    function;
+    };
+
+    bool m_verbose;
+    std::vector<Entry> m_entries;
+
+    // Of the running test
+    std::vector<std::string> m_failures;
+    std::string              m_scratch;
+};
+
+// One registration function per test file
+void addBrickedFieldTests(TestSuite& suite);
+void addMeshOptimizerTests(TestSuite& suite);
+void addMeshSimplifierTests(TestSuite& suite);
+void addSurfaceCacheTests(TestSuite& suite);
+
+#endif
@@ -0,0 +1,47 @@
+
+/**
+ *
+ * Unit tests
+ *
+ *   StreamSurfaceTests [--filter TEXT] [--verbose]
+ *
+ * Checks the mesh optimizer, the simplifier, the surface cache and the bricked
+ * field on small generated inputs; needs neither a dataset nor a display.
+ * Returns the number of failed tests, at most 255.
+ *
+ */
+
+// STD
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+// Stream Tracer
+#include "TestSuite.h"
+
+int main(int argc, char** argv)
+{
+    std::string filter;
+    bool verbose = false;
+
+    for (int a = 1; a < argc; a++){
+        std::string argument = argv[a];
+
+        if (argument == "--filter" && a + 1 < argc)     filter = argv[++a];
+        else if (argument == "--verbose")               verbose = true;
+        else {
+            std::cout << "Usage: StreamSurfaceTests [--filter TEXT] [--verbose]" << std::endl;
+            return 1;
+        }
+    }
+
+    TestSuite suite;
+    suite.setVerbose(verbose);
+
+    addBrickedFieldTests(suite);
+    addMeshOptimizerTests(suite);
+    addMeshSimplifierTests(suite);
+    addSurfaceCacheTests(suite);
+
+    return (int)std::min(suite.run(filter), (size_t)255);
+}